@@ -0,0 +1,376 @@
+#include "animation.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ANIMATION_X86 1
+#include <immintrin.h>
+#endif
+
+// Arrays are padded to whole vectors and the padding holds idle
+// animations, so a step never needs a scalar tail.
+#define ANIMATION_LANES 8
+#define ANIMATION_ALIGN 64
+#define ANIMATION_FIELDS 12
+
+#define ANIMATION_PI 3.14159265358979323846f
+
+// Taylor terms of cos(pi x) and sin(pi x), good to 3e-5 on [-1/2, 1/2].
+#define COS_C2 -4.93480220f
+#define COS_C4 4.05871213f
+#define COS_C6 -1.33526277f
+#define COS_C8 0.23533063f
+#define SIN_C1 3.14159265f
+#define SIN_C3 -5.16771278f
+#define SIN_C5 2.55016404f
+#define SIN_C7 -0.59926453f
+#define SIN_C9 0.08214589f
+
+static void list_fields(AnimationSystem* s, void** fields[ANIMATION_FIELDS], size_t sizes[ANIMATION_FIELDS]) {
+    void** f[ANIMATION_FIELDS] = {
+        (void**)&s->progress, (void**)&s->duration, (void**)&s->rate, (void**)&s->type, (void**)&s->loop,
+        (void**)&s->x, (void**)&s->y, (void**)&s->size,
+        (void**)&s->draw_x, (void**)&s->draw_y, (void**)&s->draw_size, (void**)&s->angle
+    };
+    for (int i = 0; i < ANIMATION_FIELDS; i++) {
+        fields[i] = f[i];
+        sizes[i] = (i == 3 || i == 4) ? 1 : 4;
+    }
+}
+
+// An idle slot: no movement, nothing to divide by zero.
+static void reset_slot(AnimationSystem* s, int i) {
+    s->progress[i] = 0.0f;
+    s->duration[i] = 1.0f;
+    s->rate[i] = 1.0f;
+    s->type[i] = ANIMATION_NONE;
+    s->loop[i] = 0;
+    s->x[i] = s->y[i] = s->size[i] = 0;
+    s->draw_x[i] = s->draw_y[i] = s->draw_size[i] = 0;
+    s->angle[i] = 0.0f;
+}
+
+static bool grow(AnimationSystem* s, int capacity) {
+    capacity = (capacity + ANIMATION_LANES - 1) / ANIMATION_LANES * ANIMATION_LANES;
+    if (capacity <= s->capacity) return true;
+
+    void** fields[ANIMATION_FIELDS];
+    size_t sizes[ANIMATION_FIELDS];
+    list_fields(s, fields, sizes);
+
+    void* fresh[ANIMATION_FIELDS];
+    for (int i = 0; i < ANIMATION_FIELDS; i++) {
+        size_t bytes = (sizes[i] * capacity + ANIMATION_ALIGN - 1) / ANIMATION_ALIGN * ANIMATION_ALIGN;
+        fresh[i] = aligned_alloc(ANIMATION_ALIGN, bytes);
+        if (!fresh[i]) {
+            while (i-- > 0) free(fresh[i]);
+            return false;
+        }
+    }
+    for (int i = 0; i < ANIMATION_FIELDS; i++) {
+        if (*fields[i]) memcpy(fresh[i], *fields[i], sizes[i] * s->capacity);
+        free(*fields[i]);
+        *fields[i] = fresh[i];
+    }
+    int old = s->capacity;
+    s->capacity = capacity;
+    for (int i = old; i < capacity; i++) {
+        reset_slot(s, i);
+    }
+    return true;
+}
+
+AnimationSystem* animation_system_create(int capacity) {
+    AnimationSystem* s = calloc(1, sizeof(AnimationSystem));
+    if (!s) return NULL;
+    if (!grow(s, capacity > 0 ? capacity : ANIMATION_LANES)) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void animation_system_destroy(AnimationSystem* system) {
+    if (!system) return;
+    void** fields[ANIMATION_FIELDS];
+    size_t sizes[ANIMATION_FIELDS];
+    list_fields(system, fields, sizes);
+    for (int i = 0; i < ANIMATION_FIELDS; i++) {
+        free(*fields[i]);
+    }
+    free(system);
+}
+
+int animation_system_add(AnimationSystem* system, AnimationType type, int x, int y, int size,
+                         float duration, bool loop) {
+    if (!system) return -1;
+    if (system->count == system->capacity && !grow(system, system->capacity * 2)) return -1;
+
+    int i = system->count++;
+    reset_slot(system, i);
+    if (duration > 0.0f && type < ANIMATION_NONE) {
+        system->type[i] = (uint8_t)type;
+        system->duration[i] = duration;
+        system->rate[i] = 1.0f / duration;
+    }
+    system->loop[i] = loop;
+    system->x[i] = system->draw_x[i] = x;
+    system->y[i] = system->draw_y[i] = y;
+    system->size[i] = system->draw_size[i] = size;
+    return i;
+}
+
+void animation_system_remove(AnimationSystem* system, int index) {
+    if (!system || index < 0 || index >= system->count) return;
+    int last = --system->count;
+    if (index != last) {
+        system->progress[index] = system->progress[last];
+        system->duration[index] = system->duration[last];
+        system->rate[index] = system->rate[last];
+        system->type[index] = system->type[last];
+        system->loop[index] = system->loop[last];
+        system->x[index] = system->x[last];
+        system->y[index] = system->y[last];
+        system->size[index] = system->size[last];
+        system->draw_x[index] = system->draw_x[last];
+        system->draw_y[index] = system->draw_y[last];
+        system->draw_size[index] = system->draw_size[last];
+        system->angle[index] = system->angle[last];
+    }
+    reset_slot(system, last);
+}
+
+void animation_system_clear(AnimationSystem* system) {
+    if (!system) return;
+    for (int i = 0; i < system->count; i++) {
+        reset_slot(system, i);
+    }
+    system->count = 0;
+}
+
+void animation_system_set_duration(AnimationSystem* system, int index, float duration) {
+    if (!system || index < 0 || index >= system->count || duration <= 0.0f) return;
+    system->duration[index] = duration;
+    system->rate[index] = 1.0f / duration;
+}
+
+// One animation; the vector kernel below does the same arithmetic in the
+// same order, so both give identical poses.
+static void step_one(AnimationSystem* s, int i, float dt) {
+    float d = s->duration[i], rate = s->rate[i];
+    float p = s->progress[i] + dt;
+    if (s->loop[i]) {
+        p = p - floorf(p * rate) * d;
+    } else if (p > d) {
+        p = d;
+    }
+    s->progress[i] = p;
+
+    float t = p * rate;
+    t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+
+    // sin(pi t) is cos(pi x) and sin(2 pi t) is -2 cos(pi x) sin(pi x).
+    float x = t - 0.5f, x2 = x * x;
+    float c = 1.0f + x2 * (COS_C2 + x2 * (COS_C4 + x2 * (COS_C6 + x2 * COS_C8)));
+    float sn = x * (SIN_C1 + x2 * (SIN_C3 + x2 * (SIN_C5 + x2 * (SIN_C7 + x2 * SIN_C9))));
+    float wave = -2.0f * c * sn;
+
+    float size = (float)s->size[i];
+    int32_t lift = (int32_t)(c * size * 0.2f + 0.5f);
+    int32_t scaled = (int32_t)(size * (1.0f + 0.2f * c) + 0.5f);
+    int32_t offset = (scaled - s->size[i]) >> 1;
+
+    s->draw_x[i] = s->x[i];
+    s->draw_y[i] = s->y[i];
+    s->draw_size[i] = s->size[i];
+    s->angle[i] = 0.0f;
+    switch (s->type[i]) {
+    case ANIMATION_BOUNCE:
+        s->draw_y[i] -= lift;
+        break;
+    case ANIMATION_PULSE:
+        s->draw_x[i] -= offset;
+        s->draw_y[i] -= offset;
+        s->draw_size[i] = scaled;
+        break;
+    case ANIMATION_SPIN:
+        s->angle[i] = 2.0f * ANIMATION_PI * t;
+        break;
+    case ANIMATION_WIGGLE:
+        s->angle[i] = -(ANIMATION_PI / 18.0f) * wave;
+        break;
+    default:
+        break;
+    }
+}
+
+#ifdef ANIMATION_X86
+__attribute__((target("sse2")))
+static inline __m128i widen_bytes_sse2(const uint8_t* p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+}
+
+__attribute__((target("sse2")))
+static inline __m128 select_sse2(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__attribute__((target("sse2")))
+static void step_sse2(AnimationSystem* s, int count, float dt) {
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f), fifth = _mm_set1_ps(0.2f);
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128i izero = _mm_setzero_si128();
+
+    for (int i = 0; i < count; i += 4) {
+        __m128 d = _mm_load_ps(s->duration + i);
+        __m128 rate = _mm_load_ps(s->rate + i);
+        __m128 p = _mm_add_ps(_mm_load_ps(s->progress + i), vdt);
+        __m128i type = widen_bytes_sse2(s->type + i);
+        __m128 looping = _mm_castsi128_ps(_mm_cmpgt_epi32(widen_bytes_sse2(s->loop + i), izero));
+
+        // floor without SSE4.1: truncate, then step down where that rounded up.
+        __m128 q = _mm_mul_ps(p, rate);
+        __m128 fl = _mm_cvtepi32_ps(_mm_cvttps_epi32(q));
+        fl = _mm_sub_ps(fl, _mm_and_ps(_mm_cmpgt_ps(fl, q), one));
+        __m128 wrapped = _mm_sub_ps(p, _mm_mul_ps(fl, d));
+        p = select_sse2(looping, wrapped, _mm_min_ps(p, d));
+        _mm_store_ps(s->progress + i, p);
+
+        __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(p, rate), zero), one);
+        __m128 x = _mm_sub_ps(t, half), x2 = _mm_mul_ps(x, x);
+        __m128 c = _mm_add_ps(_mm_set1_ps(COS_C6), _mm_mul_ps(x2, _mm_set1_ps(COS_C8)));
+        c = _mm_add_ps(_mm_set1_ps(COS_C4), _mm_mul_ps(x2, c));
+        c = _mm_add_ps(_mm_set1_ps(COS_C2), _mm_mul_ps(x2, c));
+        c = _mm_add_ps(one, _mm_mul_ps(x2, c));
+        __m128 sn = _mm_add_ps(_mm_set1_ps(SIN_C7), _mm_mul_ps(x2, _mm_set1_ps(SIN_C9)));
+        sn = _mm_add_ps(_mm_set1_ps(SIN_C5), _mm_mul_ps(x2, sn));
+        sn = _mm_add_ps(_mm_set1_ps(SIN_C3), _mm_mul_ps(x2, sn));
+        sn = _mm_add_ps(_mm_set1_ps(SIN_C1), _mm_mul_ps(x2, sn));
+        sn = _mm_mul_ps(x, sn);
+        __m128 wave = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(-2.0f), c), sn);
+
+        __m128i isize = _mm_load_si128((const __m128i*)(s->size + i));
+        __m128 size = _mm_cvtepi32_ps(isize);
+        __m128i lift = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(c, size), fifth), half));
+        __m128i scaled = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(size, _mm_add_ps(one, _mm_mul_ps(fifth, c))), half));
+        __m128i offset = _mm_srai_epi32(_mm_sub_epi32(scaled, isize), 1);
+
+        __m128i bounce = _mm_cmpeq_epi32(type, _mm_set1_epi32(ANIMATION_BOUNCE));
+        __m128i pulse = _mm_cmpeq_epi32(type, _mm_set1_epi32(ANIMATION_PULSE));
+        __m128 spin = _mm_castsi128_ps(_mm_cmpeq_epi32(type, _mm_set1_epi32(ANIMATION_SPIN)));
+        __m128 wiggle = _mm_castsi128_ps(_mm_cmpeq_epi32(type, _mm_set1_epi32(ANIMATION_WIGGLE)));
+
+        __m128i shift = _mm_and_si128(pulse, offset);
+        __m128i x0 = _mm_load_si128((const __m128i*)(s->x + i));
+        __m128i y0 = _mm_load_si128((const __m128i*)(s->y + i));
+        _mm_store_si128((__m128i*)(s->draw_x + i), _mm_sub_epi32(x0, shift));
+        _mm_store_si128((__m128i*)(s->draw_y + i),
+                        _mm_sub_epi32(_mm_sub_epi32(y0, shift), _mm_and_si128(bounce, lift)));
+        _mm_store_si128((__m128i*)(s->draw_size + i),
+                        _mm_or_si128(_mm_and_si128(pulse, scaled), _mm_andnot_si128(pulse, isize)));
+
+        __m128 turn = _mm_mul_ps(_mm_set1_ps(2.0f * ANIMATION_PI), t);
+        __m128 tilt = _mm_mul_ps(_mm_set1_ps(-(ANIMATION_PI / 18.0f)), wave);
+        _mm_store_ps(s->angle + i, _mm_or_ps(_mm_and_ps(spin, turn), _mm_and_ps(wiggle, tilt)));
+    }
+}
+
+// As step_sse2, eight at a time. No FMA: fused rounding would make poses
+// differ from the other paths.
+__attribute__((target("avx2")))
+static void step_avx2(AnimationSystem* s, int count, float dt) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f), fifth = _mm256_set1_ps(0.2f);
+    const __m256 vdt = _mm256_set1_ps(dt);
+    const __m256i izero = _mm256_setzero_si256();
+
+    for (int i = 0; i < count; i += 8) {
+        __m256 d = _mm256_load_ps(s->duration + i);
+        __m256 rate = _mm256_load_ps(s->rate + i);
+        __m256 p = _mm256_add_ps(_mm256_load_ps(s->progress + i), vdt);
+        __m256i type = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s->type + i)));
+        __m256i loop = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s->loop + i)));
+        __m256 looping = _mm256_castsi256_ps(_mm256_cmpgt_epi32(loop, izero));
+
+        __m256 fl = _mm256_floor_ps(_mm256_mul_ps(p, rate));
+        __m256 wrapped = _mm256_sub_ps(p, _mm256_mul_ps(fl, d));
+        p = _mm256_blendv_ps(_mm256_min_ps(p, d), wrapped, looping);
+        _mm256_store_ps(s->progress + i, p);
+
+        __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(p, rate), zero), one);
+        __m256 x = _mm256_sub_ps(t, half), x2 = _mm256_mul_ps(x, x);
+        __m256 c = _mm256_add_ps(_mm256_set1_ps(COS_C6), _mm256_mul_ps(x2, _mm256_set1_ps(COS_C8)));
+        c = _mm256_add_ps(_mm256_set1_ps(COS_C4), _mm256_mul_ps(x2, c));
+        c = _mm256_add_ps(_mm256_set1_ps(COS_C2), _mm256_mul_ps(x2, c));
+        c = _mm256_add_ps(one, _mm256_mul_ps(x2, c));
+        __m256 sn = _mm256_add_ps(_mm256_set1_ps(SIN_C7), _mm256_mul_ps(x2, _mm256_set1_ps(SIN_C9)));
+        sn = _mm256_add_ps(_mm256_set1_ps(SIN_C5), _mm256_mul_ps(x2, sn));
+        sn = _mm256_add_ps(_mm256_set1_ps(SIN_C3), _mm256_mul_ps(x2, sn));
+        sn = _mm256_add_ps(_mm256_set1_ps(SIN_C1), _mm256_mul_ps(x2, sn));
+        sn = _mm256_mul_ps(x, sn);
+        __m256 wave = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), c), sn);
+
+        __m256i isize = _mm256_load_si256((const __m256i*)(s->size + i));
+        __m256 size = _mm256_cvtepi32_ps(isize);
+        __m256i lift = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(c, size), fifth), half));
+        __m256i scaled = _mm256_cvttps_epi32(
+            _mm256_add_ps(_mm256_mul_ps(size, _mm256_add_ps(one, _mm256_mul_ps(fifth, c))), half));
+        __m256i offset = _mm256_srai_epi32(_mm256_sub_epi32(scaled, isize), 1);
+
+        __m256i bounce = _mm256_cmpeq_epi32(type, _mm256_set1_epi32(ANIMATION_BOUNCE));
+        __m256i pulse = _mm256_cmpeq_epi32(type, _mm256_set1_epi32(ANIMATION_PULSE));
+        __m256 spin = _mm256_castsi256_ps(_mm256_cmpeq_epi32(type, _mm256_set1_epi32(ANIMATION_SPIN)));
+        __m256 wiggle = _mm256_castsi256_ps(_mm256_cmpeq_epi32(type, _mm256_set1_epi32(ANIMATION_WIGGLE)));
+
+        __m256i shift = _mm256_and_si256(pulse, offset);
+        __m256i x0 = _mm256_load_si256((const __m256i*)(s->x + i));
+        __m256i y0 = _mm256_load_si256((const __m256i*)(s->y + i));
+        _mm256_store_si256((__m256i*)(s->draw_x + i), _mm256_sub_epi32(x0, shift));
+        _mm256_store_si256((__m256i*)(s->draw_y + i),
+                           _mm256_sub_epi32(_mm256_sub_epi32(y0, shift), _mm256_and_si256(bounce, lift)));
+        _mm256_store_si256((__m256i*)(s->draw_size + i), _mm256_blendv_epi8(isize, scaled, pulse));
+
+        __m256 turn = _mm256_mul_ps(_mm256_set1_ps(2.0f * ANIMATION_PI), t);
+        __m256 tilt = _mm256_mul_ps(_mm256_set1_ps(-(ANIMATION_PI / 18.0f)), wave);
+        _mm256_store_ps(s->angle + i, _mm256_or_ps(_mm256_and_ps(spin, turn), _mm256_and_ps(wiggle, tilt)));
+    }
+    _mm256_zeroupper();
+}
+#endif
+
+void animation_system_step(AnimationSystem* system, float dt) {
+    if (!system) return;
+    // Padding slots are idle, so whole vectors past count are safe.
+    int count = (system->count + ANIMATION_LANES - 1) / ANIMATION_LANES * ANIMATION_LANES;
+#ifdef ANIMATION_X86
+    if (__builtin_cpu_supports("avx2")) {
+        step_avx2(system, count, dt);
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        step_sse2(system, count, dt);
+        return;
+    }
+#endif
+    for (int i = 0; i < count; i++) {
+        step_one(system, i, dt);
+    }
+}
+
+void animation_system_draw(const AnimationSystem* system, Canvas* canvas) {
+    if (!system || !canvas) return;
+    for (int i = 0; i < system->count; i++) {
+        if (system->type[i] == ANIMATION_SPIN || system->type[i] == ANIMATION_WIGGLE) {
+            canvas_draw_emoji_rotated(canvas, system->draw_x[i], system->draw_y[i],
+                                      system->draw_size[i], system->angle[i]);
+        } else {
+            canvas_draw_emoji_smile(canvas, system->draw_x[i], system->draw_y[i], system->draw_size[i]);
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <stdint.h>
+#include "canvas.h"
+
+// Many animated smileys advanced together. Each field lives in its own
+// array, so one step runs over them all with vector code instead of one
+// AnimationState call at a time. The curves follow the CSS keyframes.
+typedef enum {
+    ANIMATION_BOUNCE,       // up by a fifth of the size at the midpoint
+    ANIMATION_PULSE,        // scales to 1.2x at the midpoint
+    ANIMATION_SPIN,         // one full turn
+    ANIMATION_WIGGLE,       // -10 degrees at a quarter, +10 at three quarters
+    ANIMATION_NONE
+} AnimationType;
+
+typedef struct {
+    int count;
+    int capacity;
+
+    // Inputs, one slot per animation. Callers may move animations by
+    // writing x, y and size, or seek one by writing progress.
+    float* progress;        // seconds since the animation started
+    float* duration;        // seconds; change with animation_system_set_duration
+    float* rate;            // 1 / duration
+    uint8_t* type;          // AnimationType
+    uint8_t* loop;          // 1 to restart after duration, 0 to hold
+    int32_t* x;
+    int32_t* y;
+    int32_t* size;
+
+    // Pose as of the last step: the box to draw in and the turn, radians.
+    int32_t* draw_x;
+    int32_t* draw_y;
+    int32_t* draw_size;
+    float* angle;
+} AnimationSystem;
+
+AnimationSystem* animation_system_create(int capacity);
+void animation_system_destroy(AnimationSystem* system);
+
+// Returns the new animation's index, or -1 when out of memory. A duration
+// that is not positive makes the animation ANIMATION_NONE.
+int animation_system_add(AnimationSystem* system, AnimationType type, int x, int y, int size,
+                         float duration, bool loop);
+// Moves the last animation into index, so indices past it are not stable.
+void animation_system_remove(AnimationSystem* system, int index);
+void animation_system_clear(AnimationSystem* system);
+void animation_system_set_duration(AnimationSystem* system, int index, float duration);
+
+// Advances every animation by dt seconds and updates the poses.
+void animation_system_step(AnimationSystem* system, float dt);
+// Draws every animation at its current pose.
+void animation_system_draw(const AnimationSystem* system, Canvas* canvas);
+
+#endif // ANIMATION_H
@@ -0,0 +1,307 @@
+#include "atlas.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ATLAS_BUCKETS 256
+// Shelf heights are rounded up so nearby sizes can share a shelf.
+#define ATLAS_SHELF_ROUND 8
+// Thrash guard: lookups are judged in windows of this many. A miss that
+// has to evict costs several times a direct rasterization, so once more
+// than one lookup in ATLAS_THRASH_SHARE evicts, the next window turns such
+// misses away and lets the caller draw directly. Now and then one is let
+// in as a probe, freeing a shelf for a working set that may have shrunk
+// back to fit; probes back off to one every ATLAS_MAX_BACKOFF windows
+// while the thrashing lasts.
+#define ATLAS_WINDOW 256
+#define ATLAS_THRASH_SHARE 16
+#define ATLAS_MAX_BACKOFF 16
+// A sprite taller than this share of the atlas would evict a large part of
+// it, and a handful of such sprites thrash from the first lookup, before a
+// window has been judged. They only evict as probes, one per window at most.
+#define ATLAS_LARGE_SHARE 4
+
+typedef struct {
+    int y;
+    int height;
+    int x;                  // next free column
+    uint32_t last_used;
+} Shelf;
+
+typedef struct {
+    uint8_t op;
+    bool antialias;
+    int size;
+    int shelf;
+    CanvasBox cell;
+    uint32_t* rows;         // row index followed by the runs, one allocation
+    EmojiRun* runs;
+    int next;               // bucket chain, or free list when unused
+} AtlasEntry;
+
+struct EmojiAtlas {
+    Canvas* canvas;
+    Shelf* shelves;
+    int shelf_count;
+    int shelf_capacity;
+    int top;                // first row below the last shelf
+    AtlasEntry* entries;
+    int entry_capacity;
+    int free_entry;
+    int buckets[ATLAS_BUCKETS];
+    uint32_t clock;
+    int window_lookups;
+    int window_evictions;   // misses that needed room freed
+    bool thrashing;
+    bool probe_due;
+    int backoff;            // windows between probes
+    int probe_wait;         // windows until the next one
+};
+
+static void release_entry(EmojiAtlas* atlas, int index) {
+    AtlasEntry* e = &atlas->entries[index];
+    free(e->rows);
+    e->rows = NULL;
+    e->runs = NULL;
+    e->next = atlas->free_entry;
+    atlas->free_entry = index;
+}
+
+static unsigned bucket_of(CanvasCmdOp op, int size, bool antialias) {
+    return ((unsigned)size * 2654435761u ^ ((unsigned)op * 2 + antialias) * 40503u) % ATLAS_BUCKETS;
+}
+
+EmojiAtlas* emoji_atlas_create(int width, int height) {
+    EmojiAtlas* atlas = calloc(1, sizeof(EmojiAtlas));
+    if (!atlas) return NULL;
+    atlas->canvas = canvas_create(width, height);
+    if (!atlas->canvas) {
+        free(atlas);
+        return NULL;
+    }
+    canvas_set_clear_color(atlas->canvas, TRANSPARENT);
+    atlas->backoff = 1;
+    emoji_atlas_clear(atlas);
+    return atlas;
+}
+
+void emoji_atlas_destroy(EmojiAtlas* atlas) {
+    if (!atlas) return;
+    emoji_atlas_clear(atlas);
+    canvas_destroy(atlas->canvas);
+    free(atlas->shelves);
+    free(atlas->entries);
+    free(atlas);
+}
+
+void emoji_atlas_clear(EmojiAtlas* atlas) {
+    if (!atlas) return;
+    atlas->shelf_count = 0;
+    atlas->top = 0;
+    for (int b = 0; b < ATLAS_BUCKETS; b++) atlas->buckets[b] = -1;
+    atlas->free_entry = -1;
+    for (int i = atlas->entry_capacity; i-- > 0;) {
+        release_entry(atlas, i);
+    }
+}
+
+const Canvas* emoji_atlas_canvas(const EmojiAtlas* atlas) {
+    return atlas ? atlas->canvas : NULL;
+}
+
+static void evict_shelf(EmojiAtlas* atlas, int shelf) {
+    for (int b = 0; b < ATLAS_BUCKETS; b++) {
+        int* link = &atlas->buckets[b];
+        while (*link >= 0) {
+            AtlasEntry* e = &atlas->entries[*link];
+            if (e->shelf != shelf) {
+                link = &e->next;
+                continue;
+            }
+            int index = *link;
+            *link = e->next;
+            release_entry(atlas, index);
+        }
+    }
+    atlas->shelves[shelf].x = 0;
+}
+
+// Picks a shelf with room for a w x h sprite: the tightest existing shelf,
+// else a new one, else, when evict is set, the least recently used shelf
+// tall enough.
+static int find_shelf(EmojiAtlas* atlas, int w, int h, bool evict) {
+    int best = -1;
+    for (int s = 0; s < atlas->shelf_count; s++) {
+        const Shelf* shelf = &atlas->shelves[s];
+        if (shelf->height < h || shelf->height > h + h / 2 + ATLAS_SHELF_ROUND) continue;
+        if (shelf->x + w > atlas->canvas->width) continue;
+        if (best < 0 || shelf->height < atlas->shelves[best].height) best = s;
+    }
+    if (best >= 0) return best;
+
+    int height = (h + ATLAS_SHELF_ROUND - 1) / ATLAS_SHELF_ROUND * ATLAS_SHELF_ROUND;
+    if (height > atlas->canvas->height) height = h;
+    if (atlas->top + height <= atlas->canvas->height) {
+        if (atlas->shelf_count == atlas->shelf_capacity) {
+            int capacity = atlas->shelf_capacity ? atlas->shelf_capacity * 2 : 16;
+            Shelf* shelves = realloc(atlas->shelves, capacity * sizeof(Shelf));
+            if (!shelves) return -1;
+            atlas->shelves = shelves;
+            atlas->shelf_capacity = capacity;
+        }
+        Shelf* shelf = &atlas->shelves[atlas->shelf_count];
+        *shelf = (Shelf){atlas->top, height, 0, 0};
+        atlas->top += height;
+        return atlas->shelf_count++;
+    }
+    if (!evict) return -1;
+
+    int victim = -1;
+    for (int s = 0; s < atlas->shelf_count; s++) {
+        if (atlas->shelves[s].height < h) continue;
+        if (victim < 0 || atlas->shelves[s].last_used < atlas->shelves[victim].last_used) victim = s;
+    }
+    if (victim >= 0) {
+        evict_shelf(atlas, victim);
+        return victim;
+    }
+
+    // Every shelf is too short: start over.
+    emoji_atlas_clear(atlas);
+    return find_shelf(atlas, w, h, true);
+}
+
+static int alloc_entry(EmojiAtlas* atlas) {
+    if (atlas->free_entry < 0) {
+        int capacity = atlas->entry_capacity ? atlas->entry_capacity * 2 : 64;
+        AtlasEntry* entries = realloc(atlas->entries, capacity * sizeof(AtlasEntry));
+        if (!entries) return -1;
+        atlas->entries = entries;
+        for (int i = capacity; i-- > atlas->entry_capacity;) {
+            entries[i].rows = NULL;
+            release_entry(atlas, i);
+        }
+        atlas->entry_capacity = capacity;
+    }
+    int index = atlas->free_entry;
+    atlas->free_entry = atlas->entries[index].next;
+    return index;
+}
+
+// Splits each row of the entry's cell into opaque and translucent runs,
+// leaving out transparent pixels.
+static bool build_runs(EmojiAtlas* atlas, AtlasEntry* e) {
+    const Canvas* canvas = atlas->canvas;
+    int w = e->cell.x1 - e->cell.x0, h = e->cell.y1 - e->cell.y0;
+    size_t run_count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1) {
+            size_t rows_bytes = (size_t)(h + 1) * sizeof(uint32_t);
+            e->rows = malloc(rows_bytes + run_count * sizeof(EmojiRun));
+            if (!e->rows) return false;
+            e->runs = (EmojiRun*)((char*)e->rows + rows_bytes);
+            run_count = 0;
+        }
+        for (int r = 0; r < h; r++) {
+            const Color* row = canvas_row(canvas, e->cell.y0 + r) + e->cell.x0;
+            if (pass == 1) e->rows[r] = (uint32_t)run_count;
+            for (int x = 0; x < w;) {
+                if (row[x].a == 0) {
+                    x++;
+                    continue;
+                }
+                bool opaque = row[x].a == 255;
+                int start = x;
+                while (x < w && row[x].a != 0 && (row[x].a == 255) == opaque) x++;
+                if (pass == 1) e->runs[run_count] = (EmojiRun){(uint16_t)start, (uint16_t)(x - start), opaque};
+                run_count++;
+            }
+        }
+        if (pass == 1) e->rows[h] = (uint32_t)run_count;
+    }
+    return true;
+}
+
+bool emoji_atlas_lookup(EmojiAtlas* atlas, CanvasCmdOp op, int size, bool antialias,
+                        EmojiSprite* sprite) {
+    if (!atlas || size <= 0) return false;
+
+    if (++atlas->window_lookups == ATLAS_WINDOW) {
+        atlas->thrashing = atlas->window_evictions * ATLAS_THRASH_SHARE > ATLAS_WINDOW;
+        atlas->window_lookups = 0;
+        atlas->window_evictions = 0;
+        if (!atlas->thrashing) {
+            atlas->backoff = 1;
+            atlas->probe_wait = 0;
+            atlas->probe_due = true;
+        } else if (atlas->probe_wait-- == 0) {
+            atlas->probe_due = true;
+            atlas->probe_wait = atlas->backoff;
+            if (atlas->backoff < ATLAS_MAX_BACKOFF) atlas->backoff *= 2;
+        }
+    }
+
+    unsigned bucket = bucket_of(op, size, antialias);
+    for (int i = atlas->buckets[bucket]; i >= 0; i = atlas->entries[i].next) {
+        AtlasEntry* e = &atlas->entries[i];
+        if (e->op == op && e->size == size && e->antialias == antialias) {
+            atlas->shelves[e->shelf].last_used = ++atlas->clock;
+            *sprite = (EmojiSprite){e->cell, e->rows, e->runs};
+            return true;
+        }
+    }
+
+    int margin = canvas_emoji_margin(size);
+    int extent = size + 2 * margin;
+    if (extent > atlas->canvas->width || extent > atlas->canvas->height || extent > UINT16_MAX) {
+        return false;
+    }
+    // Finding a shelf may clear the atlas, so allocate the entry after.
+    int s = find_shelf(atlas, extent, extent, false);
+    if (s < 0) {
+        atlas->window_evictions++;
+        bool large = extent * ATLAS_LARGE_SHARE > atlas->canvas->height;
+        if ((atlas->thrashing || large) && !atlas->probe_due) return false;
+        atlas->probe_due = false;
+        s = find_shelf(atlas, extent, extent, true);
+    }
+    if (s < 0) return false;
+    int index = alloc_entry(atlas);
+    if (index < 0) return false;
+
+    Shelf* shelf = &atlas->shelves[s];
+    AtlasEntry* e = &atlas->entries[index];
+    e->op = (uint8_t)op;
+    e->antialias = antialias;
+    e->size = size;
+    e->shelf = s;
+    e->cell = (CanvasBox){shelf->x, shelf->y, shelf->x + extent, shelf->y + extent};
+
+    // Cells are reused after eviction, so clear before drawing.
+    Canvas* canvas = atlas->canvas;
+    canvas_set_clip_box(canvas, e->cell);
+    CanvasCmd clear = {
+        .op = CANVAS_CMD_CLEAR,
+        .color = TRANSPARENT,
+        .args = {e->cell.x0, e->cell.y0, extent, extent}
+    };
+    canvas_cmd_execute(canvas, &clear);
+    CanvasCmd draw = {
+        .op = (uint8_t)op,
+        .antialias = antialias,
+        .args = {e->cell.x0 + margin, e->cell.y0 + margin, size}
+    };
+    canvas_cmd_execute(canvas, &draw);
+    canvas_reset_clip(canvas);
+
+    if (!build_runs(atlas, e)) {
+        release_entry(atlas, index);
+        return false;
+    }
+    e->next = atlas->buckets[bucket];
+    atlas->buckets[bucket] = index;
+    shelf->x += extent;
+    shelf->last_used = ++atlas->clock;
+    *sprite = (EmojiSprite){e->cell, e->rows, e->runs};
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "canvas.h"
+#include "canvas_cmd.h"
+
+// Emoji rasterized once per (emoji, size, antialias) into a shared atlas
+// canvas. Attach an atlas with canvas_set_emoji_atlas and emoji draw calls
+// on that canvas become blits out of it. Sprites are packed on shelves; when the atlas is
+// full the least recently used shelf is evicted.
+//
+// A miss that evicts costs several times drawing the emoji directly, so a
+// working set larger than the atlas would be slower than no atlas. When
+// lookups keep evicting, such misses fail instead and the canvas draws those
+// emoji directly, until the evictions die down. Sprites taller than a
+// quarter of the atlas seldom evict at all. Sized to the working set,
+// the atlas draws each emoji about 1.5x faster than rasterizing it.
+//
+// An atlas is not thread safe. Tile renderers give each worker its own.
+typedef struct EmojiAtlas EmojiAtlas;
+
+#define EMOJI_ATLAS_DEFAULT_SIZE 1024
+
+// Horizontal run of non-transparent sprite pixels, x relative to the cell.
+// Opaque runs are copied, the rest blended.
+typedef struct {
+    uint16_t x;
+    uint16_t length;
+    bool opaque;
+} EmojiRun;
+
+typedef struct {
+    CanvasBox cell;
+    const uint32_t* rows;   // runs of cell row r: runs[rows[r]] up to runs[rows[r + 1]]
+    const EmojiRun* runs;
+} EmojiSprite;
+
+EmojiAtlas* emoji_atlas_create(int width, int height);
+void emoji_atlas_destroy(EmojiAtlas* atlas);
+// Drops every sprite.
+void emoji_atlas_clear(EmojiAtlas* atlas);
+const Canvas* emoji_atlas_canvas(const EmojiAtlas* atlas);
+
+// Finds the sprite for an emoji op at size, aliased or anti-aliased,
+// rasterizing it on a miss. The emoji's size x size box sits
+// canvas_emoji_margin(size) pixels inside the sprite's cell. The sprite
+// stays valid until the next lookup. Fails when the sprite can't fit in the
+// atlas, or would evict others while the atlas is thrashing.
+bool emoji_atlas_lookup(EmojiAtlas* atlas, CanvasCmdOp op, int size, bool antialias,
+                        EmojiSprite* sprite);
+
+#endif // ATLAS_H
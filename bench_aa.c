@@ -0,0 +1,78 @@
+// Anti-aliasing benchmark: lines, circles and emoji drawn aliased and
+// anti-aliased, at several sizes and stroke widths.
+//
+//   cc -O2 -std=c11 bench_aa.c atlas.c canvas.c span.c rectbatch.c -lm -o bench_aa
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "canvas.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_DRAWS 2000
+
+typedef enum {
+    SHAPE_LINE,
+    SHAPE_CIRCLE,
+    SHAPE_FILL_CIRCLE,
+    SHAPE_SMILE,
+    SHAPE_LEAF
+} Shape;
+
+static const char* const shape_names[] = {"line", "circle", "fill", "smile", "leaf"};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void draw(Canvas* canvas, Shape shape, int i, int size) {
+    int x = 8 + i % 7, y = 8 + i % 5;
+    switch (shape) {
+    case SHAPE_LINE: canvas_draw_line(canvas, x, y, x + size, y + size * (i % 4) / 3); break;
+    case SHAPE_CIRCLE: canvas_draw_circle(canvas, x + size / 2, y + size / 2, size / 2); break;
+    case SHAPE_FILL_CIRCLE: canvas_fill_circle(canvas, x + size / 2, y + size / 2, size / 2); break;
+    case SHAPE_SMILE: canvas_draw_emoji_smile(canvas, x, y, size); break;
+    case SHAPE_LEAF: canvas_draw_emoji_leaf(canvas, x, y, size); break;
+    }
+}
+
+// Microseconds per shape.
+static double time_draws(Canvas* canvas, Shape shape, int size, bool antialias) {
+    canvas_clear(canvas);
+    canvas_set_antialias(canvas, antialias);
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_DRAWS; i++) draw(canvas, shape, i, size);
+    return (now_seconds() - start) / BENCH_DRAWS * 1e6;
+}
+
+int main(void) {
+    Canvas* canvas = canvas_create(600, 600);
+    if (!canvas) {
+        fprintf(stderr, "failed to allocate canvas\n");
+        return 1;
+    }
+    canvas_set_fill_color(canvas, (Color){40, 120, 200, 255});
+
+    static const int sizes[] = {16, 64, 256};
+    static const int widths[] = {1, 4};
+    printf("%-7s %5s %5s %10s %10s %7s\n", "shape", "size", "width", "aliased us", "aa us", "ratio");
+    for (int s = SHAPE_LINE; s <= SHAPE_LEAF; s++) {
+        for (int i = 0; i < 3; i++) {
+            for (int w = 0; w < 2; w++) {
+                // Emoji pick their own stroke widths.
+                if (s >= SHAPE_SMILE && w > 0) continue;
+                canvas_set_stroke_width(canvas, widths[w]);
+                double aliased = time_draws(canvas, (Shape)s, sizes[i], false);
+                double smooth = time_draws(canvas, (Shape)s, sizes[i], true);
+                printf("%-7s %5d %5d %10.2f %10.2f %7.2f\n", shape_names[s], sizes[i], widths[w],
+                       aliased, smooth, smooth / aliased);
+            }
+        }
+    }
+
+    canvas_destroy(canvas);
+    return 0;
+}
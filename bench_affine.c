@@ -0,0 +1,65 @@
+// Affine blit benchmark: spin and pulse frames at several sizes, drawn by
+// rasterizing each frame and by rotating or scaling the atlas sprite with
+// nearest and bilinear sampling.
+//
+//   cc -O2 -std=c11 bench_affine.c atlas.c canvas.c span.c rectbatch.c -lm -o bench_affine
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "canvas.h"
+#include "atlas.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_FRAMES 2000
+
+typedef void (*AnimateFn)(Canvas* canvas, int x, int y, int size, AnimationState* anim);
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Microseconds per emoji frame, stepping through the animation.
+static double time_frames(Canvas* canvas, AnimateFn animate, int size) {
+    canvas_clear(canvas);
+    double start = now_seconds();
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        AnimationState anim = {(float)(f % 97) / 97.0f, 1.0f, true};
+        animate(canvas, 16, 16, size, &anim);
+    }
+    return (now_seconds() - start) / BENCH_FRAMES * 1e6;
+}
+
+static void run(const char* name, AnimateFn animate, Canvas* canvas, EmojiAtlas* atlas) {
+    static const int sizes[] = {32, 64, 128, 256};
+    for (int i = 0; i < 4; i++) {
+        canvas_set_emoji_atlas(canvas, NULL);
+        double raster = time_frames(canvas, animate, sizes[i]);
+        canvas_set_emoji_atlas(canvas, atlas);
+        canvas_set_sampling(canvas, CANVAS_SAMPLE_NEAREST);
+        double nearest = time_frames(canvas, animate, sizes[i]);
+        canvas_set_sampling(canvas, CANVAS_SAMPLE_BILINEAR);
+        double bilinear = time_frames(canvas, animate, sizes[i]);
+        printf("%-6s %5d %10.2f %10.2f %10.2f\n", name, sizes[i], raster, nearest, bilinear);
+    }
+}
+
+int main(void) {
+    Canvas* canvas = canvas_create(400, 400);
+    EmojiAtlas* atlas = emoji_atlas_create(EMOJI_ATLAS_DEFAULT_SIZE, EMOJI_ATLAS_DEFAULT_SIZE);
+    if (!canvas || !atlas) {
+        fprintf(stderr, "failed to allocate canvases\n");
+        return 1;
+    }
+
+    printf("%-6s %5s %10s %10s %10s\n", "anim", "size", "raster us", "nearest us", "bilinear us");
+    run("spin", canvas_animate_emoji_spin, canvas, atlas);
+    run("pulse", canvas_animate_emoji_pulse, canvas, atlas);
+
+    emoji_atlas_destroy(atlas);
+    canvas_destroy(canvas);
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Animation benchmark: stepping 100k animated smileys per tick, one
+// AnimationState at a time against the structure-of-arrays system, then
+// checking both end up in the same poses.
+//
+//   cc -O2 -std=c11 bench_anim.c animation.c canvas.c atlas.c span.c rectbatch.c -lm -o bench_anim
+
+#define _GNU_SOURCE
+
+#include "animation.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ANIMATIONS 100000
+#define TICKS 200
+// The system's vector sines are approximations, so poses may land a pixel
+// or a hair of an angle away from libm's.
+#define POSE_PIXELS 1
+#define POSE_RADIANS 1e-3f
+
+typedef struct {
+    AnimationType type;
+    AnimationState state;
+    int x, y, size;
+    int draw_x, draw_y, draw_size;
+    float angle;
+} Sprite;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// What a caller does today: advance each state, then pose it the way the
+// canvas would.
+static void step_sprites(Sprite* sprites, int count, float dt) {
+    for (int i = 0; i < count; i++) {
+        Sprite* s = &sprites[i];
+        s->state.progress = fmodf(s->state.progress + dt, s->state.duration);
+        float t = s->state.progress / s->state.duration;
+        s->draw_x = s->x;
+        s->draw_y = s->y;
+        s->draw_size = s->size;
+        s->angle = 0.0f;
+        switch (s->type) {
+        case ANIMATION_BOUNCE:
+            s->draw_y -= (int)lroundf(sinf(3.14159265f * t) * s->size * 0.2f);
+            break;
+        case ANIMATION_PULSE: {
+            int scaled = (int)lroundf(s->size * (1.0f + 0.2f * sinf(3.14159265f * t)));
+            s->draw_x -= (scaled - s->size) / 2;
+            s->draw_y -= (scaled - s->size) / 2;
+            s->draw_size = scaled;
+            break;
+        }
+        case ANIMATION_SPIN:
+            s->angle = 2.0f * 3.14159265f * t;
+            break;
+        case ANIMATION_WIGGLE:
+            s->angle = -(3.14159265f / 18.0f) * sinf(2.0f * 3.14159265f * t);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Angles a full turn apart are the same pose.
+static float angle_diff(float a, float b) {
+    float d = fabsf(fmodf(a - b, 2.0f * 3.14159265f));
+    return fminf(d, 2.0f * 3.14159265f - d);
+}
+
+static int count_mismatches(const Sprite* sprites, const AnimationSystem* system) {
+    int mismatches = 0;
+    for (int i = 0; i < system->count; i++) {
+        const Sprite* s = &sprites[i];
+        if (abs(s->draw_x - system->draw_x[i]) > POSE_PIXELS ||
+            abs(s->draw_y - system->draw_y[i]) > POSE_PIXELS ||
+            abs(s->draw_size - system->draw_size[i]) > POSE_PIXELS ||
+            angle_diff(s->angle, system->angle[i]) > POSE_RADIANS) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(void) {
+    Sprite* sprites = malloc(ANIMATIONS * sizeof(Sprite));
+    AnimationSystem* system = animation_system_create(ANIMATIONS);
+    if (!sprites || !system) return 1;
+
+    srand(1);
+    for (int i = 0; i < ANIMATIONS; i++) {
+        AnimationType type = (AnimationType)(i % ANIMATION_NONE);
+        int x = rand() % 1920, y = rand() % 1080, size = 16 + rand() % 64;
+        float duration = 0.5f + (rand() % 100) / 100.0f;
+        sprites[i] = (Sprite){type, {0.0f, duration, true}, x, y, size, x, y, size, 0.0f};
+        animation_system_add(system, type, x, y, size, duration, true);
+    }
+
+    double start = now_seconds();
+    for (int t = 0; t < TICKS; t++) {
+        step_sprites(sprites, ANIMATIONS, 1.0f / 60.0f);
+    }
+    double structs = (now_seconds() - start) / TICKS;
+
+    start = now_seconds();
+    for (int t = 0; t < TICKS; t++) {
+        animation_system_step(system, 1.0f / 60.0f);
+    }
+    double soa = (now_seconds() - start) / TICKS;
+
+    printf("%-16s %10s\n", "step", "us/tick");
+    printf("%-16s %10.1f\n", "AnimationState", structs * 1e6);
+    printf("%-16s %10.1f  (%.1fx)\n", "AnimationSystem", soa * 1e6, structs / soa);
+
+    int mismatches = count_mismatches(sprites, system);
+    printf("\n%d of %d poses differ\n", mismatches, ANIMATIONS);
+
+    animation_system_destroy(system);
+    free(sprites);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,413 @@
+// Canvas benchmark suite: the canvas.h primitives at several resolutions,
+// on scenes generated from fixed seeds so every run draws the same pixels.
+// Each case reports ns per call, pixels covered per second and heap
+// allocations per call, and the results can be saved as JSON so two runs
+// can be diffed (`make bench` does both).
+//
+//   bench_canvas [--json FILE] [--min-time SECONDS] [--filter SCENE]
+//
+// Allocations are counted by wrapping the allocator at link time; built
+// without the wrap they are left out of the report.
+//
+//   cc -O2 -std=c11 -DBENCH_COUNT_ALLOCS bench_canvas.c animation.c canvas.c atlas.c span.c rectbatch.c -lm -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=aligned_alloc -o bench_canvas
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "animation.h"
+#include "atlas.h"
+#include "canvas.h"
+#include "span.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Distinct shapes per scene; calls cycle through them.
+#define SCENE_SHAPES 1024
+#define SCENE_SMILEYS 200
+#define DEFAULT_MIN_SECONDS 0.2
+
+static const char* ppm_path = "/tmp/bench_canvas.ppm";
+
+#ifdef BENCH_COUNT_ALLOCS
+static size_t alloc_count;
+static size_t alloc_bytes;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* p, size_t size);
+void* __real_aligned_alloc(size_t alignment, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    alloc_count++;
+    alloc_bytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* p, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(p, size);
+}
+
+void* __wrap_aligned_alloc(size_t alignment, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_aligned_alloc(alignment, size);
+}
+#define COUNTING_ALLOCS true
+#else
+static size_t alloc_count;
+static size_t alloc_bytes;
+#define COUNTING_ALLOCS false
+#endif
+
+typedef struct {
+    const char* name;
+    int width;
+    int height;
+} Resolution;
+
+static const Resolution resolutions[] = {
+    {"qvga", 320, 240},
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+};
+
+// A rect (x, y, w, h), circle (x, y, r) or line (x, y to w, h), with the
+// pixels it covers inside the canvas.
+typedef struct {
+    int x, y, w, h;
+    double pixels;
+} Shape;
+
+typedef struct {
+    Canvas* canvas;
+    int width;
+    int height;
+    uint32_t seed;
+    Shape shapes[SCENE_SHAPES];
+    int emoji_size;
+    EmojiAtlas* atlas;
+    AnimationSystem* animations;
+} Scene;
+
+typedef struct {
+    const char* name;
+    void (*setup)(Scene* scene);
+    // Draws call number i and returns the pixels it covered.
+    double (*run)(Scene* scene, int i);
+} SceneBench;
+
+typedef struct {
+    const char* scene;
+    const Resolution* resolution;
+    long calls;
+    double ns_per_call;
+    double pixels_per_second;
+    double allocs_per_call;
+    double alloc_bytes_per_call;
+} Result;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Own generator rather than rand(), so scenes match across C libraries.
+static uint32_t next_random(Scene* scene) {
+    scene->seed = scene->seed * 1664525u + 1013904223u;
+    return scene->seed >> 8;
+}
+
+static int random_below(Scene* scene, int limit) {
+    return limit > 0 ? (int)(next_random(scene) % (uint32_t)limit) : 0;
+}
+
+static double clipped_area(const Scene* scene, int x, int y, int w, int h) {
+    int x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int x1 = x + w > scene->width ? scene->width : x + w;
+    int y1 = y + h > scene->height ? scene->height : y + h;
+    return x1 > x0 && y1 > y0 ? (double)(x1 - x0) * (y1 - y0) : 0.0;
+}
+
+static void setup_rects(Scene* scene) {
+    for (int i = 0; i < SCENE_SHAPES; i++) {
+        Shape* s = &scene->shapes[i];
+        s->w = 1 + random_below(scene, scene->width / 4);
+        s->h = 1 + random_below(scene, scene->height / 4);
+        s->x = random_below(scene, scene->width) - s->w / 2;
+        s->y = random_below(scene, scene->height) - s->h / 2;
+        s->pixels = clipped_area(scene, s->x, s->y, s->w, s->h);
+    }
+}
+
+static void setup_circles(Scene* scene) {
+    int max_radius = (scene->width < scene->height ? scene->width : scene->height) / 8;
+    for (int i = 0; i < SCENE_SHAPES; i++) {
+        Shape* s = &scene->shapes[i];
+        s->x = random_below(scene, scene->width);
+        s->y = random_below(scene, scene->height);
+        s->w = 1 + random_below(scene, max_radius);
+        s->pixels = 0;
+        for (int dy = -s->w; dy <= s->w; dy++) {
+            int half = (int)sqrt((double)s->w * s->w - (double)dy * dy);
+            s->pixels += clipped_area(scene, s->x - half, s->y + dy, 2 * half + 1, 1);
+        }
+    }
+}
+
+static void setup_lines(Scene* scene) {
+    for (int i = 0; i < SCENE_SHAPES; i++) {
+        Shape* s = &scene->shapes[i];
+        s->x = random_below(scene, scene->width);
+        s->y = random_below(scene, scene->height);
+        s->w = random_below(scene, scene->width);
+        s->h = random_below(scene, scene->height);
+        int dx = abs(s->w - s->x), dy = abs(s->h - s->y);
+        s->pixels = (dx > dy ? dx : dy) + 1;
+    }
+}
+
+static void setup_emoji(Scene* scene) {
+    scene->emoji_size = scene->height / 6;
+    for (int i = 0; i < SCENE_SHAPES; i++) {
+        Shape* s = &scene->shapes[i];
+        s->x = random_below(scene, scene->width - scene->emoji_size);
+        s->y = random_below(scene, scene->height - scene->emoji_size);
+        s->pixels = (double)scene->emoji_size * scene->emoji_size;
+    }
+}
+
+static void setup_emoji_atlas(Scene* scene) {
+    setup_emoji(scene);
+    scene->atlas = emoji_atlas_create(EMOJI_ATLAS_DEFAULT_SIZE, EMOJI_ATLAS_DEFAULT_SIZE);
+    canvas_set_emoji_atlas(scene->canvas, scene->atlas);
+}
+
+static void setup_animation(Scene* scene) {
+    scene->animations = animation_system_create(SCENE_SMILEYS);
+    int max_size = scene->height / 8;
+    for (int i = 0; scene->animations && i < SCENE_SMILEYS; i++) {
+        int size = 8 + random_below(scene, max_size);
+        int x = random_below(scene, scene->width - size), y = random_below(scene, scene->height - size);
+        float duration = 0.5f + random_below(scene, 100) / 100.0f;
+        animation_system_add(scene->animations, (AnimationType)(i % ANIMATION_NONE), x, y, size, duration, true);
+    }
+}
+
+static double whole_canvas(const Scene* scene) {
+    return (double)scene->width * scene->height;
+}
+
+static double run_clear(Scene* scene, int i) {
+    canvas_set_clear_color(scene->canvas, (i & 1) ? NEUTRAL_WHITE : NEUTRAL_LIGHT);
+    canvas_clear(scene->canvas);
+    return whole_canvas(scene);
+}
+
+static double run_fill_rect(Scene* scene, int i) {
+    const Shape* s = &scene->shapes[i % SCENE_SHAPES];
+    canvas_set_fill_color(scene->canvas, (i & 1) ? NEUTRAL_DARK : NEUTRAL_MID);
+    canvas_fill_rect(scene->canvas, s->x, s->y, s->w, s->h);
+    return s->pixels;
+}
+
+static double run_blend_rect(Scene* scene, int i) {
+    const Shape* s = &scene->shapes[i % SCENE_SHAPES];
+    canvas_set_fill_color(scene->canvas, (Color){107, 107, 107, (i & 1) ? 64 : 192});
+    canvas_fill_rect(scene->canvas, s->x, s->y, s->w, s->h);
+    return s->pixels;
+}
+
+static double run_fill_circle(Scene* scene, int i) {
+    const Shape* s = &scene->shapes[i % SCENE_SHAPES];
+    canvas_set_fill_color(scene->canvas, (i & 1) ? NEUTRAL_DARK : NEUTRAL_MID);
+    canvas_fill_circle(scene->canvas, s->x, s->y, s->w);
+    return s->pixels;
+}
+
+static double run_line(Scene* scene, int i) {
+    const Shape* s = &scene->shapes[i % SCENE_SHAPES];
+    canvas_set_stroke_color(scene->canvas, (i & 1) ? NEUTRAL_TEXT : NEUTRAL_DARK);
+    canvas_draw_line(scene->canvas, s->x, s->y, s->w, s->h);
+    return s->pixels;
+}
+
+static double run_line_aa(Scene* scene, int i) {
+    canvas_set_antialias(scene->canvas, true);
+    double pixels = run_line(scene, i);
+    canvas_set_antialias(scene->canvas, false);
+    return pixels;
+}
+
+static double run_emoji(Scene* scene, int i) {
+    static void (*const draw[])(Canvas*, int, int, int) = {
+        canvas_draw_emoji_smile, canvas_draw_emoji_leaf, canvas_draw_emoji_coffee,
+        canvas_draw_emoji_moon, canvas_draw_emoji_sparkle,
+    };
+    const Shape* s = &scene->shapes[i % SCENE_SHAPES];
+    draw[i % 5](scene->canvas, s->x, s->y, scene->emoji_size);
+    return s->pixels;
+}
+
+// One frame of a page of animated smileys: clear, step, draw.
+static double run_animation(Scene* scene, int i) {
+    (void)i;
+    canvas_clear(scene->canvas);
+    animation_system_step(scene->animations, 1.0f / 60.0f);
+    animation_system_draw(scene->animations, scene->canvas);
+    return whole_canvas(scene);
+}
+
+static double run_ppm(Scene* scene, int i) {
+    (void)i;
+    canvas_save_to_ppm(scene->canvas, ppm_path);
+    return whole_canvas(scene);
+}
+
+static const SceneBench scenes[] = {
+    {"clear", NULL, run_clear},
+    {"fill_rect", setup_rects, run_fill_rect},
+    {"blend_rect", setup_rects, run_blend_rect},
+    {"fill_circle", setup_circles, run_fill_circle},
+    {"line", setup_lines, run_line},
+    {"line_aa", setup_lines, run_line_aa},
+    {"emoji", setup_emoji, run_emoji},
+    {"emoji_atlas", setup_emoji_atlas, run_emoji},
+    {"animation_frame", setup_animation, run_animation},
+    {"ppm_export", NULL, run_ppm},
+};
+
+// Calls run in batches that double until the case has run min_seconds, so
+// reading the clock costs nothing next to fast calls.
+static bool run_case(const SceneBench* bench, const Resolution* res, double min_seconds, Result* result) {
+    Scene* scene = calloc(1, sizeof(Scene));
+    if (!scene) return false;
+    scene->width = res->width;
+    scene->height = res->height;
+    scene->seed = 1;
+    scene->canvas = canvas_create(res->width, res->height);
+    if (!scene->canvas) {
+        free(scene);
+        return false;
+    }
+    canvas_set_clear_color(scene->canvas, NEUTRAL_WHITE);
+    canvas_clear(scene->canvas);
+    if (bench->setup) bench->setup(scene);
+
+    // One untimed call, so first-use caches are warm.
+    bench->run(scene, 0);
+    alloc_count = 0;
+    alloc_bytes = 0;
+
+    long calls = 0, batch = 1;
+    double pixels = 0, start = now_seconds(), elapsed;
+    do {
+        for (long i = 0; i < batch; i++) pixels += bench->run(scene, (int)((calls + i) % SCENE_SHAPES));
+        calls += batch;
+        batch *= 2;
+    } while ((elapsed = now_seconds() - start) < min_seconds);
+
+    *result = (Result){
+        bench->name, res, calls, elapsed / calls * 1e9, pixels / elapsed,
+        (double)alloc_count / calls, (double)alloc_bytes / calls,
+    };
+
+    animation_system_destroy(scene->animations);
+    canvas_destroy(scene->canvas);
+    emoji_atlas_destroy(scene->atlas);
+    free(scene);
+    return true;
+}
+
+static void print_result(const Result* r) {
+    printf("%-16s %-6s %12.1f %10.1f", r->scene, r->resolution->name, r->ns_per_call,
+           r->pixels_per_second / 1e6);
+    if (COUNTING_ALLOCS) printf(" %10.2f %12.1f", r->allocs_per_call, r->alloc_bytes_per_call);
+    printf("\n");
+    fflush(stdout);
+}
+
+static bool save_json(const char* path, const Result* results, int count) {
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    fprintf(file, "{\n  \"suite\": \"canvas\",\n  \"span_kernel\": \"%s\",\n",
+            span_kernel_name(span_get_kernel()));
+    fprintf(file, "  \"counts_allocations\": %s,\n  \"results\": [\n", COUNTING_ALLOCS ? "true" : "false");
+    for (int i = 0; i < count; i++) {
+        const Result* r = &results[i];
+        fprintf(file,
+                "    {\"scene\": \"%s\", \"resolution\": \"%s\", \"width\": %d, \"height\": %d, "
+                "\"calls\": %ld, \"ns_per_op\": %.1f, \"pixels_per_second\": %.0f",
+                r->scene, r->resolution->name, r->resolution->width, r->resolution->height, r->calls,
+                r->ns_per_call, r->pixels_per_second);
+        if (COUNTING_ALLOCS) {
+            fprintf(file, ", \"allocations_per_op\": %.3f, \"allocated_bytes_per_op\": %.1f",
+                    r->allocs_per_call, r->alloc_bytes_per_call);
+        }
+        fprintf(file, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+static int usage(const char* program) {
+    fprintf(stderr, "usage: %s [--json FILE] [--min-time SECONDS] [--filter SCENE]\n", program);
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    const char* json_path = NULL;
+    const char* filter = NULL;
+    double min_seconds = DEFAULT_MIN_SECONDS;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "--json") == 0) {
+            json_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "--min-time") == 0) {
+            min_seconds = strtod(argv[++i], NULL);
+        } else if (i + 1 < argc && strcmp(argv[i], "--filter") == 0) {
+            filter = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    enum { SCENES = sizeof(scenes) / sizeof(scenes[0]) };
+    enum { RESOLUTIONS = sizeof(resolutions) / sizeof(resolutions[0]) };
+    static Result results[SCENES * RESOLUTIONS];
+    int count = 0;
+
+    printf("span kernel %s\n", span_kernel_name(span_get_kernel()));
+    printf("%-16s %-6s %12s %10s", "scene", "size", "ns/op", "Mpixels/s");
+    if (COUNTING_ALLOCS) printf(" %10s %12s", "allocs/op", "bytes/op");
+    printf("\n");
+    for (int s = 0; s < SCENES; s++) {
+        if (filter && strcmp(filter, scenes[s].name) != 0) continue;
+        for (int r = 0; r < RESOLUTIONS; r++) {
+            if (!run_case(&scenes[s], &resolutions[r], min_seconds, &results[count])) {
+                fprintf(stderr, "%s at %s: out of memory\n", scenes[s].name, resolutions[r].name);
+                return 1;
+            }
+            print_result(&results[count++]);
+        }
+    }
+    unlink(ppm_path);
+
+    if (json_path && !save_json(json_path, results, count)) {
+        fprintf(stderr, "could not write %s\n", json_path);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Effects benchmark: box blurs of a card and of a 1080p frame at growing
+// radii, once as a direct 2D mean over the square, as an offline tool would
+// run it, and once through effects_box_blur with each span kernel set.
+// Direct blurs only run where they finish in reasonable time, and every
+// effects result is checked against them byte for byte. Then a gaussian
+// and the card hover shadow, per frame.
+//
+//   cc -O2 -std=c11 bench_effects.c effects.c canvas.c atlas.c span.c rectbatch.c -lm -o bench_effects
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "effects.h"
+#include "span.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CARD_WIDTH 240
+#define CARD_HEIGHT 160
+#define FRAME_WIDTH 1920
+#define FRAME_HEIGHT 1080
+// Direct blurs reading more pixels than this in all are skipped.
+#define DIRECT_MAX_READS 400000000.0
+// Each timing repeats for at least this long.
+#define MIN_SECONDS 0.2
+
+static const int radii[] = {2, 8, 32, 128};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill_noise(Canvas* canvas) {
+    for (int y = 0; y < canvas->height; y++) {
+        Color* row = canvas_row(canvas, y);
+        for (int x = 0; x < canvas->width; x++) {
+            row[x] = (Color){rand() % 256, rand() % 256, rand() % 256, 255};
+        }
+    }
+}
+
+static void copy_pixels(Canvas* dst, const Canvas* src) {
+    for (int y = 0; y < src->height; y++) {
+        memcpy(canvas_row(dst, y), canvas_row(src, y), (size_t)src->width * sizeof(Color));
+    }
+}
+
+static uint8_t mean(uint32_t sum, int window) {
+    return (uint8_t)(int32_t)((float)(int32_t)sum * (1.0f / (float)window) + 0.5f);
+}
+
+static int clamp(int v, int last) {
+    return v < 0 ? 0 : v > last ? last : v;
+}
+
+// Reads the whole square for every pixel, but rounds each row's mean as
+// effects_box_blur rounds after its horizontal pass, so results compare
+// exactly.
+static void direct_box_blur(Canvas* dst, const Canvas* src, int radius) {
+    int w = src->width, h = src->height, n = 2 * radius + 1;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int ky = -radius; ky <= radius; ky++) {
+                const uint8_t* row = (const uint8_t*)canvas_row(src, clamp(y + ky, h - 1));
+                uint32_t line[4] = {0, 0, 0, 0};
+                for (int kx = -radius; kx <= radius; kx++) {
+                    const uint8_t* p = row + (size_t)clamp(x + kx, w - 1) * sizeof(Color);
+                    for (int c = 0; c < 4; c++) line[c] += p[c];
+                }
+                for (int c = 0; c < 4; c++) sum[c] += mean(line[c], n);
+            }
+            uint8_t* d = (uint8_t*)(canvas_row(dst, y) + x);
+            for (int c = 0; c < 4; c++) d[c] = mean(sum[c], n);
+        }
+    }
+}
+
+static int count_mismatches(const Canvas* a, const Canvas* b) {
+    int rows = 0;
+    for (int y = 0; y < a->height; y++) {
+        rows += memcmp(canvas_row(a, y), canvas_row(b, y), (size_t)a->width * sizeof(Color)) != 0;
+    }
+    return rows;
+}
+
+static void print_row(const char* size, int radius, const char* mode, double seconds, int pixels,
+                      double direct, int mismatches) {
+    char speedup[16] = "";
+    if (direct > 0) snprintf(speedup, sizeof(speedup), "%.0fx", direct / seconds);
+    printf("%-6s %6d %-7s %10.3f %10.2f %8s %10d\n", size, radius, mode, seconds * 1e3,
+           seconds / pixels * 1e9, speedup, mismatches);
+}
+
+// Blurs a fresh copy of src each round; the copy is timed too, but costs
+// a memcpy per row against the passes.
+static double time_box_blur(Effects* fx, Canvas* work, const Canvas* src, int radius) {
+    Rect all = rect_make(0, 0, (float)src->width, (float)src->height);
+    int rounds = 0;
+    double start = now_seconds(), elapsed;
+    do {
+        copy_pixels(work, src);
+        effects_box_blur(fx, work, all, radius);
+        rounds++;
+    } while ((elapsed = now_seconds() - start) < MIN_SECONDS);
+    return elapsed / rounds;
+}
+
+static void bench_size(Effects* fx, const char* size, int width, int height) {
+    static const char* names[SPAN_KERNEL_COUNT] = {"scalar", "sse2", "avx2"};
+    Canvas* src = canvas_create(width, height);
+    Canvas* work = canvas_create(width, height);
+    Canvas* expect = canvas_create(width, height);
+    if (!src || !work || !expect) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    fill_noise(src);
+    int pixels = width * height;
+
+    for (size_t i = 0; i < sizeof(radii) / sizeof(radii[0]); i++) {
+        int r = radii[i], n = 2 * r + 1;
+        double direct = 0;
+        if ((double)pixels * n * n <= DIRECT_MAX_READS) {
+            double start = now_seconds();
+            direct_box_blur(expect, src, r);
+            direct = now_seconds() - start;
+            print_row(size, r, "direct", direct, pixels, 0, 0);
+        }
+        for (int k = 0; k < SPAN_KERNEL_COUNT; k++) {
+            if (!span_set_kernel((SpanKernel)k)) continue;
+            double seconds = time_box_blur(fx, work, src, r);
+            int mismatches = direct > 0 ? count_mismatches(work, expect) : 0;
+            print_row(size, r, names[k], seconds, pixels, direct, mismatches);
+        }
+    }
+
+    canvas_destroy(expect);
+    canvas_destroy(work);
+    canvas_destroy(src);
+}
+
+// Hover shadows as a card preview draws them: the card over the page.
+static void bench_shadow(Effects* fx) {
+    Canvas* page = canvas_create(CARD_WIDTH + 64, CARD_HEIGHT + 64);
+    Canvas* card = canvas_create(CARD_WIDTH, CARD_HEIGHT);
+    if (!page || !card) return;
+    canvas_set_fill_color(card, NEUTRAL_LIGHT);
+    canvas_fill_rect(card, 0, 0, CARD_WIDTH, CARD_HEIGHT);
+    canvas_set_clear_color(page, (Color){255, 255, 255, 255});
+
+    int rounds = 0;
+    double start = now_seconds(), elapsed;
+    do {
+        canvas_clear(page);
+        effects_drop_shadow(fx, page, card, 32, 32, &CARD_HOVER_SHADOW);
+        rounds++;
+    } while ((elapsed = now_seconds() - start) < MIN_SECONDS);
+    printf("hover shadow, %dx%d card: %.3f ms\n", CARD_WIDTH, CARD_HEIGHT, elapsed / rounds * 1e3);
+
+    Canvas* frame = canvas_create(FRAME_WIDTH, FRAME_HEIGHT);
+    if (frame) {
+        fill_noise(frame);
+        Rect all = rect_make(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
+        rounds = 0;
+        start = now_seconds();
+        do {
+            effects_gaussian_blur(fx, frame, all, 6.0f);
+            rounds++;
+        } while ((elapsed = now_seconds() - start) < MIN_SECONDS);
+        printf("gaussian, sigma 6, %dx%d: %.3f ms\n", FRAME_WIDTH, FRAME_HEIGHT, elapsed / rounds * 1e3);
+        canvas_destroy(frame);
+    }
+    canvas_destroy(card);
+    canvas_destroy(page);
+}
+
+int main(void) {
+    Effects* fx = effects_create();
+    if (!fx) return 1;
+    srand(1);
+    SpanKernel best = span_get_kernel();
+    printf("%-6s %6s %-7s %10s %10s %8s %10s\n", "size", "radius", "mode", "ms", "ns/px", "speedup",
+           "mismatches");
+    bench_size(fx, "card", CARD_WIDTH, CARD_HEIGHT);
+    bench_size(fx, "1080p", FRAME_WIDTH, FRAME_HEIGHT);
+    span_set_kernel(best);
+    bench_shadow(fx);
+    effects_destroy(fx);
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Span-fill microbenchmark: reports GB/s written by canvas_clear,
+// canvas_fill_rect and canvas_fill_circle for every span kernel the CPU
+// supports.
+//
+//   cc -O2 -std=c11 bench_fill.c canvas.c atlas.c span.c rectbatch.c -lm -o bench_fill
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "canvas.h"
+#include "span.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_MIN_SECONDS 0.25
+
+typedef struct {
+    const char* name;
+    void (*run)(Canvas* canvas);
+    size_t (*bytes)(const Canvas* canvas);
+} FillBench;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run_clear(Canvas* canvas) {
+    canvas_clear(canvas);
+}
+
+static size_t bytes_clear(const Canvas* canvas) {
+    return (size_t)canvas->width * canvas->height * sizeof(Color);
+}
+
+// An inset rect so every row is a partial span.
+static void run_rect(Canvas* canvas) {
+    canvas_fill_rect(canvas, 1, 1, canvas->width - 2, canvas->height - 2);
+}
+
+static size_t bytes_rect(const Canvas* canvas) {
+    return (size_t)(canvas->width - 2) * (canvas->height - 2) * sizeof(Color);
+}
+
+static int circle_radius(const Canvas* canvas) {
+    int d = canvas->width < canvas->height ? canvas->width : canvas->height;
+    return d / 2 - 1;
+}
+
+static void run_circle(Canvas* canvas) {
+    canvas_fill_circle(canvas, canvas->width / 2, canvas->height / 2, circle_radius(canvas));
+}
+
+static size_t bytes_circle(const Canvas* canvas) {
+    long long r = circle_radius(canvas);
+    size_t pixels = 0;
+    for (long long dy = -r; dy <= r; dy++) {
+        long long hw = 0;
+        while ((hw + 1) * (hw + 1) + dy * dy <= r * r) hw++;
+        pixels += (size_t)(2 * hw + 1);
+    }
+    return pixels * sizeof(Color);
+}
+
+static const FillBench benches[] = {
+    {"clear", run_clear, bytes_clear},
+    {"fill_rect", run_rect, bytes_rect},
+    {"fill_circle", run_circle, bytes_circle},
+};
+
+static double measure(const FillBench* bench, Canvas* canvas) {
+    bench->run(canvas);  // warm up
+
+    long iterations = 0;
+    double start = now_seconds();
+    double elapsed;
+    do {
+        bench->run(canvas);
+        iterations++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    return (double)bench->bytes(canvas) * iterations / elapsed / 1e9;
+}
+
+int main(void) {
+    const int sizes[][2] = {{256, 256}, {1920, 1080}, {3840, 2160}};
+    SpanKernel best = span_get_kernel();
+
+    printf("%-12s %-12s %-8s %10s\n", "size", "primitive", "kernel", "GB/s");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        Canvas* canvas = canvas_create(sizes[s][0], sizes[s][1]);
+        if (!canvas) {
+            fprintf(stderr, "failed to allocate %dx%d canvas\n", sizes[s][0], sizes[s][1]);
+            return 1;
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "%dx%d", canvas->width, canvas->height);
+
+        for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+            for (int k = 0; k < SPAN_KERNEL_COUNT; k++) {
+                if (!span_set_kernel((SpanKernel)k)) continue;
+                printf("%-12s %-12s %-8s %10.2f\n", label, benches[b].name,
+                       span_kernel_name((SpanKernel)k), measure(&benches[b], canvas));
+            }
+        }
+        canvas_destroy(canvas);
+    }
+
+    span_set_kernel(best);
+    return 0;
+}
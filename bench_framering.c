@@ -0,0 +1,168 @@
+// Frame ring benchmark: handing 720p frames to a forked reader process,
+// once through PPM files and a pipe, the way the encoder and preview got
+// them before, and once through a FrameRing. Handoff latency runs from the
+// writer finishing a frame to the reader holding its pixels, one frame at
+// a time. Throughput then lets the writer run ahead by a few buffers and
+// checks every frame arrives once and in order.
+//
+//   cc -O2 -std=c11 bench_framering.c framering.c canvas.c atlas.c span.c rectbatch.c -lm -o bench_framering
+
+#define _GNU_SOURCE
+
+#include "canvas.h"
+#include "framering.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_WIDTH 1280
+#define FRAME_HEIGHT 720
+#define PPM_FRAMES 100
+#define RING_FRAMES 2000
+#define RING_BUFFERS 4
+
+static const char* ppm_path = "/tmp/bench_framering.ppm";
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void draw_frame(Canvas* canvas, int frame) {
+    canvas_set_fill_color(canvas, NEUTRAL_DARK);
+    canvas_fill_rect(canvas, (frame * 7) % (canvas->width - 64), 100, 64, 64);
+}
+
+// The writer's clock when the frame was done, in its first two pixels.
+static void stamp(Canvas* canvas, uint64_t ns) {
+    memcpy(canvas_row(canvas, 0), &ns, sizeof(ns));
+}
+
+static uint64_t read_stamp(const Canvas* canvas) {
+    uint64_t ns;
+    memcpy(&ns, canvas_row(canvas, 0), sizeof(ns));
+    return ns;
+}
+
+static void report(const char* mode, uint64_t total_ns, uint64_t worst_ns, int frames) {
+    printf("%-18s %12.1f %12.1f\n", mode, total_ns / 1e3 / frames, worst_ns / 1e3);
+    fflush(stdout);
+}
+
+static int wait_child(pid_t pid) {
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+// Writer saves each frame and sends its stamp down a pipe; the reader loads
+// the file back and answers, so one frame is in flight at a time.
+static int bench_ppm(void) {
+    int to_reader[2], to_writer[2];
+    if (pipe(to_reader) != 0 || pipe(to_writer) != 0) return 1;
+
+    pid_t pid = fork();
+    if (pid < 0) return 1;
+    if (pid == 0) {
+        close(to_reader[1]);
+        close(to_writer[0]);
+        size_t bytes = (size_t)FRAME_WIDTH * FRAME_HEIGHT * 3 + 64;
+        uint8_t* frame = malloc(bytes);
+        uint64_t total = 0, worst = 0, ns;
+        int frames = 0;
+        while (frame && read(to_reader[0], &ns, sizeof(ns)) == sizeof(ns)) {
+            FILE* file = fopen(ppm_path, "rb");
+            if (!file) break;
+            size_t got = fread(frame, 1, bytes, file);
+            fclose(file);
+            uint64_t latency = now_ns() - ns;
+            total += latency;
+            if (latency > worst) worst = latency;
+            frames++;
+            if (got == 0 || write(to_writer[1], &got, 1) != 1) break;
+        }
+        report("ppm + pipe", total, worst, frames);
+        free(frame);
+        _exit(frames == PPM_FRAMES ? 0 : 1);
+    }
+
+    close(to_reader[0]);
+    close(to_writer[1]);
+    Canvas* canvas = canvas_create(FRAME_WIDTH, FRAME_HEIGHT);
+    char ack;
+    for (int f = 0; canvas && f < PPM_FRAMES; f++) {
+        draw_frame(canvas, f);
+        uint64_t ns = now_ns();
+        if (!canvas_save_to_ppm(canvas, ppm_path)) break;
+        if (write(to_reader[1], &ns, sizeof(ns)) != sizeof(ns)) break;
+        if (read(to_writer[0], &ack, 1) != 1) break;
+    }
+    close(to_reader[1]);
+    int failed = wait_child(pid);
+    canvas_destroy(canvas);
+    close(to_writer[0]);
+    unlink(ppm_path);
+    return failed;
+}
+
+static int run_ring_reader(int fd, const char* mode) {
+    FrameRing* ring = frame_ring_open_fd(fd);
+    if (!ring) return 1;
+    uint64_t total = 0, worst = 0, sequence;
+    int frames = 0;
+    bool in_order = true;
+    const Canvas* frame;
+    while ((frame = frame_ring_front(ring, &sequence))) {
+        uint64_t latency = now_ns() - read_stamp(frame);
+        total += latency;
+        if (latency > worst) worst = latency;
+        in_order = in_order && sequence == (uint64_t)frames;
+        frames++;
+        frame_ring_release(ring);
+    }
+    report(mode, total, worst, frames);
+    frame_ring_destroy(ring);
+    return frames == RING_FRAMES && in_order ? 0 : 1;
+}
+
+// With one buffer the writer waits for each frame to be released, so the
+// latency is the handoff alone; with more it also includes queueing.
+static int bench_ring(int buffers, const char* mode) {
+    FrameRing* ring = frame_ring_create(NULL, FRAME_WIDTH, FRAME_HEIGHT, buffers);
+    if (!ring) return 1;
+
+    pid_t pid = fork();
+    if (pid < 0) return 1;
+    if (pid == 0) _exit(run_ring_reader(frame_ring_fd(ring), mode));
+
+    uint64_t start = now_ns();
+    for (int f = 0; f < RING_FRAMES; f++) {
+        Canvas* canvas = frame_ring_back(ring);
+        draw_frame(canvas, f);
+        stamp(canvas, now_ns());
+        frame_ring_present(ring);
+    }
+    frame_ring_close(ring);
+    int failed = wait_child(pid);
+    double seconds = (now_ns() - start) * 1e-9;
+    printf("%-18s %12.0f frames/s\n", "", RING_FRAMES / seconds);
+    fflush(stdout);
+    frame_ring_destroy(ring);
+    return failed;
+}
+
+int main(void) {
+    printf("%dx%d frames to a forked reader\n", FRAME_WIDTH, FRAME_HEIGHT);
+    printf("%-18s %12s %12s\n", "mode", "mean us", "worst us");
+    fflush(stdout);
+    int failed = bench_ppm();
+    failed |= bench_ring(1, "ring, 1 buffer");
+    failed |= bench_ring(RING_BUFFERS, "ring, 4 buffers");
+    if (failed) printf("a reader missed or reordered frames\n");
+    return failed;
+}
@@ -0,0 +1,185 @@
+// Batched rect benchmark: a viewport cull, a hit test, a clip and an area
+// sum over a million boxes, one rect.h call per box against each
+// rectbatch kernel set. Throughput is in input bytes per nanosecond, so it
+// reads against memory bandwidth. Every batched result is checked against
+// the per-box one.
+//
+//   cc -O2 -std=c11 bench_rectbatch.c rectbatch.c span.c -lm -o bench_rectbatch
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rectbatch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BOX_COUNT (1 << 20)
+#define BENCH_ROUNDS 20
+#define WORLD_SIZE 8192
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    Rect* boxes;
+    RectColumns columns;
+    RectColumns clipped;
+    float* areas;
+    uint64_t* mask;
+    uint32_t* indices;
+} Data;
+
+static const Rect viewport = {1000.0f, 1500.0f, 1920.0f, 1080.0f};
+// Keeps counts nobody reads from being optimized away.
+static volatile size_t sink;
+
+static void print_row(const char* name, const char* kernel, double seconds, size_t bytes, int mismatches) {
+    printf("%-10s %-7s %9.3f %9.2f %10d\n", name, kernel, seconds / BOX_COUNT * 1e9,
+           bytes / (seconds * 1e9), mismatches);
+}
+
+// The scalar baseline works on the array of Rects, as callers did before.
+static void run_scalar(Data* d) {
+    size_t found = 0;
+    double start = now_seconds();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        found = 0;
+        for (size_t i = 0; i < BOX_COUNT; i++) {
+            if (rect_intersects_rect(d->boxes[i], viewport)) d->indices[found++] = (uint32_t)i;
+        }
+    }
+    double cull = (now_seconds() - start) / BENCH_ROUNDS;
+    print_row("cull", "rect.h", cull, BOX_COUNT * sizeof(Rect), 0);
+
+    start = now_seconds();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        found = 0;
+        for (size_t i = 0; i < BOX_COUNT; i++) found += rect_contains_point(d->boxes[i], 4000.0f, 4000.0f);
+        sink = found;
+    }
+    double hit = (now_seconds() - start) / BENCH_ROUNDS;
+    print_row("hit", "rect.h", hit, BOX_COUNT * sizeof(Rect), 0);
+
+    start = now_seconds();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (size_t i = 0; i < BOX_COUNT; i++) {
+            rect_columns_set(&d->clipped, i, rect_intersection(d->boxes[i], viewport));
+        }
+    }
+    double clip = (now_seconds() - start) / BENCH_ROUNDS;
+    print_row("clip", "rect.h", clip, BOX_COUNT * sizeof(Rect) * 2, 0);
+
+    start = now_seconds();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (size_t i = 0; i < BOX_COUNT; i++) d->areas[i] = rect_area(d->boxes[i]);
+    }
+    double area = (now_seconds() - start) / BENCH_ROUNDS;
+    print_row("area", "rect.h", area, BOX_COUNT * (sizeof(Rect) + sizeof(float)), 0);
+}
+
+static void run_batch(Data* d, SpanKernel kernel, const char* name) {
+    if (!rect_batch_set_kernel(kernel)) return;
+
+    int mismatches = 0;
+    size_t found = 0;
+    double start = now_seconds();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        rect_batch_intersects(&d->columns, viewport, d->mask);
+        found = rect_batch_select(d->mask, BOX_COUNT, d->indices);
+    }
+    double cull = (now_seconds() - start) / BENCH_ROUNDS;
+    size_t k = 0;
+    for (size_t i = 0; i < BOX_COUNT; i++) {
+        if (!rect_intersects_rect(d->boxes[i], viewport)) continue;
+        mismatches += k >= found || d->indices[k] != i;
+        k++;
+    }
+    mismatches += k != found;
+    print_row("cull", name, cull, BOX_COUNT * sizeof(Rect), mismatches);
+
+    mismatches = 0;
+    start = now_seconds();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        rect_batch_contains_point(&d->columns, 4000.0f, 4000.0f, d->mask);
+    }
+    double hit = (now_seconds() - start) / BENCH_ROUNDS;
+    for (size_t i = 0; i < BOX_COUNT; i++) {
+        bool bit = (d->mask[i / 64] >> (i % 64)) & 1;
+        mismatches += bit != rect_contains_point(d->boxes[i], 4000.0f, 4000.0f);
+    }
+    print_row("hit", name, hit, BOX_COUNT * sizeof(Rect), mismatches);
+
+    mismatches = 0;
+    start = now_seconds();
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        rect_batch_intersection(&d->columns, viewport, &d->clipped);
+    }
+    double clip = (now_seconds() - start) / BENCH_ROUNDS;
+    for (size_t i = 0; i < BOX_COUNT; i++) {
+        Rect expect = rect_intersection(d->boxes[i], viewport);
+        Rect got = rect_columns_get(&d->clipped, i);
+        mismatches += memcmp(&expect, &got, sizeof(Rect)) != 0;
+    }
+    print_row("clip", name, clip, BOX_COUNT * sizeof(Rect) * 2, mismatches);
+
+    mismatches = 0;
+    start = now_seconds();
+    for (int round = 0; round < BENCH_ROUNDS; round++) rect_batch_area(&d->columns, d->areas);
+    double area = (now_seconds() - start) / BENCH_ROUNDS;
+    for (size_t i = 0; i < BOX_COUNT; i++) mismatches += d->areas[i] != rect_area(d->boxes[i]);
+    print_row("area", name, area, BOX_COUNT * (sizeof(Rect) + sizeof(float)), mismatches);
+}
+
+static float* column(void) {
+    return malloc(BOX_COUNT * sizeof(float));
+}
+
+int main(void) {
+    Data d;
+    d.boxes = malloc(BOX_COUNT * sizeof(Rect));
+    d.columns = (RectColumns){column(), column(), column(), column(), BOX_COUNT};
+    d.clipped = (RectColumns){column(), column(), column(), column(), BOX_COUNT};
+    d.areas = column();
+    d.mask = malloc(RECT_BATCH_WORDS(BOX_COUNT) * sizeof(uint64_t));
+    d.indices = malloc(BOX_COUNT * sizeof(uint32_t));
+    if (!d.boxes || !d.columns.x || !d.columns.y || !d.columns.width || !d.columns.height ||
+        !d.clipped.x || !d.clipped.y || !d.clipped.width || !d.clipped.height || !d.areas ||
+        !d.mask || !d.indices) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    srand(1);
+    for (size_t i = 0; i < BOX_COUNT; i++) {
+        d.boxes[i] = rect_make((float)(rand() % WORLD_SIZE), (float)(rand() % WORLD_SIZE),
+                               (float)(rand() % 200), (float)(rand() % 200));
+        rect_columns_set(&d.columns, i, d.boxes[i]);
+    }
+
+    static const char* names[SPAN_KERNEL_COUNT] = {"scalar", "sse2", "avx2"};
+    SpanKernel best = rect_batch_get_kernel();
+    printf("%d boxes, best kernel %s\n", BOX_COUNT, names[best]);
+    printf("%-10s %-7s %9s %9s %10s\n", "op", "kernel", "ns/box", "GB/s", "mismatches");
+    run_scalar(&d);
+    for (int k = 0; k < SPAN_KERNEL_COUNT; k++) run_batch(&d, (SpanKernel)k, names[k]);
+    rect_batch_set_kernel(best);
+
+    free(d.indices);
+    free(d.mask);
+    free(d.areas);
+    free(d.clipped.x);
+    free(d.clipped.y);
+    free(d.clipped.width);
+    free(d.clipped.height);
+    free(d.columns.x);
+    free(d.columns.y);
+    free(d.columns.width);
+    free(d.columns.height);
+    free(d.boxes);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Spatial index benchmark: a 250 x 200 grid of cards, hit-tested under a
+// moving pointer and culled against a scrolling viewport, by linear scan
+// and through the grid and quadtree indexes. A share of the cards are moved
+// every frame, as while dragging or animating. Every query checks the
+// index against the scan.
+//
+//   cc -O2 -std=c11 bench_spatial.c spatial.c -lm -o bench_spatial
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "spatial.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CARD_COLUMNS 250
+#define CARD_ROWS 200
+#define CARD_COUNT (CARD_COLUMNS * CARD_ROWS)
+#define CARD_PITCH 40.0f
+#define CARD_SIZE 36.0f
+#define VIEWPORT_WIDTH 1280.0f
+#define VIEWPORT_HEIGHT 720.0f
+#define BENCH_QUERIES 20000
+#define BENCH_MOVES 20000
+#define MAX_RESULTS 4096
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Pointer and viewport positions for query i, the same for every method.
+static void probe(int i, float* x, float* y) {
+    *x = (float)((i * 7919) % (int)(CARD_COLUMNS * CARD_PITCH));
+    *y = (float)((i * 104729) % (int)(CARD_ROWS * CARD_PITCH));
+}
+
+static int scan_point(const Rect* cards, float x, float y) {
+    int found = 0;
+    for (int i = 0; i < CARD_COUNT; i++) found += rect_contains_point(cards[i], x, y);
+    return found;
+}
+
+static int scan_rect(const Rect* cards, Rect area) {
+    int found = 0;
+    for (int i = 0; i < CARD_COUNT; i++) found += rect_intersects_rect(cards[i], area);
+    return found;
+}
+
+static void run(const char* name, SpatialIndex* index, Rect* cards, const int* expect_point,
+                const int* expect_rect) {
+    static int results[MAX_RESULTS];
+    double build = 0.0, point = 0.0, range = 0.0, move = 0.0;
+    int mismatches = 0;
+
+    if (index) {
+        double start = now_seconds();
+        spatial_index_build(index, cards, CARD_COUNT);
+        build = now_seconds() - start;
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_QUERIES; i++) {
+        float x, y;
+        probe(i, &x, &y);
+        int found = index ? spatial_index_query_point(index, x, y, results, MAX_RESULTS)
+                          : scan_point(cards, x, y);
+        mismatches += found != expect_point[i];
+    }
+    point = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < BENCH_QUERIES / 10; i++) {
+        float x, y;
+        probe(i, &x, &y);
+        Rect area = rect_make(x, y, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+        int found = index ? spatial_index_query_rect(index, area, results, MAX_RESULTS)
+                          : scan_rect(cards, area);
+        mismatches += found != expect_rect[i];
+    }
+    range = now_seconds() - start;
+
+    // Nudge cards back and forth so the layout ends where it started.
+    if (index) {
+        start = now_seconds();
+        for (int i = 0; i < BENCH_MOVES; i++) {
+            int id = (i * 7) % CARD_COUNT;
+            float dx = (i & 1) ? -3.0f : 3.0f;
+            spatial_index_move(index, id, rect_offset(cards[id], dx, dx));
+            spatial_index_move(index, id, cards[id]);
+        }
+        move = now_seconds() - start;
+    }
+
+    printf("%-9s %9.2f %9.3f %9.2f %9.3f %10d\n", name, build * 1e3, point / BENCH_QUERIES * 1e6,
+           range / (BENCH_QUERIES / 10) * 1e6, move / (2 * BENCH_MOVES) * 1e6, mismatches);
+}
+
+int main(void) {
+    Rect* cards = malloc(CARD_COUNT * sizeof(Rect));
+    int* expect_point = malloc(BENCH_QUERIES * sizeof(int));
+    int* expect_rect = malloc(BENCH_QUERIES / 10 * sizeof(int));
+    if (!cards || !expect_point || !expect_rect) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int row = 0; row < CARD_ROWS; row++) {
+        for (int col = 0; col < CARD_COLUMNS; col++) {
+            cards[row * CARD_COLUMNS + col] =
+                rect_make(col * CARD_PITCH, row * CARD_PITCH, CARD_SIZE, CARD_SIZE);
+        }
+    }
+    for (int i = 0; i < BENCH_QUERIES; i++) {
+        float x, y;
+        probe(i, &x, &y);
+        expect_point[i] = scan_point(cards, x, y);
+        if (i < BENCH_QUERIES / 10) {
+            expect_rect[i] = scan_rect(cards, rect_make(x, y, VIEWPORT_WIDTH, VIEWPORT_HEIGHT));
+        }
+    }
+
+    Rect world = rect_make(0, 0, CARD_COLUMNS * CARD_PITCH, CARD_ROWS * CARD_PITCH);
+    SpatialIndex* grid = spatial_index_create(SPATIAL_GRID, world, CARD_PITCH * 2);
+    SpatialIndex* tree = spatial_index_create(SPATIAL_QUADTREE, world, CARD_PITCH);
+    if (!grid || !tree) {
+        fprintf(stderr, "failed to create indexes\n");
+        return 1;
+    }
+
+    printf("%d cards\n", CARD_COUNT);
+    printf("%-9s %9s %9s %9s %9s %10s\n", "method", "build ms", "point us", "view us", "move us",
+           "mismatches");
+    run("scan", NULL, cards, expect_point, expect_rect);
+    run("grid", grid, cards, expect_point, expect_rect);
+    run("quadtree", tree, cards, expect_point, expect_rect);
+
+    spatial_index_destroy(grid);
+    spatial_index_destroy(tree);
+    free(expect_rect);
+    free(expect_point);
+    free(cards);
+    return 0;
+}
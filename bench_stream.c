@@ -0,0 +1,131 @@
+// Frame stream benchmark: encodes a 1080p animation in every stream format
+// to /dev/null, against saving one PPM file per frame. Then writes each
+// format once more to memory for its size, and reads the RAW, RLE and
+// DELTA streams back to check every frame matches.
+//
+//   cc -O2 -std=c11 bench_stream.c stream.c canvas.c atlas.c span.c rectbatch.c -lm -o bench_stream
+
+#define _GNU_SOURCE
+
+#include "canvas.h"
+#include "stream.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FRAME_WIDTH 1920
+#define FRAME_HEIGHT 1080
+#define BENCH_FRAMES 30
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void draw_frame(Canvas* canvas, int frame) {
+    canvas_clear(canvas);
+    for (int i = 0; i < 24; i++) {
+        AnimationState anim = {(float)((frame + i) % 30), 30.0f, true};
+        canvas_animate_emoji_bounce(canvas, 60 + i * 75, 400, 64, &anim);
+    }
+    canvas_set_fill_color(canvas, NEUTRAL_DARK);
+    canvas_fill_circle(canvas, 960, 800, 120 + frame);
+}
+
+static bool same_pixels(const Canvas* a, const Canvas* b) {
+    for (int y = 0; y < a->height; y++) {
+        if (memcmp(canvas_row(a, y), canvas_row(b, y), (size_t)a->width * sizeof(Color)) != 0) return false;
+    }
+    return true;
+}
+
+// Stream size in bytes, or -1 if it failed to write or read back.
+static long long stream_size(Canvas* canvas, Canvas* decoded, FrameStreamFormat format) {
+    int fd = memfd_create("bench_stream", 0);
+    if (fd < 0) return -1;
+    FrameStream* stream = frame_stream_open(fd, format, FRAME_WIDTH, FRAME_HEIGHT, 30);
+    bool ok = stream != NULL;
+    for (int f = 0; ok && f < BENCH_FRAMES; f++) {
+        draw_frame(canvas, f);
+        ok = frame_stream_write(stream, canvas);
+    }
+    ok = frame_stream_close(stream) && ok;
+    long long size = lseek(fd, 0, SEEK_CUR);
+
+    if (ok && format >= FRAME_STREAM_RAW) {
+        lseek(fd, 0, SEEK_SET);
+        FrameStreamReader* reader = frame_stream_reader_open(fd);
+        ok = reader != NULL;
+        for (int f = 0; ok && f < BENCH_FRAMES; f++) {
+            draw_frame(canvas, f);
+            ok = frame_stream_read(reader, decoded) && same_pixels(canvas, decoded);
+        }
+        ok = ok && !frame_stream_read(reader, decoded);
+        ok = frame_stream_reader_close(reader) && ok;
+    }
+    close(fd);
+    return ok ? size : -1;
+}
+
+int main(void) {
+    Canvas* canvas = canvas_create(FRAME_WIDTH, FRAME_HEIGHT);
+    int fd = open("/dev/null", O_WRONLY);
+    if (!canvas || fd < 0) return 1;
+
+    // Frames are drawn outside the clock; only saving and encoding count.
+    double per_file = 0;
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        char name[64];
+        snprintf(name, sizeof(name), "/tmp/bench_stream_%d.ppm", f % 2);
+        draw_frame(canvas, f);
+        double start = now_seconds();
+        canvas_save_to_ppm(canvas, name);
+        per_file += now_seconds() - start;
+    }
+    per_file /= BENCH_FRAMES;
+    unlink("/tmp/bench_stream_0.ppm");
+    unlink("/tmp/bench_stream_1.ppm");
+
+    printf("%-14s %10s\n", "output", "ms/frame");
+    printf("%-14s %10.2f\n", "ppm files", per_file * 1e3);
+
+    static const char* const names[] = {"ppm stream", "y4m stream", "raw stream", "rle stream",
+                                        "delta stream"};
+    for (int format = FRAME_STREAM_PPM; format <= FRAME_STREAM_DELTA; format++) {
+        FrameStream* stream = frame_stream_open(fd, (FrameStreamFormat)format, FRAME_WIDTH, FRAME_HEIGHT, 30);
+        if (!stream) return 1;
+        double elapsed = 0;
+        for (int f = 0; f < BENCH_FRAMES; f++) {
+            draw_frame(canvas, f);
+            double start = now_seconds();
+            frame_stream_write(stream, canvas);
+            elapsed += now_seconds() - start;
+        }
+        double start = now_seconds();
+        bool ok = frame_stream_close(stream);
+        elapsed = (elapsed + now_seconds() - start) / BENCH_FRAMES;
+        printf("%-14s %10.2f%s\n", names[format], elapsed * 1e3, ok ? "" : "  write failed");
+    }
+
+    Canvas* decoded = canvas_create(FRAME_WIDTH, FRAME_HEIGHT);
+    if (!decoded) return 1;
+    printf("\n%-14s %10s\n", "output", "KB/frame");
+    for (int format = FRAME_STREAM_PPM; format <= FRAME_STREAM_DELTA; format++) {
+        long long size = stream_size(canvas, decoded, (FrameStreamFormat)format);
+        if (size < 0) {
+            printf("%-14s %10s\n", names[format], "failed");
+        } else {
+            printf("%-14s %10.1f\n", names[format], size / 1024.0 / BENCH_FRAMES);
+        }
+    }
+
+    canvas_destroy(decoded);
+    close(fd);
+    canvas_destroy(canvas);
+    return 0;
+}
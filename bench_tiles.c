@@ -0,0 +1,113 @@
+// Tile-parallel rasterizer benchmark: renders a 4K emoji poster with 1..N
+// threads, reports the speed-up over immediate single-threaded drawing and
+// checks that every run is bit-identical to it.
+//
+//   cc -O2 -std=c11 -pthread bench_tiles.c tile.c threadpool.c canvas.c atlas.c span.c rectbatch.c -lm -o bench_tiles
+
+#define _GNU_SOURCE
+
+#include "canvas.h"
+#include "tile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define POSTER_WIDTH 3840
+#define POSTER_HEIGHT 2160
+#define POSTER_CELL 60
+#define BENCH_FRAMES 10
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void draw_poster(Canvas* canvas, int frame) {
+    canvas_clear(canvas);
+
+    canvas_set_stroke_color(canvas, NEUTRAL_MID);
+    canvas_set_stroke_width(canvas, 1);
+    for (int x = 0; x < canvas->width; x += POSTER_CELL) {
+        canvas_draw_line(canvas, x, 0, x, canvas->height - 1);
+    }
+    for (int y = 0; y < canvas->height; y += POSTER_CELL) {
+        canvas_draw_line(canvas, 0, y, canvas->width - 1, y);
+    }
+
+    int n = 0;
+    for (int y = 0; y + POSTER_CELL <= canvas->height; y += POSTER_CELL) {
+        for (int x = 0; x + POSTER_CELL <= canvas->width; x += POSTER_CELL, n++) {
+            int size = POSTER_CELL - 12;
+            AnimationState anim = {(float)((n + frame) % 20), 20.0f, true};
+            switch (n % 8) {
+            case 0: canvas_draw_emoji_smile(canvas, x + 6, y + 6, size); break;
+            case 1: canvas_draw_emoji_leaf(canvas, x + 6, y + 6, size); break;
+            case 2: canvas_draw_emoji_coffee(canvas, x + 6, y + 6, size); break;
+            case 3: canvas_draw_emoji_moon(canvas, x + 6, y + 6, size); break;
+            case 4: canvas_draw_emoji_sparkle(canvas, x + 6, y + 6, size); break;
+            case 5: canvas_animate_emoji_bounce(canvas, x + 6, y + 6, size, &anim); break;
+            case 6: canvas_animate_emoji_pulse(canvas, x + 6, y + 6, size, &anim); break;
+            default: canvas_animate_emoji_spin(canvas, x + 6, y + 6, size, &anim); break;
+            }
+        }
+    }
+
+    canvas_set_fill_color(canvas, NEUTRAL_DARK);
+    canvas_fill_circle(canvas, canvas->width / 2, canvas->height / 2, 300 + frame);
+    canvas_set_stroke_color(canvas, NEUTRAL_TEXT);
+    canvas_set_stroke_width(canvas, 5);
+    canvas_draw_line(canvas, 0, 0, canvas->width - 1, canvas->height - 1);
+    canvas_draw_rect(canvas, 100, 100, canvas->width - 200, canvas->height - 200);
+}
+
+int main(void) {
+    Canvas* reference = canvas_create(POSTER_WIDTH, POSTER_HEIGHT);
+    Canvas* canvas = canvas_create(POSTER_WIDTH, POSTER_HEIGHT);
+    if (!reference || !canvas) {
+        fprintf(stderr, "failed to allocate canvases\n");
+        return 1;
+    }
+    size_t bytes = canvas->stride * POSTER_HEIGHT;
+
+    double start = now_seconds();
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        draw_poster(reference, f);
+    }
+    double baseline = (now_seconds() - start) / BENCH_FRAMES;
+    printf("%-10s %10s %8s %10s\n", "threads", "ms/frame", "speedup", "identical");
+    printf("%-10s %10.2f %8.2f %10s\n", "immediate", baseline * 1e3, 1.0, "-");
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = cpus > 4 ? (int)cpus : 4;
+    int exit_code = 0;
+    for (int threads = 1;; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+        ThreadPool* pool = threadpool_create(threads);
+        TileRenderer* tiles = tile_renderer_create(pool, TILE_DEFAULT_SIZE);
+
+        start = now_seconds();
+        for (int f = 0; f < BENCH_FRAMES; f++) {
+            tile_renderer_begin(tiles, canvas);
+            draw_poster(canvas, f);
+            tile_renderer_end(tiles);
+        }
+        double elapsed = (now_seconds() - start) / BENCH_FRAMES;
+
+        bool identical = memcmp(canvas->pixels, reference->pixels, bytes) == 0;
+        if (!identical) exit_code = 1;
+        printf("%-10d %10.2f %8.2f %10s\n", threadpool_size(pool), elapsed * 1e3,
+               baseline / elapsed, identical ? "yes" : "NO");
+
+        tile_renderer_destroy(tiles);
+        threadpool_destroy(pool);
+        if (threads == max_threads) break;
+    }
+
+    canvas_destroy(canvas);
+    canvas_destroy(reference);
+    return exit_code;
+}
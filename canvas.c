@@ -0,0 +1,1474 @@
+#include "canvas.h"
+#include "canvas_cmd.h"
+#include "atlas.h"
+#include "span.h"
+#include "rectbatch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#define CANVAS_PI 3.14159265358979323846f
+
+// Emoji palette
+static const Color EMOJI_FACE = {255, 204, 77, 255};
+static const Color EMOJI_FACE_EDGE = {214, 158, 46, 255};
+static const Color EMOJI_FEATURE = {92, 61, 30, 255};
+static const Color EMOJI_LEAF = {120, 170, 90, 255};
+static const Color EMOJI_LEAF_VEIN = {70, 120, 60, 255};
+static const Color EMOJI_CUP = {205, 196, 184, 255};
+static const Color EMOJI_SAUCER = {180, 170, 158, 255};
+static const Color EMOJI_COFFEE = {111, 78, 55, 255};
+static const Color EMOJI_STEAM = {190, 190, 190, 255};
+static const Color EMOJI_MOON = {246, 223, 140, 255};
+static const Color EMOJI_SPARKLE = {255, 214, 102, 255};
+
+// Largest d with d*d <= n, or -1 when n is negative.
+static int isqrt_floor(long long n) {
+    if (n < 0) return -1;
+    long long d = (long long)sqrt((double)n);
+    while (d * d > n) d--;
+    while ((d + 1) * (d + 1) <= n) d++;
+    return (int)d;
+}
+
+Color color_premultiply(Color color) {
+    unsigned a = color.a;
+    if (a == 255) return color;
+    Color p = {
+        (uint8_t)((color.r * a + 127) / 255),
+        (uint8_t)((color.g * a + 127) / 255),
+        (uint8_t)((color.b * a + 127) / 255),
+        color.a
+    };
+    return p;
+}
+
+Color color_unpremultiply(Color color) {
+    unsigned a = color.a;
+    if (a == 255) return color;
+    if (a == 0) return TRANSPARENT;
+    Color c = {
+        (uint8_t)((color.r * 255 + a / 2) / a),
+        (uint8_t)((color.g * 255 + a / 2) / a),
+        (uint8_t)((color.b * 255 + a / 2) / a),
+        color.a
+    };
+    return c;
+}
+
+// Draws count pixels of a straight-alpha color: opaque colors overwrite,
+// translucent ones blend.
+static inline void paint_span(Color* dst, Color color, size_t count) {
+    if (color.a == 255) {
+        span_fill(dst, color, count);
+    } else if (color.a != 0) {
+        span_blend(dst, color_premultiply(color), count);
+    }
+}
+
+static inline bool in_clip(const Canvas* canvas, int x, int y) {
+    return x >= canvas->clip_x0 && y >= canvas->clip_y0 &&
+           x < canvas->clip_x1 && y < canvas->clip_y1;
+}
+
+static inline void put_pixel(Canvas* canvas, int x, int y, Color color) {
+    if (in_clip(canvas, x, y)) paint_span(canvas_row(canvas, y) + x, color, 1);
+}
+
+// Clamps the row range [*y0, *y1] of a shape to the clip; false if empty.
+static inline bool clip_rows(const Canvas* canvas, int* y0, int* y1) {
+    if (*y0 < canvas->clip_y0) *y0 = canvas->clip_y0;
+    if (*y1 >= canvas->clip_y1) *y1 = canvas->clip_y1 - 1;
+    return *y0 <= *y1;
+}
+
+// Fills [x0, x1) on row y; the row must already be inside the clip.
+static void fill_span(Canvas* canvas, int y, int x0, int x1, Color color) {
+    if (x0 < canvas->clip_x0) x0 = canvas->clip_x0;
+    if (x1 > canvas->clip_x1) x1 = canvas->clip_x1;
+    if (x0 >= x1) return;
+    paint_span(canvas_row(canvas, y) + x0, color, (size_t)(x1 - x0));
+}
+
+static CanvasBox clip_rect(const Canvas* canvas, int x, int y, int width, int height) {
+    CanvasBox b = {
+        x < canvas->clip_x0 ? canvas->clip_x0 : x,
+        y < canvas->clip_y0 ? canvas->clip_y0 : y,
+        (width > canvas->clip_x1 - x) ? canvas->clip_x1 : x + width,
+        (height > canvas->clip_y1 - y) ? canvas->clip_y1 : y + height
+    };
+    return b;
+}
+
+static void fill_rect_color(Canvas* canvas, int x, int y, int width, int height, Color color) {
+    CanvasBox b = clip_rect(canvas, x, y, width, height);
+    if (canvas_box_empty(b)) return;
+
+    // Full-width rects on unpadded rows are one contiguous run.
+    if (b.x0 == 0 && b.x1 == canvas->width && canvas_is_packed(canvas)) {
+        paint_span(canvas_row(canvas, b.y0), color, (size_t)(b.y1 - b.y0) * canvas->width);
+        return;
+    }
+    for (int row = b.y0; row < b.y1; row++) {
+        paint_span(canvas_row(canvas, row) + b.x0, color, (size_t)(b.x1 - b.x0));
+    }
+}
+
+// Overwrites pixels, alpha included, rather than blending.
+static void clear_rect(Canvas* canvas, int x, int y, int width, int height, Color color) {
+    CanvasBox b = clip_rect(canvas, x, y, width, height);
+    if (canvas_box_empty(b)) return;
+
+    Color premultiplied = color_premultiply(color);
+    if (b.x0 == 0 && b.x1 == canvas->width && canvas_is_packed(canvas)) {
+        span_fill(canvas_row(canvas, b.y0), premultiplied, (size_t)(b.y1 - b.y0) * canvas->width);
+        return;
+    }
+    for (int row = b.y0; row < b.y1; row++) {
+        span_fill(canvas_row(canvas, row) + b.x0, premultiplied, (size_t)(b.x1 - b.x0));
+    }
+}
+
+static void composite_canvas(Canvas* canvas, const Canvas* src, int x, int y) {
+    CanvasBox b = clip_rect(canvas, x, y, src->width, src->height);
+    if (canvas_box_empty(b)) return;
+    for (int row = b.y0; row < b.y1; row++) {
+        span_blend_row(canvas_row(canvas, row) + b.x0, canvas_row(src, row - y) + (b.x0 - x),
+                       (size_t)(b.x1 - b.x0));
+    }
+}
+
+// Anti-aliased shapes. Coverage is worked out per pixel as A8, with pixel
+// centres on integer coordinates: a filled shape fully covers every pixel
+// its aliased version paints and fades out over the next one. Only the edges
+// are evaluated; long interior runs are filled as plain spans.
+
+#define AA_CHUNK 256
+
+typedef enum {
+    AA_CIRCLES,             // circle a, minus circle b when br >= 0
+    AA_LENS,                // overlap of circles a and b
+    AA_DIAMOND,             // half extents rx, ry about a
+    AA_CAPSULE              // segment from (x0, y0) by (dx, dy), round ends
+} AaKind;
+
+typedef struct {
+    AaKind kind;
+    int ax;
+    int ay;
+    int ar;
+    int bx;
+    int by;
+    int br;
+    double rx;
+    double ry;
+    double x0;
+    double y0;
+    double dx;
+    double dy;
+    double inv_len2;        // 1 / (dx * dx + dy * dy), 0 for a dot
+    double radius;          // half the stroke width
+} AaShape;
+
+static inline unsigned coverage_mul(unsigned a, unsigned b) {
+    unsigned t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+static inline unsigned coverage_of(double c) {
+    if (c <= 0.0) return 0;
+    if (c >= 1.0) return 255;
+    return (unsigned)(c * 255.0 + 0.5);
+}
+
+// Coverage of the disc of radius r at squared distance d2 from its centre.
+static inline unsigned disc_coverage(long long d2, int r) {
+    if (r < 0) return 0;
+    if (d2 <= (long long)r * r) return 255;
+    if (d2 >= (long long)(r + 1) * (r + 1)) return 0;
+    return coverage_of(r + 1 - sqrt((double)d2));
+}
+
+static inline unsigned circles_coverage(const AaShape* s, int x, int y) {
+    long long ax = x - s->ax, ay = y - s->ay;
+    long long bx = x - s->bx, by = y - s->by;
+    unsigned a = disc_coverage(ax * ax + ay * ay, s->ar);
+    if (a == 0) return 0;
+    unsigned b = disc_coverage(bx * bx + by * by, s->br);
+    return coverage_mul(a, s->kind == AA_LENS ? b : 255 - b);
+}
+
+static inline unsigned diamond_coverage(const AaShape* s, int x, int y) {
+    // Signed distance to the rhombus, outside positive.
+    double px = fabs((double)(x - s->ax)), py = fabs((double)(y - s->ay));
+    double side = px * s->ry + py * s->rx - s->rx * s->ry;
+    if (side <= 0.0) return 255;
+    double h = (s->rx * (s->rx - 2.0 * px) - s->ry * (s->ry - 2.0 * py)) /
+               (s->rx * s->rx + s->ry * s->ry);
+    if (h < -1.0) h = -1.0;
+    if (h > 1.0) h = 1.0;
+    double ex = px - 0.5 * s->rx * (1.0 - h), ey = py - 0.5 * s->ry * (1.0 + h);
+    return coverage_of(1.0 - sqrt(ex * ex + ey * ey));
+}
+
+static inline unsigned capsule_coverage(const AaShape* s, int x, int y) {
+    double px = x - s->x0, py = y - s->y0;
+    double t = (px * s->dx + py * s->dy) * s->inv_len2;
+    if (t < 0.0) t = 0.0;
+    if (t > 1.0) t = 1.0;
+    double ex = px - t * s->dx, ey = py - t * s->dy;
+    double d2 = ex * ex + ey * ey;
+    double inner = s->radius - 0.5, outer = s->radius + 0.5;
+    if (d2 <= inner * inner) return 255;
+    if (d2 >= outer * outer) return 0;
+    return coverage_of(outer - sqrt(d2));
+}
+
+// Coverage of the count pixels from (x, y) rightwards.
+static void aa_coverage(const AaShape* s, int x, int y, uint8_t* mask, int count) {
+    switch (s->kind) {
+    case AA_CIRCLES:
+    case AA_LENS:
+        for (int i = 0; i < count; i++) mask[i] = (uint8_t)circles_coverage(s, x + i, y);
+        break;
+    case AA_DIAMOND:
+        for (int i = 0; i < count; i++) mask[i] = (uint8_t)diamond_coverage(s, x + i, y);
+        break;
+    case AA_CAPSULE:
+        for (int i = 0; i < count; i++) mask[i] = (uint8_t)capsule_coverage(s, x + i, y);
+        break;
+    }
+}
+
+// Runs of full coverage at least this long are filled rather than blended.
+#define AA_MIN_FILL 16
+
+// Paints a run of coverage. Full coverage through the mask kernel equals a
+// plain span, so only long full runs are worth splitting off as fills.
+static void paint_coverage(Canvas* canvas, int y, int x, const uint8_t* mask, int count, Color color) {
+    Color* row = canvas_row(canvas, y) + x;
+    Color premultiplied = color_premultiply(color);
+    int start = 0;
+    for (int i = 0; i < count;) {
+        if (mask[i] != 255) {
+            i++;
+            continue;
+        }
+        int j = i + 1;
+        while (j < count && mask[j] == 255) j++;
+        if (j - i >= AA_MIN_FILL) {
+            span_blend_mask(row + start, premultiplied, mask + start, (size_t)(i - start));
+            paint_span(row + i, color, (size_t)(j - i));
+            start = j;
+        }
+        i = j;
+    }
+    span_blend_mask(row + start, premultiplied, mask + start, (size_t)(count - start));
+}
+
+// Paints [x0, x1) of row y, clipped, in chunks of coverage. [f0, f1) is
+// known to be fully covered and is not evaluated.
+static void aa_span(Canvas* canvas, const AaShape* shape, int y, int x0, int x1,
+                    int f0, int f1, Color color) {
+    uint8_t mask[AA_CHUNK];
+    while (x0 < x1) {
+        int n = x1 - x0 < AA_CHUNK ? x1 - x0 : AA_CHUNK;
+        int a = f0 - x0, b = f1 - x0;
+        if (a < 0) a = 0;
+        if (b > n) b = n;
+        if (a < b) {
+            aa_coverage(shape, x0, y, mask, a);
+            memset(mask + a, 255, (size_t)(b - a));
+            aa_coverage(shape, x0 + b, y, mask + b, n - b);
+        } else {
+            aa_coverage(shape, x0, y, mask, n);
+        }
+        paint_coverage(canvas, y, x0, mask, n, color);
+        x0 += n;
+    }
+}
+
+// Paints [x0, x1) of row y, which must be inside the clip rows. [f0, f1)
+// is known to be fully covered: a long one is filled directly, a short one
+// rides along with the edges in one mask.
+static void aa_row(Canvas* canvas, const AaShape* shape, int y, int x0, int x1,
+                   int f0, int f1, Color color) {
+    if (x0 < canvas->clip_x0) x0 = canvas->clip_x0;
+    if (x1 > canvas->clip_x1) x1 = canvas->clip_x1;
+    if (x0 >= x1) return;
+    if (f0 < x0) f0 = x0;
+    if (f1 > x1) f1 = x1;
+    if (f1 - f0 < AA_MIN_FILL) {
+        aa_span(canvas, shape, y, x0, x1, f0, f1, color);
+        return;
+    }
+    aa_span(canvas, shape, y, x0, f0, 0, 0, color);
+    paint_span(canvas_row(canvas, y) + f0, color, (size_t)(f1 - f0));
+    aa_span(canvas, shape, y, f1, x1, 0, 0, color);
+}
+
+// Half widths of the row dy away from a circle's centre: of the pixels the
+// aliased circle fills, and of those with any coverage. -1 when none.
+static inline void circle_row(int r, long long dy, int* inner, int* outer) {
+    *inner = *outer = -1;
+    if (r < 0) return;
+    long long n = (long long)r * r - dy * dy;
+    *outer = isqrt_floor(n + 2 * r);
+    // The two differ by about r / outer, so step down rather than take a
+    // second root.
+    if (n < 0) return;
+    int i = *outer;
+    while ((long long)i * i > n) i--;
+    *inner = i;
+}
+
+static void fill_circles_aa(Canvas* canvas, int ax, int ay, int ar,
+                            int bx, int by, int br, Color color) {
+    if (ar < 0) return;
+    AaShape shape = {.kind = AA_CIRCLES, .ax = ax, .ay = ay, .ar = ar, .bx = bx, .by = by, .br = br};
+    int y0 = ay - ar, y1 = ay + ar;
+    if (!clip_rows(canvas, &y0, &y1)) return;
+    for (int y = y0; y <= y1; y++) {
+        int ai, ao, bi, bo;
+        circle_row(ar, y - ay, &ai, &ao);
+        circle_row(br, y - by, &bi, &bo);
+        int o0 = ax - ao, o1 = ax + ao + 1;
+        int i0 = ax - ai, i1 = ax + ai + 1;
+        if (bo < 0) {
+            aa_row(canvas, &shape, y, o0, o1, i0, i1, color);
+            continue;
+        }
+        // Either side of b's hole; inside the hole nothing is covered.
+        int h0 = bi < 0 ? bx : bx - bi, h1 = bi < 0 ? bx : bx + bi + 1;
+        int c0 = bx - bo, c1 = bx + bo + 1;
+        aa_row(canvas, &shape, y, o0, h0 < o1 ? h0 : o1, i0, c0 < i1 ? c0 : i1, color);
+        aa_row(canvas, &shape, y, h1 > o0 ? h1 : o0, o1, c1 > i0 ? c1 : i0, i1, color);
+    }
+}
+
+static void fill_lens_aa(Canvas* canvas, int ax, int ay, int ar,
+                         int bx, int by, int br, Color color) {
+    AaShape shape = {.kind = AA_LENS, .ax = ax, .ay = ay, .ar = ar, .bx = bx, .by = by, .br = br};
+    int y0 = (ay - ar > by - br) ? ay - ar : by - br;
+    int y1 = (ay + ar < by + br) ? ay + ar : by + br;
+    if (!clip_rows(canvas, &y0, &y1)) return;
+    for (int y = y0; y <= y1; y++) {
+        int ai, ao, bi, bo;
+        circle_row(ar, y - ay, &ai, &ao);
+        circle_row(br, y - by, &bi, &bo);
+        int o0 = (ax - ao > bx - bo) ? ax - ao : bx - bo;
+        int o1 = (ax + ao < bx + bo) ? ax + ao + 1 : bx + bo + 1;
+        int i0 = (ax - ai > bx - bi) ? ax - ai : bx - bi;
+        int i1 = (ax + ai < bx + bi) ? ax + ai + 1 : bx + bi + 1;
+        if (ai < 0 || bi < 0) i1 = i0;
+        aa_row(canvas, &shape, y, o0, o1, i0, i1, color);
+    }
+}
+
+static void fill_diamond_aa(Canvas* canvas, int cx, int cy, int rx, int ry, Color color) {
+    AaShape shape = {.kind = AA_DIAMOND, .ax = cx, .ay = cy, .rx = rx, .ry = ry};
+    int y0 = cy - ry, y1 = cy + ry;
+    if (!clip_rows(canvas, &y0, &y1)) return;
+    // Coverage reaches one pixel past the edge, measured square to it.
+    int fringe = (int)ceil(sqrt((double)rx * rx + (double)ry * ry) / ry);
+    for (int y = y0; y <= y1; y++) {
+        int dy = abs(y - cy);
+        int hw = rx * (ry - dy) / ry;
+        int ow = hw + fringe < rx ? hw + fringe : rx;
+        aa_row(canvas, &shape, y, cx - ow, cx + ow + 1, cx - hw, cx + hw + 1, color);
+    }
+}
+
+// Lines are capsules width wide: round ends, endpoints on pixel centres.
+static void draw_line_aa(Canvas* canvas, int x0, int y0, int x1, int y1, int width, Color color) {
+    double dx = x1 - x0, dy = y1 - y0;
+    double len2 = dx * dx + dy * dy;
+    AaShape shape = {
+        .kind = AA_CAPSULE, .x0 = x0, .y0 = y0, .dx = dx, .dy = dy,
+        .inv_len2 = len2 > 0.0 ? 1.0 / len2 : 0.0,
+        .radius = (width > 1 ? width : 1) * 0.5
+    };
+    // Coverage stops short of half the width plus half a pixel.
+    double reach = shape.radius + 0.5;
+    int pad = (width > 1 ? width : 1) / 2;
+    int left = (x0 < x1 ? x0 : x1) - pad, right = (x0 > x1 ? x0 : x1) + pad;
+    int ya = (y0 < y1 ? y0 : y1) - pad, yb = (y0 > y1 ? y0 : y1) + pad;
+    if (!clip_rows(canvas, &ya, &yb)) return;
+
+    // Off the endpoints' rows, a pixel within reach of the segment is
+    // within reach of its line, which bounds the row's x range.
+    double slack = dy != 0.0 ? reach * sqrt(len2) / fabs(dy) : 0.0;
+    for (int y = ya; y <= yb; y++) {
+        int xa = left, xb = right;
+        if (dy != 0.0) {
+            double xl = x0 + (y - y0) * dx / dy;
+            int la = (int)floor(xl - slack), lb = (int)ceil(xl + slack);
+            if (la > xa) xa = la;
+            if (lb < xb) xb = lb;
+        }
+        aa_row(canvas, &shape, y, xa, xb + 1, 0, 0, color);
+    }
+}
+
+static void fill_circle_color(Canvas* canvas, int cx, int cy, int radius, Color color) {
+    if (radius < 0) return;
+    if (canvas->antialias) {
+        fill_circles_aa(canvas, cx, cy, radius, cx, cy, -1, color);
+        return;
+    }
+    int y0 = cy - radius, y1 = cy + radius;
+    if (!clip_rows(canvas, &y0, &y1)) return;
+    long long r2 = (long long)radius * radius;
+    for (int y = y0; y <= y1; y++) {
+        long long dy = y - cy;
+        int hw = isqrt_floor(r2 - dy * dy);
+        fill_span(canvas, y, cx - hw, cx + hw + 1, color);
+    }
+}
+
+// Fills the part of circle a that lies outside circle b. This covers
+// crescents, rings (concentric b) and cut-outs without painting over the
+// background.
+static void fill_circle_minus(Canvas* canvas, int ax, int ay, int ar,
+                              int bx, int by, int br, Color color) {
+    if (ar < 0) return;
+    if (canvas->antialias) {
+        fill_circles_aa(canvas, ax, ay, ar, bx, by, br, color);
+        return;
+    }
+    int y0 = ay - ar, y1 = ay + ar;
+    if (!clip_rows(canvas, &y0, &y1)) return;
+    long long a2 = (long long)ar * ar;
+    long long b2 = (long long)br * br;
+    for (int y = y0; y <= y1; y++) {
+        long long dya = y - ay;
+        long long dyb = y - by;
+        int ahw = isqrt_floor(a2 - dya * dya);
+        int bhw = br < 0 ? -1 : isqrt_floor(b2 - dyb * dyb);
+        int sx0 = ax - ahw, sx1 = ax + ahw + 1;
+        if (bhw < 0) {
+            fill_span(canvas, y, sx0, sx1, color);
+            continue;
+        }
+        int cx0 = bx - bhw, cx1 = bx + bhw + 1;
+        fill_span(canvas, y, sx0, cx0 < sx1 ? cx0 : sx1, color);
+        fill_span(canvas, y, cx1 > sx0 ? cx1 : sx0, sx1, color);
+    }
+}
+
+// Fills the overlap of two circles.
+static void fill_lens(Canvas* canvas, int ax, int ay, int ar,
+                      int bx, int by, int br, Color color) {
+    if (ar < 0 || br < 0) return;
+    if (canvas->antialias) {
+        fill_lens_aa(canvas, ax, ay, ar, bx, by, br, color);
+        return;
+    }
+    int y0 = (ay - ar > by - br) ? ay - ar : by - br;
+    int y1 = (ay + ar < by + br) ? ay + ar : by + br;
+    if (!clip_rows(canvas, &y0, &y1)) return;
+    long long a2 = (long long)ar * ar;
+    long long b2 = (long long)br * br;
+    for (int y = y0; y <= y1; y++) {
+        long long dya = y - ay;
+        long long dyb = y - by;
+        int ahw = isqrt_floor(a2 - dya * dya);
+        int bhw = isqrt_floor(b2 - dyb * dyb);
+        int x0 = (ax - ahw > bx - bhw) ? ax - ahw : bx - bhw;
+        int x1 = (ax + ahw < bx + bhw) ? ax + ahw : bx + bhw;
+        fill_span(canvas, y, x0, x1 + 1, color);
+    }
+}
+
+// Fills the diamond |dx|/rx + |dy|/ry <= 1.
+static void fill_diamond(Canvas* canvas, int cx, int cy, int rx, int ry, Color color) {
+    if (rx < 0 || ry <= 0) return;
+    if (canvas->antialias) {
+        fill_diamond_aa(canvas, cx, cy, rx, ry, color);
+        return;
+    }
+    int y0 = cy - ry, y1 = cy + ry;
+    if (!clip_rows(canvas, &y0, &y1)) return;
+    for (int y = y0; y <= y1; y++) {
+        int dy = abs(y - cy);
+        int hw = rx * (ry - dy) / ry;
+        fill_span(canvas, y, cx - hw, cx + hw + 1, color);
+    }
+}
+
+static void stroke_circle_color(Canvas* canvas, int cx, int cy, int radius, int width, Color color) {
+    if (radius < 0) return;
+    if (width > 1 || canvas->antialias) {
+        fill_circle_minus(canvas, cx, cy, radius, cx, cy, radius - (width > 1 ? width : 1), color);
+        return;
+    }
+
+    // Midpoint circle. Points on the axes and diagonals are shared between
+    // octants; plot them once so translucent strokes blend evenly.
+    int x = radius, y = 0, err = 1 - radius;
+    while (x >= y) {
+        for (int swap = 0; swap < (x == y ? 1 : 2); swap++) {
+            int px = swap ? y : x, py = swap ? x : y;
+            put_pixel(canvas, cx + px, cy + py, color);
+            if (px) put_pixel(canvas, cx - px, cy + py, color);
+            if (py) put_pixel(canvas, cx + px, cy - py, color);
+            if (px && py) put_pixel(canvas, cx - px, cy - py, color);
+        }
+        y++;
+        if (err < 0) {
+            err += 2 * y + 1;
+        } else {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+}
+
+// Wide lines are drawn as one span per step across the minor axis. The
+// span is stretched by the slope so the perpendicular width stays close to
+// the stroke width.
+static int line_span_thickness(int adx, int ady, int width) {
+    if (width <= 1) return 1;
+    int major = adx > ady ? adx : ady;
+    if (major == 0) return width;
+    double len = sqrt((double)adx * adx + (double)ady * ady);
+    return (int)lround(width * len / major);
+}
+
+static void draw_line_color(Canvas* canvas, int x0, int y0, int x1, int y1, int width, Color color) {
+    if (canvas->antialias) {
+        draw_line_aa(canvas, x0, y0, x1, y1, width, color);
+        return;
+    }
+    int adx = abs(x1 - x0), ady = abs(y1 - y0);
+    int thick = line_span_thickness(adx, ady, width);
+    int half = thick / 2;
+    bool x_major = adx >= ady;
+
+    // Axis-aligned lines are a single rect.
+    if (ady == 0) {
+        fill_rect_color(canvas, x0 < x1 ? x0 : x1, y0 - half, adx + 1, thick, color);
+        return;
+    }
+    if (adx == 0) {
+        fill_rect_color(canvas, x0 - half, y0 < y1 ? y0 : y1, thick, ady + 1, color);
+        return;
+    }
+
+    int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+    int err = adx - ady;
+    for (;;) {
+        // Both coordinates are monotonic, so once a step is past the clip
+        // in either direction no later step can reach it.
+        if ((sx > 0 ? x0 - half >= canvas->clip_x1 : x0 + half < canvas->clip_x0) ||
+            (sy > 0 ? y0 - half >= canvas->clip_y1 : y0 + half < canvas->clip_y0)) {
+            break;
+        }
+        if (thick == 1) {
+            put_pixel(canvas, x0, y0, color);
+        } else if (x_major) {
+            if (x0 >= canvas->clip_x0 && x0 < canvas->clip_x1) {
+                int ya = y0 - half, yb = ya + thick - 1;
+                if (clip_rows(canvas, &ya, &yb)) {
+                    for (int y = ya; y <= yb; y++) {
+                        paint_span(canvas_row(canvas, y) + x0, color, 1);
+                    }
+                }
+            }
+        } else if (y0 >= canvas->clip_y0 && y0 < canvas->clip_y1) {
+            fill_span(canvas, y0, x0 - half, x0 - half + thick, color);
+        }
+
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        if (e2 > -ady) {
+            err -= ady;
+            x0 += sx;
+        }
+        if (e2 < adx) {
+            err += adx;
+            y0 += sy;
+        }
+    }
+}
+
+// Emoji are drawn inside the size x size box whose top-left corner is (x, y).
+
+static void draw_smile(Canvas* canvas, int cx, int cy, int r, float angle) {
+    int edge = r / 12 > 1 ? r / 12 : 1;
+    fill_circle_color(canvas, cx, cy, r, EMOJI_FACE_EDGE);
+    fill_circle_color(canvas, cx, cy, r - edge, EMOJI_FACE);
+    if (r < 4) return;
+
+    // Features are circles, so spinning only moves their centres.
+    float c = cosf(angle), s = sinf(angle);
+    const int offsets[4][2] = {
+        {-r / 3, -r / 4}, {r / 3, -r / 4},   // eyes
+        {0, r / 8}, {0, -r / 8}              // mouth minus cut-out
+    };
+    int pts[4][2];
+    for (int i = 0; i < 4; i++) {
+        pts[i][0] = cx + (int)lroundf(offsets[i][0] * c - offsets[i][1] * s);
+        pts[i][1] = cy + (int)lroundf(offsets[i][0] * s + offsets[i][1] * c);
+    }
+    int eye = r / 8 > 1 ? r / 8 : 1;
+    fill_circle_color(canvas, pts[0][0], pts[0][1], eye, EMOJI_FEATURE);
+    fill_circle_color(canvas, pts[1][0], pts[1][1], eye, EMOJI_FEATURE);
+    fill_circle_minus(canvas, pts[2][0], pts[2][1], r / 2,
+                      pts[3][0], pts[3][1], r / 2, EMOJI_FEATURE);
+}
+
+static void draw_emoji_smile(Canvas* canvas, int x, int y, int size) {
+    int r = (size - 1) / 2;
+    draw_smile(canvas, x + r, y + r, r, 0.0f);
+}
+
+static void draw_emoji_leaf(Canvas* canvas, int x, int y, int size) {
+    int r = (size - 1) / 2;
+    int cx = x + r, cy = y + r;
+
+    // A lens of two circles whose centres sit on the leaf's cross axis.
+    int k = (int)lroundf(0.5745f * r);
+    int lr = (int)lroundf(1.2125f * r);
+    fill_lens(canvas, cx - k, cy - k, lr, cx + k, cy + k, lr, EMOJI_LEAF);
+
+    int vein = size / 24 > 1 ? size / 24 : 1;
+    int tip = (int)lroundf(0.6f * r);
+    int stem = (int)lroundf(0.95f * r);
+    draw_line_color(canvas, cx - stem, cy + stem, cx + tip, cy - tip, vein, EMOJI_LEAF_VEIN);
+}
+
+static void draw_emoji_coffee(Canvas* canvas, int x, int y, int size) {
+    int cup_x = x + size * 15 / 100;
+    int cup_w = size * 55 / 100;
+    int cup_y = y + size * 40 / 100;
+    int cup_h = size * 50 / 100;
+    int line = size / 16 > 1 ? size / 16 : 1;
+
+    int handle_r = size * 12 / 100;
+    stroke_circle_color(canvas, cup_x + cup_w, cup_y + cup_h / 3, handle_r, line, EMOJI_CUP);
+    fill_rect_color(canvas, cup_x, cup_y, cup_w, cup_h, EMOJI_CUP);
+    fill_rect_color(canvas, cup_x + line, cup_y, cup_w - 2 * line, size * 8 / 100 + 1, EMOJI_COFFEE);
+    fill_rect_color(canvas, x + size * 5 / 100, cup_y + cup_h, size * 80 / 100,
+                    size / 20 > 1 ? size / 20 : 1, EMOJI_SAUCER);
+
+    int steam_top = y + size * 10 / 100;
+    int steam_bottom = y + size * 30 / 100;
+    for (int i = 1; i <= 2; i++) {
+        int sx = cup_x + cup_w * i / 3;
+        draw_line_color(canvas, sx, steam_bottom, sx + line, steam_top, line, EMOJI_STEAM);
+    }
+}
+
+static void draw_emoji_moon(Canvas* canvas, int x, int y, int size) {
+    int r = (size - 1) / 2;
+    int cx = x + r, cy = y + r;
+    fill_circle_minus(canvas, cx, cy, r, cx + r / 2, cy - r / 4, r * 85 / 100, EMOJI_MOON);
+}
+
+static void draw_emoji_sparkle(Canvas* canvas, int x, int y, int size) {
+    int r = (size - 1) / 2;
+    int cx = x + r, cy = y + r;
+    fill_diamond(canvas, cx, cy, r / 3, r, EMOJI_SPARKLE);
+    fill_diamond(canvas, cx, cy, r, r / 3, EMOJI_SPARKLE);
+
+    int sr = r / 3;
+    int sx = cx + r * 6 / 10, sy = cy - r * 6 / 10;
+    fill_diamond(canvas, sx, sy, sr / 3, sr, EMOJI_SPARKLE);
+    fill_diamond(canvas, sx, sy, sr, sr / 3, EMOJI_SPARKLE);
+}
+
+// Copies a sprite's opaque runs and blends the rest, its cell's corner
+// landing on (x, y).
+static void blit_sprite(Canvas* canvas, const Canvas* atlas, const EmojiSprite* sprite, int x, int y) {
+    int r0 = canvas->clip_y0 - y > 0 ? canvas->clip_y0 - y : 0;
+    int r1 = sprite->cell.y1 - sprite->cell.y0;
+    if (canvas->clip_y1 - y < r1) r1 = canvas->clip_y1 - y;
+    for (int r = r0; r < r1; r++) {
+        Color* dst = canvas_row(canvas, y + r);
+        const Color* src = canvas_row(atlas, sprite->cell.y0 + r) + sprite->cell.x0;
+        for (uint32_t i = sprite->rows[r]; i < sprite->rows[r + 1]; i++) {
+            const EmojiRun* run = &sprite->runs[i];
+            int x0 = x + run->x, x1 = x0 + run->length;
+            if (x0 < canvas->clip_x0) x0 = canvas->clip_x0;
+            if (x1 > canvas->clip_x1) x1 = canvas->clip_x1;
+            if (x0 >= x1) continue;
+            if (run->opaque) {
+                memcpy(dst + x0, src + (x0 - x), (size_t)(x1 - x0) * sizeof(Color));
+            } else {
+                span_blend_row(dst + x0, src + (x0 - x), (size_t)(x1 - x0));
+            }
+        }
+    }
+}
+
+// Affine blits walk each destination row with the source position in 16.16
+// fixed point, one add per pixel. Rows are clipped to the source up front,
+// so the inner loops never bounds-check.
+#define AFFINE_ONE 65536
+#define AFFINE_CHUNK 256
+
+typedef struct {
+    const uint8_t* base;    // top-left pixel of the cell
+    size_t stride;
+    int64_t width;
+    int64_t height;
+} AffineSource;
+
+static inline uint32_t affine_texel(const AffineSource* s, int64_t x, int64_t y) {
+    uint32_t p;
+    memcpy(&p, s->base + (size_t)y * s->stride + (size_t)x * sizeof(Color), sizeof(p));
+    return p;
+}
+
+// Transparent outside the cell.
+static inline uint32_t affine_texel_checked(const AffineSource* s, int64_t x, int64_t y) {
+    if (x < 0 || y < 0 || x >= s->width || y >= s->height) return 0;
+    return affine_texel(s, x, y);
+}
+
+// Premultiplied a + (b - a) * w / 256, two channels per multiply.
+static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, uint32_t w) {
+    uint32_t rb = (((a & 0xFF00FF) * (256 - w) + (b & 0xFF00FF) * w) >> 8) & 0xFF00FF;
+    uint32_t ag = ((a >> 8) & 0xFF00FF) * (256 - w) + ((b >> 8) & 0xFF00FF) * w;
+    return rb | (ag & 0xFF00FF00);
+}
+
+static inline uint32_t affine_bilinear(const AffineSource* s, int64_t u, int64_t v, bool checked) {
+    int64_t x = u >> 16, y = v >> 16;
+    uint32_t fx = (uint32_t)(u >> 8) & 0xFF, fy = (uint32_t)(v >> 8) & 0xFF;
+    uint32_t p00, p01, p10, p11;
+    if (checked) {
+        p00 = affine_texel_checked(s, x, y);
+        p01 = affine_texel_checked(s, x + 1, y);
+        p10 = affine_texel_checked(s, x, y + 1);
+        p11 = affine_texel_checked(s, x + 1, y + 1);
+    } else {
+        p00 = affine_texel(s, x, y);
+        p01 = affine_texel(s, x + 1, y);
+        p10 = affine_texel(s, x, y + 1);
+        p11 = affine_texel(s, x + 1, y + 1);
+    }
+    return lerp_pixel(lerp_pixel(p00, p01, fx), lerp_pixel(p10, p11, fx), fy);
+}
+
+typedef enum {
+    AFFINE_NEAREST,
+    AFFINE_BILINEAR,
+    AFFINE_BILINEAR_EDGE    // some taps fall outside the cell
+} AffineMode;
+
+// Samples dst pixels [x0, x1) of one row and blends them in. u and v are
+// the source position at x = 0.
+static void affine_span(Color* dst, int x0, int x1, int64_t u, int64_t v, int64_t du, int64_t dv,
+                        const AffineSource* s, AffineMode mode) {
+    Color samples[AFFINE_CHUNK];
+    u += du * x0;
+    v += dv * x0;
+    while (x0 < x1) {
+        int n = x1 - x0 < AFFINE_CHUNK ? x1 - x0 : AFFINE_CHUNK;
+        uint32_t p;
+        for (int i = 0; i < n; i++, u += du, v += dv) {
+            switch (mode) {
+            case AFFINE_NEAREST: p = affine_texel(s, u >> 16, v >> 16); break;
+            case AFFINE_BILINEAR: p = affine_bilinear(s, u, v, false); break;
+            default: p = affine_bilinear(s, u, v, true); break;
+            }
+            memcpy(&samples[i], &p, sizeof(p));
+        }
+        span_blend_row(dst + x0, samples, (size_t)n);
+        x0 += n;
+    }
+}
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+// Narrows [*x0, *x1) to the x where lo <= f0 + k * x < hi.
+static void clip_linear(int64_t f0, int64_t k, int64_t lo, int64_t hi, int* x0, int* x1) {
+    int64_t a, b;
+    if (k == 0) {
+        if (f0 < lo || f0 >= hi) *x1 = *x0;
+        return;
+    }
+    if (k > 0) {
+        a = -floor_div(f0 - lo, k);
+        b = -floor_div(f0 - hi, k);
+    } else {
+        a = floor_div(f0 - hi, -k) + 1;
+        b = floor_div(f0 - lo, -k) + 1;
+    }
+    if (a > *x0) *x0 = a < *x1 ? (int)a : *x1;
+    if (b < *x1) *x1 = b > *x0 ? (int)b : *x0;
+}
+
+// Blends the pixels of cell in src onto box of the canvas through m, the
+// map from destination to source coordinates:
+//   u = m[0] x + m[1] y + m[2],  v = m[3] x + m[4] y + m[5]
+static void blit_affine(Canvas* canvas, const Canvas* src, CanvasBox cell, const double m[6],
+                        CanvasBox box, CanvasSampling sampling) {
+    box = canvas_box_intersect(box, canvas_clip_box(canvas));
+    if (canvas_box_empty(box) || canvas_box_empty(cell)) return;
+
+    AffineSource s = {
+        (const uint8_t*)(canvas_row(src, cell.y0) + cell.x0), src->stride,
+        cell.x1 - cell.x0, cell.y1 - cell.y0
+    };
+    bool bilinear = sampling == CANVAS_SAMPLE_BILINEAR;
+    // Pixel centres map to sample points; bilinear taps sit half a pixel
+    // either side of them.
+    double bias = bilinear ? 0.5 : 0.0;
+    int64_t du = llround(m[0] * AFFINE_ONE), dv = llround(m[3] * AFFINE_ONE);
+    int64_t w = s.width * AFFINE_ONE, h = s.height * AFFINE_ONE;
+
+    for (int y = box.y0; y < box.y1; y++) {
+        int64_t u = llround((m[0] * 0.5 + m[1] * (y + 0.5) + m[2] - bias) * AFFINE_ONE);
+        int64_t v = llround((m[3] * 0.5 + m[4] * (y + 0.5) + m[5] - bias) * AFFINE_ONE);
+        Color* dst = canvas_row(canvas, y);
+        int x0 = box.x0, x1 = box.x1;
+        if (!bilinear) {
+            clip_linear(u, du, 0, w, &x0, &x1);
+            clip_linear(v, dv, 0, h, &x0, &x1);
+            affine_span(dst, x0, x1, u, v, du, dv, &s, AFFINE_NEAREST);
+            continue;
+        }
+
+        // Pixels with any tap in the cell, then those with all four in it.
+        clip_linear(u, du, -AFFINE_ONE, w, &x0, &x1);
+        clip_linear(v, dv, -AFFINE_ONE, h, &x0, &x1);
+        int i0 = x0, i1 = x1;
+        clip_linear(u, du, 0, w - AFFINE_ONE, &i0, &i1);
+        clip_linear(v, dv, 0, h - AFFINE_ONE, &i0, &i1);
+        if (i0 >= i1) i0 = i1 = x1;
+        affine_span(dst, x0, i0, u, v, du, dv, &s, AFFINE_BILINEAR_EDGE);
+        affine_span(dst, i0, i1, u, v, du, dv, &s, AFFINE_BILINEAR);
+        affine_span(dst, i1, x1, u, v, du, dv, &s, AFFINE_BILINEAR_EDGE);
+    }
+}
+
+// Blits from the canvas' atlas when it has one, else rasterizes in place.
+static void draw_emoji(Canvas* canvas, CanvasCmdOp op, int x, int y, int size) {
+    EmojiSprite sprite;
+    if (canvas->atlas && emoji_atlas_lookup(canvas->atlas, op, size, canvas->antialias, &sprite)) {
+        int margin = canvas_emoji_margin(size);
+        blit_sprite(canvas, emoji_atlas_canvas(canvas->atlas), &sprite, x - margin, y - margin);
+        return;
+    }
+    switch (op) {
+    case CANVAS_CMD_EMOJI_SMILE: draw_emoji_smile(canvas, x, y, size); break;
+    case CANVAS_CMD_EMOJI_LEAF: draw_emoji_leaf(canvas, x, y, size); break;
+    case CANVAS_CMD_EMOJI_COFFEE: draw_emoji_coffee(canvas, x, y, size); break;
+    case CANVAS_CMD_EMOJI_MOON: draw_emoji_moon(canvas, x, y, size); break;
+    case CANVAS_CMD_EMOJI_SPARKLE: draw_emoji_sparkle(canvas, x, y, size); break;
+    default: break;
+    }
+}
+
+// Fraction of the animation elapsed, 0 when idle.
+static float animation_phase(const AnimationState* anim) {
+    if (!anim || !anim->active || anim->duration <= 0.0f) return 0.0f;
+    float t = anim->progress / anim->duration;
+    if (t < 0.0f) return 0.0f;
+    if (t > 1.0f) return 1.0f;
+    return t;
+}
+
+// Matches the CSS keyframes: up by a fifth of the size at the midpoint.
+static void draw_emoji_bounce(Canvas* canvas, int x, int y, int size, float t) {
+    int lift = (int)lroundf(sinf(CANVAS_PI * t) * size * 0.2f);
+    draw_emoji(canvas, CANVAS_CMD_EMOJI_SMILE, x, y - lift, size);
+}
+
+// The atlas smiley turned by angle and scaled about its centre. False when
+// resampling is off, there is no atlas or the sprite doesn't fit in it.
+static bool draw_smile_transformed(Canvas* canvas, int x, int y, int size, float angle, float scale,
+                                   CanvasSampling sampling) {
+    EmojiSprite sprite;
+    if (sampling == CANVAS_SAMPLE_NONE || !canvas->atlas) return false;
+    if (!emoji_atlas_lookup(canvas->atlas, CANVAS_CMD_EMOJI_SMILE, size, canvas->antialias,
+                            &sprite)) return false;
+    int r = (size - 1) / 2;
+    double centre = canvas_emoji_margin(size) + r + 0.5;   // in the cell
+    double cx = x + r + 0.5, cy = y + r + 0.5;
+    double c = cos(angle), s = sin(angle);
+
+    // Destination box: the cell's corners carried forward.
+    double extent = sprite.cell.x1 - sprite.cell.x0;
+    double left = cx, right = cx, top = cy, bottom = cy;
+    for (int i = 0; i < 4; i++) {
+        double u = (i & 1 ? extent : 0.0) - centre, v = (i & 2 ? extent : 0.0) - centre;
+        double px = cx + scale * (c * u - s * v), py = cy + scale * (s * u + c * v);
+        if (px < left) left = px;
+        if (px > right) right = px;
+        if (py < top) top = py;
+        if (py > bottom) bottom = py;
+    }
+    CanvasBox box = {(int)floor(left) - 1, (int)floor(top) - 1, (int)ceil(right) + 1, (int)ceil(bottom) + 1};
+
+    c /= scale;
+    s /= scale;
+    double m[6] = {c, s, centre - c * cx - s * cy, -s, c, centre + s * cx - c * cy};
+    blit_affine(canvas, emoji_atlas_canvas(canvas->atlas), sprite.cell, m, box, sampling);
+    return true;
+}
+
+// Scales up to 1.2x at the midpoint about the emoji's centre.
+static void draw_emoji_pulse(Canvas* canvas, int x, int y, int size, float t, CanvasSampling sampling) {
+    float grow = 1.0f + 0.2f * sinf(CANVAS_PI * t);
+    if (draw_smile_transformed(canvas, x, y, size, 0.0f, grow, sampling)) return;
+    int scaled = (int)lroundf(size * grow);
+    int offset = (scaled - size) / 2;
+    draw_emoji(canvas, CANVAS_CMD_EMOJI_SMILE, x - offset, y - offset, scaled);
+}
+
+static void draw_emoji_spin(Canvas* canvas, int x, int y, int size, float t, CanvasSampling sampling) {
+    if (draw_smile_transformed(canvas, x, y, size, 2.0f * CANVAS_PI * t, 1.0f, sampling)) return;
+    int r = (size - 1) / 2;
+    draw_smile(canvas, x + r, y + r, r, 2.0f * CANVAS_PI * t);
+}
+
+// Conservative box around everything cmd can touch, before clipping.
+static CanvasBox canvas_cmd_bounds(const Canvas* canvas, const CanvasCmd* cmd) {
+    const int* a = cmd->args;
+    int w = cmd->stroke_width;
+    CanvasBox b;
+    switch (cmd->op) {
+    case CANVAS_CMD_PIXEL:
+    case CANVAS_CMD_SET_PIXEL:
+        b = (CanvasBox){a[0], a[1], a[0] + 1, a[1] + 1};
+        break;
+    case CANVAS_CMD_LINE: {
+        if (cmd->antialias) {
+            // Round ends: coverage stops short of half the width plus half
+            // a pixel.
+            int pad = (w > 1 ? w : 1) / 2;
+            b.x0 = (a[0] < a[2] ? a[0] : a[2]) - pad;
+            b.y0 = (a[1] < a[3] ? a[1] : a[3]) - pad;
+            b.x1 = (a[0] > a[2] ? a[0] : a[2]) + pad + 1;
+            b.y1 = (a[1] > a[3] ? a[1] : a[3]) + pad + 1;
+            break;
+        }
+        int adx = abs(a[2] - a[0]), ady = abs(a[3] - a[1]);
+        int thick = line_span_thickness(adx, ady, w);
+        int half = thick / 2;
+        int px = adx >= ady ? 0 : half, py = adx >= ady ? half : 0;
+        int ex = adx >= ady ? 1 : thick, ey = adx >= ady ? thick : 1;
+        b.x0 = (a[0] < a[2] ? a[0] : a[2]) - px;
+        b.y0 = (a[1] < a[3] ? a[1] : a[3]) - py;
+        b.x1 = (a[0] > a[2] ? a[0] : a[2]) - px + ex;
+        b.y1 = (a[1] > a[3] ? a[1] : a[3]) - py + ey;
+        break;
+    }
+    case CANVAS_CMD_CLEAR:
+    case CANVAS_CMD_RECT:
+    case CANVAS_CMD_FILL_RECT:
+    case CANVAS_CMD_COMPOSITE:
+        b = (CanvasBox){a[0], a[1], a[0] + a[2], a[1] + a[3]};
+        break;
+    case CANVAS_CMD_CIRCLE:
+    case CANVAS_CMD_FILL_CIRCLE:
+        b = (CanvasBox){a[0] - a[2], a[1] - a[2], a[0] + a[2] + 1, a[1] + a[2] + 1};
+        break;
+    case CANVAS_CMD_EMOJI_SMILE:
+    case CANVAS_CMD_EMOJI_LEAF:
+    case CANVAS_CMD_EMOJI_COFFEE:
+    case CANVAS_CMD_EMOJI_MOON:
+    case CANVAS_CMD_EMOJI_SPARKLE:
+    case CANVAS_CMD_EMOJI_BOUNCE:
+    case CANVAS_CMD_EMOJI_PULSE:
+    case CANVAS_CMD_EMOJI_SPIN: {
+        // Animations move or grow the emoji by up to a fifth of its size.
+        bool animated = cmd->op >= CANVAS_CMD_EMOJI_BOUNCE;
+        int m = animated ? a[2] / 4 + 2 : canvas_emoji_margin(a[2]);
+        b = (CanvasBox){a[0] - m, a[1] - m, a[0] + a[2] + m, a[1] + a[2] + m};
+        break;
+    }
+    default:
+        b = (CanvasBox){0, 0, canvas->width, canvas->height};
+        break;
+    }
+    return b;
+}
+
+static void execute_op(Canvas* canvas, const CanvasCmd* cmd) {
+    const int* a = cmd->args;
+    switch (cmd->op) {
+    case CANVAS_CMD_CLEAR:
+        clear_rect(canvas, a[0], a[1], a[2], a[3], cmd->color);
+        break;
+    case CANVAS_CMD_PIXEL:
+        put_pixel(canvas, a[0], a[1], cmd->color);
+        break;
+    case CANVAS_CMD_SET_PIXEL:
+        if (in_clip(canvas, a[0], a[1])) {
+            canvas_row(canvas, a[1])[a[0]] = color_premultiply(cmd->color);
+        }
+        break;
+    case CANVAS_CMD_LINE:
+        draw_line_color(canvas, a[0], a[1], a[2], a[3], cmd->stroke_width, cmd->color);
+        break;
+    case CANVAS_CMD_RECT: {
+        int w = cmd->stroke_width;
+        if (2 * w >= a[2] || 2 * w >= a[3]) {
+            fill_rect_color(canvas, a[0], a[1], a[2], a[3], cmd->color);
+            break;
+        }
+        fill_rect_color(canvas, a[0], a[1], a[2], w, cmd->color);
+        fill_rect_color(canvas, a[0], a[1] + a[3] - w, a[2], w, cmd->color);
+        fill_rect_color(canvas, a[0], a[1] + w, w, a[3] - 2 * w, cmd->color);
+        fill_rect_color(canvas, a[0] + a[2] - w, a[1] + w, w, a[3] - 2 * w, cmd->color);
+        break;
+    }
+    case CANVAS_CMD_FILL_RECT:
+        fill_rect_color(canvas, a[0], a[1], a[2], a[3], cmd->color);
+        break;
+    case CANVAS_CMD_CIRCLE:
+        stroke_circle_color(canvas, a[0], a[1], a[2], cmd->stroke_width, cmd->color);
+        break;
+    case CANVAS_CMD_FILL_CIRCLE:
+        fill_circle_color(canvas, a[0], a[1], a[2], cmd->color);
+        break;
+    case CANVAS_CMD_EMOJI_SMILE:
+    case CANVAS_CMD_EMOJI_LEAF:
+    case CANVAS_CMD_EMOJI_COFFEE:
+    case CANVAS_CMD_EMOJI_MOON:
+    case CANVAS_CMD_EMOJI_SPARKLE:
+        draw_emoji(canvas, (CanvasCmdOp)cmd->op, a[0], a[1], a[2]);
+        break;
+    case CANVAS_CMD_EMOJI_BOUNCE:
+        draw_emoji_bounce(canvas, a[0], a[1], a[2], cmd->phase);
+        break;
+    case CANVAS_CMD_EMOJI_PULSE:
+        draw_emoji_pulse(canvas, a[0], a[1], a[2], cmd->phase, (CanvasSampling)cmd->sampling);
+        break;
+    case CANVAS_CMD_EMOJI_SPIN:
+        draw_emoji_spin(canvas, a[0], a[1], a[2], cmd->phase, (CanvasSampling)cmd->sampling);
+        break;
+    case CANVAS_CMD_COMPOSITE:
+        composite_canvas(canvas, cmd->source, a[0], a[1]);
+        break;
+    }
+}
+
+void canvas_cmd_execute(Canvas* canvas, const CanvasCmd* cmd) {
+    bool antialias = canvas->antialias;
+    canvas->antialias = cmd->antialias;
+    execute_op(canvas, cmd);
+    canvas->antialias = antialias;
+}
+
+static RectColumns region_columns(DamageRegion* region) {
+    RectColumns c = {region->x, region->y, region->width, region->height, (size_t)region->count};
+    return c;
+}
+
+static void region_set(DamageRegion* region, int i, Rect r) {
+    RectColumns c = region_columns(region);
+    region->rects[i] = r;
+    rect_columns_set(&c, (size_t)i, r);
+}
+
+static void region_remove(DamageRegion* region, int i) {
+    region->count--;
+    region_set(region, i, region->rects[region->count]);
+}
+
+static void region_add(DamageRegion* region, Rect r) {
+    if (r.width <= 0 || r.height <= 0) return;
+
+    // Absorb every rect r touches; the union may reach further ones. Taking
+    // the hits highest first means the rect swapped into each hole is never
+    // one still to be absorbed.
+    uint64_t mask[RECT_BATCH_WORDS(CANVAS_DAMAGE_RECTS)];
+    uint32_t hits[CANVAS_DAMAGE_RECTS];
+    while (region->count > 0) {
+        RectColumns c = region_columns(region);
+        rect_batch_intersects(&c, r, mask);
+        size_t hit_count = rect_batch_select(mask, c.count, hits);
+        if (hit_count == 0) break;
+        while (hit_count-- > 0) {
+            int i = (int)hits[hit_count];
+            r = rect_union(r, region->rects[i]);
+            region_remove(region, i);
+        }
+    }
+
+    // Out of slots: merge with the rect whose union wastes the least area.
+    if (region->count == CANVAS_DAMAGE_RECTS) {
+        int best = 0;
+        float best_waste = 0.0f;
+        for (int i = 0; i < region->count; i++) {
+            Rect u = rect_union(region->rects[i], r);
+            float waste = rect_area(u) - rect_area(region->rects[i]) - rect_area(r);
+            if (i == 0 || waste < best_waste) {
+                best = i;
+                best_waste = waste;
+            }
+        }
+        Rect merged = rect_union(region->rects[best], r);
+        region_remove(region, best);
+        region_add(region, merged);
+        return;
+    }
+    region->count++;
+    region_set(region, region->count - 1, r);
+}
+
+static void add_damage_box(Canvas* canvas, CanvasBox box) {
+    Rect r = canvas_box_rect(box);
+    region_add(&canvas->damage, r);
+    region_add(&canvas->drawn, r);
+}
+
+// Every public draw call funnels through here.
+static void canvas_submit(Canvas* canvas, CanvasCmd* cmd) {
+    if (canvas->recorder || canvas->track_damage) {
+        cmd->bounds = canvas_box_intersect(canvas_cmd_bounds(canvas, cmd), canvas_clip_box(canvas));
+        if (canvas_box_empty(cmd->bounds)) return;
+        if (canvas->track_damage) {
+            add_damage_box(canvas, cmd->bounds);
+        }
+        if (canvas->recorder) {
+            canvas->recorder->record(canvas->recorder, canvas, cmd);
+            return;
+        }
+    }
+    canvas_cmd_execute(canvas, cmd);
+}
+
+static void submit_op(Canvas* canvas, CanvasCmdOp op, Color color,
+                      int a0, int a1, int a2, int a3, float phase) {
+    CanvasCmd cmd = {
+        .op = (uint8_t)op,
+        .sampling = (uint8_t)canvas->sampling,
+        .antialias = canvas->antialias,
+        .stroke_width = (uint16_t)canvas->stroke_width,
+        .color = color,
+        .args = {a0, a1, a2, a3},
+        .phase = phase
+    };
+    canvas_submit(canvas, &cmd);
+}
+
+Canvas* canvas_create(int width, int height) {
+    if (width <= 0 || height <= 0) return NULL;
+
+    size_t row_bytes = (size_t)width * sizeof(Color);
+    size_t stride = (row_bytes + CANVAS_ROW_ALIGN - 1) / CANVAS_ROW_ALIGN * CANVAS_ROW_ALIGN;
+    Color* pixels = aligned_alloc(CANVAS_ROW_ALIGN, stride * height);
+    if (!pixels) return NULL;
+
+    Canvas* canvas = canvas_create_with_pixels(width, height, pixels, stride);
+    if (!canvas) {
+        free(pixels);
+        return NULL;
+    }
+    canvas->owns_pixels = true;
+
+    // Padding is never drawn; zero it so whole buffers compare equal.
+    if (stride != row_bytes) {
+        for (int y = 0; y < height; y++) {
+            memset((uint8_t*)canvas_row(canvas, y) + row_bytes, 0, stride - row_bytes);
+        }
+    }
+    canvas_clear(canvas);
+    return canvas;
+}
+
+Canvas* canvas_create_with_pixels(int width, int height, Color* pixels, size_t stride) {
+    if (width <= 0 || height <= 0 || !pixels || stride < (size_t)width * sizeof(Color)) return NULL;
+
+    Canvas* canvas = malloc(sizeof(Canvas));
+    if (!canvas) return NULL;
+    canvas->width = width;
+    canvas->height = height;
+    canvas->pixels = pixels;
+    canvas->stride = stride;
+    canvas->owns_pixels = false;
+    canvas_reset(canvas);
+    return canvas;
+}
+
+void canvas_reset(Canvas* canvas) {
+    if (!canvas) return;
+    canvas->clear_color = NEUTRAL_WHITE;
+    canvas->stroke_color = NEUTRAL_TEXT;
+    canvas->fill_color = NEUTRAL_MID;
+    canvas->stroke_width = 1;
+    canvas->recorder = NULL;
+    canvas->atlas = NULL;
+    canvas->sampling = CANVAS_SAMPLE_NONE;
+    canvas->antialias = false;
+    canvas->track_damage = false;
+    canvas->damage.count = 0;
+    canvas->drawn.count = 0;
+    canvas->drawn_clear_color = TRANSPARENT;
+    canvas_reset_clip(canvas);
+}
+
+void canvas_destroy(Canvas* canvas) {
+    if (!canvas) return;
+    if (canvas->owns_pixels) free(canvas->pixels);
+    free(canvas);
+}
+
+void canvas_clear(Canvas* canvas) {
+    if (!canvas) return;
+    Color color = canvas->clear_color;
+
+    // Everything outside the drawn region already holds the clear color.
+    bool partial = canvas->track_damage &&
+                   memcmp(&color, &canvas->drawn_clear_color, sizeof(Color)) == 0;
+    if (!partial) {
+        submit_op(canvas, CANVAS_CMD_CLEAR, color, 0, 0, canvas->width, canvas->height, 0.0f);
+    } else {
+        DamageRegion drawn = canvas->drawn;
+        for (int i = 0; i < drawn.count; i++) {
+            CanvasBox b = canvas_rect_box(drawn.rects[i]);
+            submit_op(canvas, CANVAS_CMD_CLEAR, color, b.x0, b.y0, b.x1 - b.x0, b.y1 - b.y0, 0.0f);
+        }
+    }
+
+    // A clipped clear leaves other pixels as they were.
+    if (canvas->clip_x0 == 0 && canvas->clip_y0 == 0 &&
+        canvas->clip_x1 == canvas->width && canvas->clip_y1 == canvas->height) {
+        canvas->drawn.count = 0;
+        canvas->drawn_clear_color = color;
+    }
+}
+
+void canvas_set_clear_color(Canvas* canvas, Color color) {
+    if (canvas) canvas->clear_color = color;
+}
+
+void canvas_set_stroke_color(Canvas* canvas, Color color) {
+    if (canvas) canvas->stroke_color = color;
+}
+
+void canvas_set_fill_color(Canvas* canvas, Color color) {
+    if (canvas) canvas->fill_color = color;
+}
+
+void canvas_set_stroke_width(Canvas* canvas, int width) {
+    if (!canvas) return;
+    if (width < 1) width = 1;
+    if (width > UINT16_MAX) width = UINT16_MAX;
+    canvas->stroke_width = width;
+}
+
+void canvas_set_antialias(Canvas* canvas, bool antialias) {
+    if (canvas) canvas->antialias = antialias;
+}
+
+void canvas_set_clip(Canvas* canvas, int x, int y, int width, int height) {
+    if (!canvas) return;
+    CanvasBox bounds = {0, 0, canvas->width, canvas->height};
+    CanvasBox clip = {x, y, x + (width > 0 ? width : 0), y + (height > 0 ? height : 0)};
+    clip = canvas_box_intersect(clip, bounds);
+    if (canvas_box_empty(clip)) clip = (CanvasBox){0, 0, 0, 0};
+    canvas_set_clip_box(canvas, clip);
+}
+
+void canvas_reset_clip(Canvas* canvas) {
+    if (!canvas) return;
+    canvas_set_clip_box(canvas, (CanvasBox){0, 0, canvas->width, canvas->height});
+}
+
+void canvas_draw_pixel(Canvas* canvas, int x, int y) {
+    if (!canvas) return;
+    submit_op(canvas, CANVAS_CMD_PIXEL, canvas->stroke_color, x, y, 0, 0, 0.0f);
+}
+
+void canvas_draw_line(Canvas* canvas, int x0, int y0, int x1, int y1) {
+    if (!canvas) return;
+    submit_op(canvas, CANVAS_CMD_LINE, canvas->stroke_color, x0, y0, x1, y1, 0.0f);
+}
+
+void canvas_draw_rect(Canvas* canvas, int x, int y, int width, int height) {
+    if (!canvas || width <= 0 || height <= 0) return;
+    submit_op(canvas, CANVAS_CMD_RECT, canvas->stroke_color, x, y, width, height, 0.0f);
+}
+
+void canvas_fill_rect(Canvas* canvas, int x, int y, int width, int height) {
+    if (!canvas || width <= 0 || height <= 0) return;
+    submit_op(canvas, CANVAS_CMD_FILL_RECT, canvas->fill_color, x, y, width, height, 0.0f);
+}
+
+void canvas_draw_circle(Canvas* canvas, int cx, int cy, int radius) {
+    if (!canvas || radius < 0) return;
+    submit_op(canvas, CANVAS_CMD_CIRCLE, canvas->stroke_color, cx, cy, radius, 0, 0.0f);
+}
+
+void canvas_fill_circle(Canvas* canvas, int cx, int cy, int radius) {
+    if (!canvas || radius < 0) return;
+    submit_op(canvas, CANVAS_CMD_FILL_CIRCLE, canvas->fill_color, cx, cy, radius, 0, 0.0f);
+}
+
+static bool save_box_to_ppm(const Canvas* canvas, CanvasBox box, const char* filename) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) return false;
+
+    int width = box.x1 - box.x0;
+    uint8_t* row = malloc((size_t)width * 3);
+    if (!row) {
+        fclose(file);
+        return false;
+    }
+
+    bool ok = fprintf(file, "P6\n%d %d\n255\n", width, box.y1 - box.y0) > 0;
+    for (int y = box.y0; ok && y < box.y1; y++) {
+        span_pack_rgb(row, canvas_row(canvas, y) + box.x0, (size_t)width);
+        ok = fwrite(row, 3, (size_t)width, file) == (size_t)width;
+    }
+
+    free(row);
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+bool canvas_save_to_ppm(const Canvas* canvas, const char* filename) {
+    if (!canvas || !filename) return false;
+    return save_box_to_ppm(canvas, (CanvasBox){0, 0, canvas->width, canvas->height}, filename);
+}
+
+bool canvas_save_region_to_ppm(const Canvas* canvas, Rect region, const char* filename) {
+    if (!canvas || !filename) return false;
+    CanvasBox all = {0, 0, canvas->width, canvas->height};
+    CanvasBox box = canvas_box_intersect(canvas_rect_box(region), all);
+    if (canvas_box_empty(box)) return false;
+    return save_box_to_ppm(canvas, box, filename);
+}
+
+void canvas_set_damage_tracking(Canvas* canvas, bool enabled) {
+    if (!canvas || canvas->track_damage == enabled) return;
+    canvas->track_damage = enabled;
+    canvas->damage.count = 0;
+
+    // Nothing is known about the pixels yet, so the first clear is full.
+    canvas->drawn.count = 0;
+    region_add(&canvas->drawn, rect_make(0, 0, (float)canvas->width, (float)canvas->height));
+}
+
+void canvas_add_damage(Canvas* canvas, Rect rect) {
+    if (!canvas || !canvas->track_damage) return;
+    CanvasBox all = {0, 0, canvas->width, canvas->height};
+    CanvasBox box = canvas_box_intersect(canvas_rect_box(rect), all);
+    if (!canvas_box_empty(box)) add_damage_box(canvas, box);
+}
+
+const DamageRegion* canvas_get_damage(const Canvas* canvas) {
+    return canvas ? &canvas->damage : NULL;
+}
+
+Rect canvas_damage_bounds(const Canvas* canvas) {
+    if (!canvas || canvas->damage.count == 0) return rect_make(0, 0, 0, 0);
+    Rect bounds = canvas->damage.rects[0];
+    for (int i = 1; i < canvas->damage.count; i++) {
+        bounds = rect_union(bounds, canvas->damage.rects[i]);
+    }
+    return bounds;
+}
+
+void canvas_reset_damage(Canvas* canvas) {
+    if (canvas) canvas->damage.count = 0;
+}
+
+void canvas_set_pixel(Canvas* canvas, int x, int y, Color color) {
+    if (!canvas_is_valid_coordinate(canvas, x, y)) return;
+    submit_op(canvas, CANVAS_CMD_SET_PIXEL, color, x, y, 0, 0, 0.0f);
+}
+
+Color canvas_get_pixel(const Canvas* canvas, int x, int y) {
+    if (!canvas_is_valid_coordinate(canvas, x, y)) return TRANSPARENT;
+    return color_unpremultiply(canvas_row(canvas, y)[x]);
+}
+
+void canvas_composite(Canvas* dst, const Canvas* src, int x, int y) {
+    if (!dst || !src || dst == src) return;
+    CanvasCmd cmd = {
+        .op = CANVAS_CMD_COMPOSITE,
+        .args = {x, y, src->width, src->height},
+        .source = src
+    };
+    CanvasBox area = {x, y, x + src->width, y + src->height};
+    if (canvas_box_empty(canvas_box_intersect(area, canvas_clip_box(dst)))) return;
+
+    // A tracked layer on a transparent background holds nothing outside its
+    // drawn region, so only those rects need blending.
+    if (!src->track_damage || src->drawn_clear_color.a != 0) {
+        canvas_submit(dst, &cmd);
+        return;
+    }
+    CanvasBox saved = canvas_clip_box(dst);
+    for (int i = 0; i < src->drawn.count; i++) {
+        CanvasBox r = canvas_rect_box(rect_offset(src->drawn.rects[i], (float)x, (float)y));
+        CanvasBox clip = canvas_box_intersect(saved, r);
+        if (canvas_box_empty(clip)) continue;
+        canvas_set_clip_box(dst, clip);
+        CanvasCmd part = cmd;
+        canvas_submit(dst, &part);
+    }
+    canvas_set_clip_box(dst, saved);
+}
+
+bool canvas_is_valid_coordinate(const Canvas* canvas, int x, int y) {
+    return canvas && x >= 0 && y >= 0 && x < canvas->width && y < canvas->height;
+}
+
+void canvas_draw_emoji_smile(Canvas* canvas, int x, int y, int size) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_SMILE, TRANSPARENT, x, y, size, 0, 0.0f);
+}
+
+void canvas_draw_emoji_leaf(Canvas* canvas, int x, int y, int size) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_LEAF, TRANSPARENT, x, y, size, 0, 0.0f);
+}
+
+void canvas_draw_emoji_coffee(Canvas* canvas, int x, int y, int size) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_COFFEE, TRANSPARENT, x, y, size, 0, 0.0f);
+}
+
+void canvas_draw_emoji_moon(Canvas* canvas, int x, int y, int size) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_MOON, TRANSPARENT, x, y, size, 0, 0.0f);
+}
+
+void canvas_draw_emoji_sparkle(Canvas* canvas, int x, int y, int size) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_SPARKLE, TRANSPARENT, x, y, size, 0, 0.0f);
+}
+
+void canvas_set_emoji_atlas(Canvas* canvas, EmojiAtlas* atlas) {
+    if (canvas) canvas->atlas = atlas;
+}
+
+void canvas_set_sampling(Canvas* canvas, CanvasSampling sampling) {
+    if (canvas) canvas->sampling = sampling;
+}
+
+void canvas_animate_emoji_bounce(Canvas* canvas, int x, int y, int size, AnimationState* anim) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_BOUNCE, TRANSPARENT, x, y, size, 0, animation_phase(anim));
+}
+
+void canvas_animate_emoji_pulse(Canvas* canvas, int x, int y, int size, AnimationState* anim) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_PULSE, TRANSPARENT, x, y, size, 0, animation_phase(anim));
+}
+
+void canvas_animate_emoji_spin(Canvas* canvas, int x, int y, int size, AnimationState* anim) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_SPIN, TRANSPARENT, x, y, size, 0, animation_phase(anim));
+}
+
+void canvas_draw_emoji_rotated(Canvas* canvas, int x, int y, int size, float angle) {
+    if (!canvas || size <= 0) return;
+    submit_op(canvas, CANVAS_CMD_EMOJI_SPIN, TRANSPARENT, x, y, size, 0, angle / (2.0f * CANVAS_PI));
+}
@@ -1,14 +1,17 @@
 #ifndef CANVAS_H
 #define CANVAS_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "rect.h"
 
 // Forward declarations
 typedef struct Canvas Canvas;
 typedef struct Color Color;
 typedef struct Point Point;
-typedef struct Rect Rect;
+typedef struct CanvasRecorder CanvasRecorder;
+typedef struct EmojiAtlas EmojiAtlas;
 
 // Color structure for RGBA values
 struct Color {
@@ -24,23 +27,60 @@ struct Point {
     int y;
 };
 
-// Rectangle structure
-struct Rect {
-    int x;
-    int y;
-    int width;
-    int height;
-};
+// Small set of non-overlapping rects covering changed pixels
+#define CANVAS_DAMAGE_RECTS 64
+
+typedef struct DamageRegion {
+    Rect rects[CANVAS_DAMAGE_RECTS];
+    int count;
+    // The same rects as columns, for the batched overlap test
+    float x[CANVAS_DAMAGE_RECTS];
+    float y[CANVAS_DAMAGE_RECTS];
+    float width[CANVAS_DAMAGE_RECTS];
+    float height[CANVAS_DAMAGE_RECTS];
+} DamageRegion;
 
-// Canvas structure for drawing operations
+// Rows start on this byte boundary, so they line up for SIMD loads
+#define CANVAS_ROW_ALIGN 64
+
+// How spin and pulse frames are drawn when an atlas is attached: redrawn
+// shape by shape (exact, and fastest for the built-in emoji), or the cached
+// sprite resampled through the frame's rotation and scale
+typedef enum {
+    CANVAS_SAMPLE_NONE,
+    CANVAS_SAMPLE_NEAREST,
+    CANVAS_SAMPLE_BILINEAR      // smooth edges and sub-pixel motion
+} CanvasSampling;
+
+// Canvas structure for drawing operations. pixels hold premultiplied RGBA;
+// colors passed in and out of the API are straight alpha. Translucent fill
+// and stroke colors blend source-over, opaque ones overwrite.
 struct Canvas {
     int width;
     int height;
     Color* pixels;
+    size_t stride;              // bytes from one row to the next
+    bool owns_pixels;           // freed by canvas_destroy
     Color clear_color;
     Color stroke_color;
     Color fill_color;
     int stroke_width;
+    bool antialias;             // coverage-blended edges, see canvas_set_antialias
+    // Drawing is limited to [clip_x0, clip_x1) x [clip_y0, clip_y1)
+    int clip_x0;
+    int clip_y0;
+    int clip_x1;
+    int clip_y1;
+    // When set, draw calls are handed to the recorder instead of rasterized
+    CanvasRecorder* recorder;
+    // When set, emoji are blitted from the atlas, see atlas.h
+    EmojiAtlas* atlas;
+    CanvasSampling sampling;    // spin and pulse frames, see CanvasSampling
+    // Damage tracking, see canvas_set_damage_tracking
+    bool track_damage;
+    DamageRegion damage;        // changed since canvas_reset_damage
+    DamageRegion drawn;         // drawn over since the last clear
+    Color drawn_clear_color;    // what the pixels outside drawn hold
 };
 
 // Predefined neutral colors
@@ -51,14 +91,33 @@ static const Color NEUTRAL_DARK = {107, 107, 107, 255};
 static const Color NEUTRAL_TEXT = {44, 44, 44, 255};
 static const Color TRANSPARENT = {0, 0, 0, 0};
 
+static inline Color* canvas_row(const Canvas* canvas, int y) {
+    return (Color*)((uint8_t*)canvas->pixels + (size_t)y * canvas->stride);
+}
+
+// True when rows follow each other with no padding between them.
+static inline bool canvas_is_packed(const Canvas* canvas) {
+    return canvas->stride == (size_t)canvas->width * sizeof(Color);
+}
+
 // Function declarations
 Canvas* canvas_create(int width, int height);
+// Draws into caller-owned pixels, which canvas_destroy leaves alone. Rows
+// should start CANVAS_ROW_ALIGN bytes apart for the fast paths.
+Canvas* canvas_create_with_pixels(int width, int height, Color* pixels, size_t stride);
 void canvas_destroy(Canvas* canvas);
+// Restores the colors, clip and attachments a new canvas starts with. The
+// pixels are left as they are.
+void canvas_reset(Canvas* canvas);
 void canvas_clear(Canvas* canvas);
 void canvas_set_clear_color(Canvas* canvas, Color color);
 void canvas_set_stroke_color(Canvas* canvas, Color color);
 void canvas_set_fill_color(Canvas* canvas, Color color);
 void canvas_set_stroke_width(Canvas* canvas, int width);
+// Smooths the edges of lines, circles and emoji; off by default.
+void canvas_set_antialias(Canvas* canvas, bool antialias);
+void canvas_set_clip(Canvas* canvas, int x, int y, int width, int height);
+void canvas_reset_clip(Canvas* canvas);
 
 // Drawing primitives
 void canvas_draw_pixel(Canvas* canvas, int x, int y);
@@ -73,6 +132,23 @@ bool canvas_save_to_ppm(const Canvas* canvas, const char* filename);
 void canvas_set_pixel(Canvas* canvas, int x, int y, Color color);
 Color canvas_get_pixel(const Canvas* canvas, int x, int y);
 bool canvas_is_valid_coordinate(const Canvas* canvas, int x, int y);
+Color color_premultiply(Color color);
+Color color_unpremultiply(Color color);
+
+// Layers src over dst with its top-left corner at (x, y). src is read when
+// the call is rasterized, so keep it unchanged until a recorder attached
+// to dst has been flushed.
+void canvas_composite(Canvas* dst, const Canvas* src, int x, int y);
+
+// Damage tracking. While enabled, every draw call unions its bounds into
+// the damage region, and canvas_clear only repaints what was drawn since
+// the previous clear. Export the damaged area, then reset it per frame.
+void canvas_set_damage_tracking(Canvas* canvas, bool enabled);
+void canvas_add_damage(Canvas* canvas, Rect rect);
+const DamageRegion* canvas_get_damage(const Canvas* canvas);
+Rect canvas_damage_bounds(const Canvas* canvas);
+void canvas_reset_damage(Canvas* canvas);
+bool canvas_save_region_to_ppm(const Canvas* canvas, Rect region, const char* filename);
 
 // Emoji drawing functions
 void canvas_draw_emoji_smile(Canvas* canvas, int x, int y, int size);
@@ -80,6 +156,14 @@ void canvas_draw_emoji_leaf(Canvas* canvas, int x, int y, int size);
 void canvas_draw_emoji_coffee(Canvas* canvas, int x, int y, int size);
 void canvas_draw_emoji_moon(Canvas* canvas, int x, int y, int size);
 void canvas_draw_emoji_sparkle(Canvas* canvas, int x, int y, int size);
+// Emoji are blitted from atlas while it is set, NULL to rasterize them. A
+// working set of emoji bigger than the atlas keeps evicting; the atlas then
+// hands those draws back to rasterization rather than get slower than it.
+// Aliased sprites match rasterizing exactly. Anti-aliased ones are blended
+// onto the canvas as a whole rather than layer by layer, so edge pixels may
+// round one step away from rasterizing.
+void canvas_set_emoji_atlas(Canvas* canvas, EmojiAtlas* atlas);
+void canvas_set_sampling(Canvas* canvas, CanvasSampling sampling);
 
 // Animation support
 typedef struct AnimationState {
@@ -91,5 +175,8 @@ typedef struct AnimationState {
 void canvas_animate_emoji_bounce(Canvas* canvas, int x, int y, int size, AnimationState* anim);
 void canvas_animate_emoji_pulse(Canvas* canvas, int x, int y, int size, AnimationState* anim);
 void canvas_animate_emoji_spin(Canvas* canvas, int x, int y, int size, AnimationState* anim);
+// The smiley turned by angle radians about its centre, for animations
+// whose pose was computed elsewhere (see animation.h).
+void canvas_draw_emoji_rotated(Canvas* canvas, int x, int y, int size, float angle);
 
 #endif // CANVAS_H
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef CANVAS_CMD_H
+#define CANVAS_CMD_H
+
+#include "canvas.h"
+
+// Draw calls captured as data, so they can be rasterized later or split
+// across tiles. Each command carries the state it needs, which makes
+// commands independent of the order canvas setters were called in.
+typedef enum {
+    CANVAS_CMD_CLEAR,
+    CANVAS_CMD_PIXEL,
+    CANVAS_CMD_SET_PIXEL,
+    CANVAS_CMD_LINE,
+    CANVAS_CMD_RECT,
+    CANVAS_CMD_FILL_RECT,
+    CANVAS_CMD_CIRCLE,
+    CANVAS_CMD_FILL_CIRCLE,
+    CANVAS_CMD_EMOJI_SMILE,
+    CANVAS_CMD_EMOJI_LEAF,
+    CANVAS_CMD_EMOJI_COFFEE,
+    CANVAS_CMD_EMOJI_MOON,
+    CANVAS_CMD_EMOJI_SPARKLE,
+    CANVAS_CMD_EMOJI_BOUNCE,
+    CANVAS_CMD_EMOJI_PULSE,
+    CANVAS_CMD_EMOJI_SPIN,
+    CANVAS_CMD_COMPOSITE
+} CanvasCmdOp;
+
+// Emoji may draw this far outside their size x size box.
+static inline int canvas_emoji_margin(int size) {
+    return size / 16 + 2;
+}
+
+// Integer pixel box, half-open: [x0, x1) x [y0, y1)
+typedef struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} CanvasBox;
+
+typedef struct {
+    uint8_t op;
+    uint8_t sampling;       // CanvasSampling, for spin and pulse frames
+    bool antialias;
+    uint16_t stroke_width;
+    Color color;            // fill, stroke or clear color, as the op uses it
+    int args[4];
+    float phase;            // animation ops: fraction elapsed
+    const Canvas* source;   // composite: layer drawn, read when rasterized
+    CanvasBox bounds;       // every pixel the command may touch, clip applied
+} CanvasCmd;
+
+struct CanvasRecorder {
+    void (*record)(CanvasRecorder* recorder, const Canvas* canvas, const CanvasCmd* cmd);
+};
+
+// Rasterizes cmd within the canvas' current clip, ignoring any recorder.
+void canvas_cmd_execute(Canvas* canvas, const CanvasCmd* cmd);
+
+static inline CanvasBox canvas_box_intersect(CanvasBox a, CanvasBox b) {
+    CanvasBox r = {
+        a.x0 > b.x0 ? a.x0 : b.x0,
+        a.y0 > b.y0 ? a.y0 : b.y0,
+        a.x1 < b.x1 ? a.x1 : b.x1,
+        a.y1 < b.y1 ? a.y1 : b.y1
+    };
+    return r;
+}
+
+static inline bool canvas_box_empty(CanvasBox b) {
+    return b.x0 >= b.x1 || b.y0 >= b.y1;
+}
+
+static inline CanvasBox canvas_clip_box(const Canvas* canvas) {
+    CanvasBox b = {canvas->clip_x0, canvas->clip_y0, canvas->clip_x1, canvas->clip_y1};
+    return b;
+}
+
+static inline void canvas_set_clip_box(Canvas* canvas, CanvasBox b) {
+    canvas->clip_x0 = b.x0;
+    canvas->clip_y0 = b.y0;
+    canvas->clip_x1 = b.x1;
+    canvas->clip_y1 = b.y1;
+}
+
+static inline Rect canvas_box_rect(CanvasBox b) {
+    return rect_make((float)b.x0, (float)b.y0, (float)(b.x1 - b.x0), (float)(b.y1 - b.y0));
+}
+
+// Smallest pixel box covering r.
+static inline CanvasBox canvas_rect_box(Rect r) {
+    float right = r.x + r.width, bottom = r.y + r.height;
+    CanvasBox b = {(int)r.x, (int)r.y, (int)right, (int)bottom};
+    if ((float)b.x0 > r.x) b.x0--;
+    if ((float)b.y0 > r.y) b.y0--;
+    if ((float)b.x1 < right) b.x1++;
+    if ((float)b.y1 < bottom) b.y1++;
+    return b;
+}
+
+#endif // CANVAS_CMD_H
@@ -0,0 +1,234 @@
+#include "displaylist.h"
+#include "canvas_cmd.h"
+#include "rectbatch.h"
+
+#include <stdlib.h>
+
+// Opaque fills remembered while looking for hidden commands.
+#define DISPLAY_LIST_OCCLUDERS 8
+// Commands culled against the viewport per batch.
+#define DISPLAY_LIST_CULL_CHUNK 1024
+
+struct DisplayList {
+    CanvasRecorder recorder;
+    Canvas* canvas;             // while recording
+    CanvasCmd* cmds;
+    size_t count;
+    size_t capacity;
+    Rect bounds;
+    bool failed;                // a command was lost for want of memory
+    // Each command's bounds again, as columns for batched culling.
+    float* bounds_x;
+    float* bounds_y;
+    float* bounds_width;
+    float* bounds_height;
+};
+
+static bool grow_column(float** column, size_t capacity) {
+    float* grown = realloc(*column, capacity * sizeof(float));
+    if (!grown) return false;
+    *column = grown;
+    return true;
+}
+
+static RectColumns bounds_columns(const DisplayList* list, size_t first, size_t count) {
+    RectColumns c = {
+        list->bounds_x + first,
+        list->bounds_y + first,
+        list->bounds_width + first,
+        list->bounds_height + first,
+        count
+    };
+    return c;
+}
+
+// Rebuilds the bounds columns and their union after commands were removed.
+static void sync_bounds(DisplayList* list) {
+    RectColumns c = bounds_columns(list, 0, list->count);
+    for (size_t i = 0; i < list->count; i++) {
+        Rect r = canvas_box_rect(list->cmds[i].bounds);
+        rect_columns_set(&c, i, r);
+        list->bounds = i == 0 ? r : rect_union(list->bounds, r);
+    }
+}
+
+static void list_record(CanvasRecorder* recorder, const Canvas* canvas, const CanvasCmd* cmd) {
+    DisplayList* list = (DisplayList*)recorder;
+    (void)canvas;
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        CanvasCmd* cmds = realloc(list->cmds, capacity * sizeof(CanvasCmd));
+        if (!cmds) {
+            list->failed = true;
+            return;
+        }
+        list->cmds = cmds;
+        if (!grow_column(&list->bounds_x, capacity) || !grow_column(&list->bounds_y, capacity) ||
+            !grow_column(&list->bounds_width, capacity) || !grow_column(&list->bounds_height, capacity)) {
+            list->failed = true;
+            return;
+        }
+        list->capacity = capacity;
+    }
+    Rect r = canvas_box_rect(cmd->bounds);
+    RectColumns c = bounds_columns(list, 0, list->count + 1);
+    rect_columns_set(&c, list->count, r);
+    list->cmds[list->count++] = *cmd;
+
+    list->bounds = list->count == 1 ? r : rect_union(list->bounds, r);
+}
+
+DisplayList* display_list_create(void) {
+    DisplayList* list = calloc(1, sizeof(DisplayList));
+    if (!list) return NULL;
+    list->recorder.record = list_record;
+    return list;
+}
+
+void display_list_destroy(DisplayList* list) {
+    if (!list) return;
+    if (list->canvas) display_list_end(list);
+    free(list->cmds);
+    free(list->bounds_x);
+    free(list->bounds_y);
+    free(list->bounds_width);
+    free(list->bounds_height);
+    free(list);
+}
+
+void display_list_reset(DisplayList* list) {
+    if (!list) return;
+    list->count = 0;
+    list->bounds = rect_make(0, 0, 0, 0);
+    list->failed = false;
+}
+
+bool display_list_begin(DisplayList* list, Canvas* canvas) {
+    if (!list || !canvas || list->canvas || canvas->recorder) return false;
+    list->canvas = canvas;
+    canvas->recorder = &list->recorder;
+    return true;
+}
+
+bool display_list_end(DisplayList* list) {
+    if (!list || !list->canvas) return false;
+    list->canvas->recorder = NULL;
+    list->canvas = NULL;
+    return !list->failed;
+}
+
+size_t display_list_count(const DisplayList* list) {
+    return list ? list->count : 0;
+}
+
+Rect display_list_bounds(const DisplayList* list) {
+    if (!list || list->count == 0) return rect_make(0, 0, 0, 0);
+    return list->bounds;
+}
+
+// Clears and opaque rect fills overwrite every pixel inside their bounds.
+static bool is_occluder(const CanvasCmd* cmd) {
+    return cmd->op == CANVAS_CMD_CLEAR || (cmd->op == CANVAS_CMD_FILL_RECT && cmd->color.a == 255);
+}
+
+static bool box_contains(CanvasBox outer, CanvasBox inner) {
+    return inner.x0 >= outer.x0 && inner.y0 >= outer.y0 &&
+           inner.x1 <= outer.x1 && inner.y1 <= outer.y1;
+}
+
+static long long box_area(CanvasBox b) {
+    return (long long)(b.x1 - b.x0) * (b.y1 - b.y0);
+}
+
+static size_t drop_hidden(CanvasCmd* cmds, size_t count) {
+    CanvasBox occluders[DISPLAY_LIST_OCCLUDERS];
+    int occluder_count = 0;
+    bool* keep = malloc(count * sizeof(bool));
+    if (!keep) return count;
+
+    for (size_t i = count; i-- > 0;) {
+        keep[i] = true;
+        for (int k = 0; k < occluder_count; k++) {
+            if (box_contains(occluders[k], cmds[i].bounds)) {
+                keep[i] = false;
+                break;
+            }
+        }
+        if (!keep[i] || !is_occluder(&cmds[i])) continue;
+
+        // Remember the largest occluders seen so far.
+        if (occluder_count < DISPLAY_LIST_OCCLUDERS) {
+            occluders[occluder_count++] = cmds[i].bounds;
+        } else {
+            int smallest = 0;
+            for (int k = 1; k < occluder_count; k++) {
+                if (box_area(occluders[k]) < box_area(occluders[smallest])) smallest = k;
+            }
+            if (box_area(cmds[i].bounds) > box_area(occluders[smallest])) {
+                occluders[smallest] = cmds[i].bounds;
+            }
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (keep[i]) cmds[kept++] = cmds[i];
+    }
+    free(keep);
+    return kept;
+}
+
+void display_list_optimize(DisplayList* list) {
+    if (!list || list->count < 2) return;
+    size_t count = drop_hidden(list->cmds, list->count);
+    if (count == list->count) return;
+    list->count = count;
+    sync_bounds(list);
+}
+
+bool display_list_replay(const DisplayList* list, Canvas* canvas) {
+    if (!canvas) return false;
+    return display_list_replay_viewport(list, canvas,
+                                        rect_make(0, 0, (float)canvas->width, (float)canvas->height));
+}
+
+bool display_list_replay_viewport(const DisplayList* list, Canvas* canvas, Rect viewport) {
+    if (!list || !canvas || list->failed) return false;
+    if (list->count == 0) return true;
+
+    CanvasBox view = canvas_box_intersect(canvas_rect_box(viewport), canvas_clip_box(canvas));
+    if (canvas_box_empty(view)) return true;
+    Rect view_rect = canvas_box_rect(view);
+    if (!rect_intersects_rect(list->bounds, view_rect)) return true;
+
+    // Cull a chunk of commands at a time, then draw the survivors in order.
+    uint64_t visible[RECT_BATCH_WORDS(DISPLAY_LIST_CULL_CHUNK)];
+    uint32_t order[DISPLAY_LIST_CULL_CHUNK];
+    CanvasBox saved = canvas_clip_box(canvas);
+    for (size_t first = 0; first < list->count; first += DISPLAY_LIST_CULL_CHUNK) {
+        size_t chunk = list->count - first;
+        if (chunk > DISPLAY_LIST_CULL_CHUNK) chunk = DISPLAY_LIST_CULL_CHUNK;
+        RectColumns c = bounds_columns(list, first, chunk);
+        rect_batch_intersects(&c, view_rect, visible);
+        size_t shown = rect_batch_select(visible, chunk, order);
+
+        for (size_t k = 0; k < shown; k++) {
+            const CanvasCmd* cmd = &list->cmds[first + order[k]];
+            CanvasBox clip = canvas_box_intersect(cmd->bounds, view);
+            if (canvas->track_damage) {
+                canvas_add_damage(canvas, canvas_box_rect(clip));
+            }
+            if (canvas->recorder) {
+                CanvasCmd clipped = *cmd;
+                clipped.bounds = clip;
+                canvas->recorder->record(canvas->recorder, canvas, &clipped);
+            } else {
+                canvas_set_clip_box(canvas, clip);
+                canvas_cmd_execute(canvas, cmd);
+            }
+        }
+    }
+    canvas_set_clip_box(canvas, saved);
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef DISPLAYLIST_H
+#define DISPLAYLIST_H
+
+#include <stddef.h>
+#include "canvas.h"
+#include "rect.h"
+
+// Recorded draw calls that can be replayed any number of times. While a
+// list is recording, draw calls on its canvas (primitives, emoji and
+// animation frames) append commands instead of touching pixels.
+//
+// Commands are bounded by the canvas they were recorded on; replay onto a
+// canvas of the same size.
+typedef struct DisplayList DisplayList;
+
+DisplayList* display_list_create(void);
+void display_list_destroy(DisplayList* list);
+// Drops all commands, keeping the storage. The list is complete again.
+void display_list_reset(DisplayList* list);
+
+// Starts appending draw calls made on canvas. Fails if the canvas already
+// has a recorder attached.
+bool display_list_begin(DisplayList* list, Canvas* canvas);
+// Stops recording. Returns false when a command could not be stored for
+// want of memory: the list is incomplete and won't replay until reset.
+bool display_list_end(DisplayList* list);
+
+size_t display_list_count(const DisplayList* list);
+// Union of every command's bounds; empty when the list is.
+Rect display_list_bounds(const DisplayList* list);
+
+// Rewrites the list without changing what it draws: commands hidden by a
+// later opaque clear or fill are dropped.
+void display_list_optimize(DisplayList* list);
+
+// Draws the list onto canvas. If the canvas has a recorder attached (say a
+// tile renderer) the commands are forwarded to it instead. Fails, drawing
+// nothing, when the list is incomplete.
+bool display_list_replay(const DisplayList* list, Canvas* canvas);
+// As above, skipping commands outside viewport and clipping to it.
+bool display_list_replay_viewport(const DisplayList* list, Canvas* canvas, Rect viewport);
+
+#endif // DISPLAYLIST_H
@@ -0,0 +1,415 @@
+#include "effects.h"
+#include "canvas_cmd.h"
+#include "span.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EFFECTS_X86 1
+#include <immintrin.h>
+#endif
+
+// Vertical passes walk the area in strips of this many bytes, so the rows
+// a window spans stay in cache while it slides down.
+#define EFFECTS_STRIP_BYTES 256
+// Box passes making up a gaussian.
+#define EFFECTS_GAUSS_PASSES 3
+// Window sums stay well inside float's exact integer range up to here.
+#define EFFECTS_MAX_RADIUS 4096
+
+typedef struct {
+    uint8_t* data;
+    size_t capacity;
+} Scratch;
+
+struct Effects {
+    Scratch planes[2];      // the area between vertical passes
+    Scratch lines[2];       // one row between horizontal passes
+    Scratch sums;           // running column sums for a strip
+    Scratch mask;           // drop shadow coverage
+};
+
+typedef struct {
+    int radius;
+    float scale;            // 1 / (2 * radius + 1)
+} BoxPass;
+
+static uint8_t* scratch_reserve(Scratch* s, size_t bytes) {
+    if (bytes > s->capacity) {
+        uint8_t* data = realloc(s->data, bytes);
+        if (!data) return NULL;
+        s->data = data;
+        s->capacity = bytes;
+    }
+    return s->data;
+}
+
+Effects* effects_create(void) {
+    return calloc(1, sizeof(Effects));
+}
+
+void effects_destroy(Effects* fx) {
+    if (!fx) return;
+    for (int i = 0; i < 2; i++) {
+        free(fx->planes[i].data);
+        free(fx->lines[i].data);
+    }
+    free(fx->sums.data);
+    free(fx->mask.data);
+    free(fx);
+}
+
+static BoxPass box_pass(int radius) {
+    if (radius > EFFECTS_MAX_RADIUS) radius = EFFECTS_MAX_RADIUS;
+    BoxPass pass = {radius, 1.0f / (float)(2 * radius + 1)};
+    return pass;
+}
+
+// Rounded mean of a window. Float rather than an integer reciprocal: SSE2
+// has no 32-bit multiply, but converts and scales four floats at once.
+static inline uint8_t box_mean(uint32_t sum, float scale) {
+    return (uint8_t)(int32_t)((float)(int32_t)sum * scale + 0.5f);
+}
+
+// Box radii whose three passes come closest to a gaussian of deviation
+// sigma: the widths are the odd pair around the ideal one, mixed so the
+// variances add up.
+static void gauss_passes(float sigma, BoxPass* passes) {
+    float ideal = sqrtf(12.0f * sigma * sigma / EFFECTS_GAUSS_PASSES + 1.0f);
+    int lower = (int)ideal;
+    if (lower % 2 == 0) lower--;
+    int upper = lower + 2;
+    float m = (12.0f * sigma * sigma - EFFECTS_GAUSS_PASSES * lower * lower -
+               4.0f * EFFECTS_GAUSS_PASSES * lower - 3.0f * EFFECTS_GAUSS_PASSES) /
+              (-4.0f * lower - 4.0f);
+    int lower_count = (int)lroundf(m);
+    for (int i = 0; i < EFFECTS_GAUSS_PASSES; i++) {
+        int width = i < lower_count ? lower : upper;
+        passes[i] = box_pass((width - 1) / 2);
+    }
+}
+
+// One horizontal pass along a row of interleaved channels; indices past
+// either end read the end pixel.
+static inline void blur_row(uint8_t* restrict dst, const uint8_t* restrict src, int width,
+                            int channels, BoxPass pass) {
+    int r = pass.radius, last = width - 1;
+    uint32_t sum[4];
+    for (int c = 0; c < channels; c++) {
+        sum[c] = (uint32_t)(r + 1) * src[c];
+    }
+    for (int k = 1; k <= r; k++) {
+        const uint8_t* p = src + (size_t)(k < last ? k : last) * channels;
+        for (int c = 0; c < channels; c++) sum[c] += p[c];
+    }
+    for (int x = 0; x < width; x++) {
+        const uint8_t* in = src + (size_t)(x + r + 1 < last ? x + r + 1 : last) * channels;
+        const uint8_t* out = src + (size_t)(x - r > 0 ? x - r : 0) * channels;
+        for (int c = 0; c < channels; c++) {
+            dst[(size_t)x * channels + c] = box_mean(sum[c], pass.scale);
+            sum[c] += (uint32_t)in[c] - out[c];
+        }
+    }
+}
+
+static void blur_row_rgba(uint8_t* dst, const uint8_t* src, int width, BoxPass pass) {
+    blur_row(dst, src, width, 4, pass);
+}
+
+static void blur_row_alpha(uint8_t* dst, const uint8_t* src, int width, BoxPass pass) {
+    blur_row(dst, src, width, 1, pass);
+}
+
+typedef void (*RowPass)(uint8_t* dst, const uint8_t* src, int width, BoxPass pass);
+
+// Vertical passes treat every byte as its own column, whatever the
+// channels, so they run straight along the rows: sums of the window in
+// each column, first for row 0, then slid down a row at a time.
+static void column_sums(uint32_t* sums, const uint8_t* src, size_t stride, size_t columns, int height,
+                        int radius) {
+    int last = height - 1;
+    for (size_t c = 0; c < columns; c++) {
+        sums[c] = (uint32_t)(radius + 1) * src[c];
+    }
+    for (int k = 1; k <= radius; k++) {
+        const uint8_t* row = src + (size_t)(k < last ? k : last) * stride;
+        for (size_t c = 0; c < columns; c++) sums[c] += row[c];
+    }
+}
+
+static void column_step(uint8_t* d, const uint8_t* in, const uint8_t* out, uint32_t* sums, size_t from,
+                        size_t columns, float scale) {
+    for (size_t c = from; c < columns; c++) {
+        d[c] = box_mean(sums[c], scale);
+        sums[c] += (uint32_t)in[c] - out[c];
+    }
+}
+
+// Output row y, and the rows entering and leaving the window after it.
+#define COLUMN_ROWS(y)                                                                  \
+    uint8_t* d = dst + (size_t)(y) * dst_stride;                                        \
+    const uint8_t* in = src + (size_t)((y) + r + 1 < last ? (y) + r + 1 : last) * src_stride; \
+    const uint8_t* out = src + (size_t)((y) - r > 0 ? (y) - r : 0) * src_stride
+
+typedef void (*ColumnPass)(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                           size_t columns, int height, BoxPass pass, uint32_t* sums);
+
+static void blur_columns_scalar(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                                size_t columns, int height, BoxPass pass, uint32_t* sums) {
+    int r = pass.radius, last = height - 1;
+    column_sums(sums, src, src_stride, columns, height, r);
+    for (int y = 0; y < height; y++) {
+        COLUMN_ROWS(y);
+        column_step(d, in, out, sums, 0, columns, pass.scale);
+    }
+}
+
+#ifdef EFFECTS_X86
+// The same float arithmetic as box_mean, four lanes at a time.
+__attribute__((target("sse2")))
+static inline __m128i box_mean_sse2(__m128i sum, __m128 scale) {
+    __m128 mean = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale), _mm_set1_ps(0.5f));
+    return _mm_cvttps_epi32(mean);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i load_pixel_sse2(const uint8_t* p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+}
+
+// The four channels of a pixel share one register, so a row costs one
+// window update per pixel rather than one per byte.
+__attribute__((target("sse2")))
+static void blur_row_rgba_sse2(uint8_t* restrict dst, const uint8_t* restrict src, int width, BoxPass pass) {
+    int r = pass.radius, last = width - 1;
+    const __m128 scale = _mm_set1_ps(pass.scale);
+    __m128i first = load_pixel_sse2(src), sum = first;
+    for (int k = 1; k <= r; k++) {
+        sum = _mm_add_epi32(sum, _mm_add_epi32(first, load_pixel_sse2(src + (size_t)(k < last ? k : last) * 4)));
+    }
+    for (int x = 0; x < width; x++) {
+        const uint8_t* in = src + (size_t)(x + r + 1 < last ? x + r + 1 : last) * 4;
+        const uint8_t* out = src + (size_t)(x - r > 0 ? x - r : 0) * 4;
+        __m128i mean = box_mean_sse2(sum, scale);
+        mean = _mm_packus_epi16(_mm_packs_epi32(mean, mean), mean);
+        int32_t v = _mm_cvtsi128_si32(mean);
+        memcpy(dst + (size_t)x * 4, &v, sizeof(v));
+        sum = _mm_sub_epi32(_mm_add_epi32(sum, load_pixel_sse2(in)), load_pixel_sse2(out));
+    }
+}
+
+__attribute__((target("sse2")))
+static void blur_columns_sse2(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                              size_t columns, int height, BoxPass pass, uint32_t* sums) {
+    int r = pass.radius, last = height - 1;
+    const __m128 scale = _mm_set1_ps(pass.scale);
+    const __m128i zero = _mm_setzero_si128();
+    size_t whole = columns & ~(size_t)15;
+    column_sums(sums, src, src_stride, columns, height, r);
+    for (int y = 0; y < height; y++) {
+        COLUMN_ROWS(y);
+        for (size_t c = 0; c < whole; c += 16) {
+            __m128i* s = (__m128i*)(sums + c);
+            __m128i s0 = _mm_loadu_si128(s), s1 = _mm_loadu_si128(s + 1);
+            __m128i s2 = _mm_loadu_si128(s + 2), s3 = _mm_loadu_si128(s + 3);
+            __m128i lo = _mm_packs_epi32(box_mean_sse2(s0, scale), box_mean_sse2(s1, scale));
+            __m128i hi = _mm_packs_epi32(box_mean_sse2(s2, scale), box_mean_sse2(s3, scale));
+            _mm_storeu_si128((__m128i*)(d + c), _mm_packus_epi16(lo, hi));
+
+            // The window gains in and loses out; widen both to 32 bits.
+            __m128i i8 = _mm_loadu_si128((const __m128i*)(in + c));
+            __m128i o8 = _mm_loadu_si128((const __m128i*)(out + c));
+            __m128i i_lo = _mm_unpacklo_epi8(i8, zero), i_hi = _mm_unpackhi_epi8(i8, zero);
+            __m128i o_lo = _mm_unpacklo_epi8(o8, zero), o_hi = _mm_unpackhi_epi8(o8, zero);
+            s0 = _mm_sub_epi32(_mm_add_epi32(s0, _mm_unpacklo_epi16(i_lo, zero)), _mm_unpacklo_epi16(o_lo, zero));
+            s1 = _mm_sub_epi32(_mm_add_epi32(s1, _mm_unpackhi_epi16(i_lo, zero)), _mm_unpackhi_epi16(o_lo, zero));
+            s2 = _mm_sub_epi32(_mm_add_epi32(s2, _mm_unpacklo_epi16(i_hi, zero)), _mm_unpacklo_epi16(o_hi, zero));
+            s3 = _mm_sub_epi32(_mm_add_epi32(s3, _mm_unpackhi_epi16(i_hi, zero)), _mm_unpackhi_epi16(o_hi, zero));
+            _mm_storeu_si128(s, s0);
+            _mm_storeu_si128(s + 1, s1);
+            _mm_storeu_si128(s + 2, s2);
+            _mm_storeu_si128(s + 3, s3);
+        }
+        column_step(d, in, out, sums, whole, columns, pass.scale);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i box_mean_avx2(__m256i sum, __m256 scale) {
+    __m256 mean = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(sum), scale), _mm256_set1_ps(0.5f));
+    return _mm256_cvttps_epi32(mean);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i widen_avx2(const uint8_t* p) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p));
+}
+
+__attribute__((target("avx2")))
+static void blur_columns_avx2(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                              size_t columns, int height, BoxPass pass, uint32_t* sums) {
+    int r = pass.radius, last = height - 1;
+    const __m256 scale = _mm256_set1_ps(pass.scale);
+    // packs and packus work within 128-bit lanes; this puts bytes back in order.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t whole = columns & ~(size_t)31;
+    column_sums(sums, src, src_stride, columns, height, r);
+    for (int y = 0; y < height; y++) {
+        COLUMN_ROWS(y);
+        for (size_t c = 0; c < whole; c += 32) {
+            __m256i* s = (__m256i*)(sums + c);
+            __m256i s0 = _mm256_loadu_si256(s), s1 = _mm256_loadu_si256(s + 1);
+            __m256i s2 = _mm256_loadu_si256(s + 2), s3 = _mm256_loadu_si256(s + 3);
+            __m256i lo = _mm256_packs_epi32(box_mean_avx2(s0, scale), box_mean_avx2(s1, scale));
+            __m256i hi = _mm256_packs_epi32(box_mean_avx2(s2, scale), box_mean_avx2(s3, scale));
+            __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order);
+            _mm256_storeu_si256((__m256i*)(d + c), bytes);
+
+            s0 = _mm256_sub_epi32(_mm256_add_epi32(s0, widen_avx2(in + c)), widen_avx2(out + c));
+            s1 = _mm256_sub_epi32(_mm256_add_epi32(s1, widen_avx2(in + c + 8)), widen_avx2(out + c + 8));
+            s2 = _mm256_sub_epi32(_mm256_add_epi32(s2, widen_avx2(in + c + 16)), widen_avx2(out + c + 16));
+            s3 = _mm256_sub_epi32(_mm256_add_epi32(s3, widen_avx2(in + c + 24)), widen_avx2(out + c + 24));
+            _mm256_storeu_si256(s, s0);
+            _mm256_storeu_si256(s + 1, s1);
+            _mm256_storeu_si256(s + 2, s2);
+            _mm256_storeu_si256(s + 3, s3);
+        }
+        column_step(d, in, out, sums, whole, columns, pass.scale);
+    }
+    _mm256_zeroupper();
+}
+#endif
+
+typedef struct {
+    RowPass row_rgba;
+    ColumnPass columns;
+} BlurKernels;
+
+// Passes follow the span kernel choice, so span_set_kernel switches them
+// too; all of them give the same bytes. AVX2 gains nothing on one pixel
+// at a time, so rows stay on SSE2.
+static BlurKernels blur_kernels(void) {
+    switch (span_get_kernel()) {
+#ifdef EFFECTS_X86
+    case SPAN_KERNEL_AVX2:
+        return (BlurKernels){blur_row_rgba_sse2, blur_columns_avx2};
+    case SPAN_KERNEL_SSE2:
+        return (BlurKernels){blur_row_rgba_sse2, blur_columns_sse2};
+#endif
+    default:
+        return (BlurKernels){blur_row_rgba, blur_columns_scalar};
+    }
+}
+
+// Runs the passes over a width x height area of 1- or 4-byte pixels in
+// place: each row through every horizontal pass while it is in L1, then
+// each strip through every vertical pass.
+static bool blur_area(Effects* fx, uint8_t* base, size_t stride, int width, int height, int channels,
+                      const BoxPass* passes, int count) {
+    size_t row_bytes = (size_t)width * channels;
+    uint8_t* planes[2] = {
+        scratch_reserve(&fx->planes[0], row_bytes * height),
+        scratch_reserve(&fx->planes[1], row_bytes * height)
+    };
+    uint8_t* lines[2] = {scratch_reserve(&fx->lines[0], row_bytes), scratch_reserve(&fx->lines[1], row_bytes)};
+    uint32_t* sums = (uint32_t*)scratch_reserve(&fx->sums, EFFECTS_STRIP_BYTES * sizeof(uint32_t));
+    if (!planes[0] || !planes[1] || !lines[0] || !lines[1] || !sums) return false;
+
+    BlurKernels kernels = blur_kernels();
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = base + (size_t)y * stride;
+        for (int p = 0; p < count; p++) {
+            uint8_t* dst = p == count - 1 ? planes[0] + (size_t)y * row_bytes : lines[p % 2];
+            if (channels == 4) {
+                kernels.row_rgba(dst, src, width, passes[p]);
+            } else {
+                blur_row_alpha(dst, src, width, passes[p]);
+            }
+            src = dst;
+        }
+    }
+
+    for (size_t c0 = 0; c0 < row_bytes; c0 += EFFECTS_STRIP_BYTES) {
+        size_t columns = row_bytes - c0 < EFFECTS_STRIP_BYTES ? row_bytes - c0 : EFFECTS_STRIP_BYTES;
+        for (int p = 0; p < count; p++) {
+            const uint8_t* src = planes[p % 2] + c0;
+            bool final = p == count - 1;
+            uint8_t* dst = final ? base + c0 : planes[(p + 1) % 2] + c0;
+            kernels.columns(dst, final ? stride : row_bytes, src, row_bytes, columns, height, passes[p], sums);
+        }
+    }
+    return true;
+}
+
+static bool blur_canvas(Effects* fx, Canvas* canvas, Rect region, const BoxPass* passes, int count) {
+    if (!fx || !canvas || canvas->recorder) return false;
+    CanvasBox box = canvas_box_intersect(canvas_rect_box(region), canvas_clip_box(canvas));
+    if (canvas_box_empty(box) || count == 0) return true;
+
+    uint8_t* base = (uint8_t*)(canvas_row(canvas, box.y0) + box.x0);
+    if (!blur_area(fx, base, canvas->stride, box.x1 - box.x0, box.y1 - box.y0, 4, passes, count)) {
+        return false;
+    }
+    canvas_add_damage(canvas, canvas_box_rect(box));
+    return true;
+}
+
+bool effects_box_blur(Effects* fx, Canvas* canvas, Rect region, int radius) {
+    BoxPass pass = box_pass(radius);
+    return blur_canvas(fx, canvas, region, &pass, radius > 0);
+}
+
+bool effects_gaussian_blur(Effects* fx, Canvas* canvas, Rect region, float sigma) {
+    BoxPass passes[EFFECTS_GAUSS_PASSES];
+    if (sigma > 0.0f) gauss_passes(sigma, passes);
+    return blur_canvas(fx, canvas, region, passes, sigma > 0.0f ? EFFECTS_GAUSS_PASSES : 0);
+}
+
+bool effects_drop_shadow(Effects* fx, Canvas* dst, const Canvas* src, int x, int y,
+                         const DropShadow* shadow) {
+    if (!fx || !dst || !src || !shadow || dst == src || dst->recorder) return false;
+
+    // The mask has room for the blur to spread past src on every side.
+    BoxPass passes[EFFECTS_GAUSS_PASSES];
+    int count = 0, margin = 0;
+    if (shadow->blur > 0.0f) {
+        gauss_passes(shadow->blur * 0.5f, passes);
+        count = EFFECTS_GAUSS_PASSES;
+        for (int i = 0; i < count; i++) margin += passes[i].radius;
+    }
+    int mask_width = src->width + 2 * margin, mask_height = src->height + 2 * margin;
+
+    Color color = color_premultiply(shadow->color);
+    CanvasBox all = {x + shadow->offset_x - margin, y + shadow->offset_y - margin, 0, 0};
+    all.x1 = all.x0 + mask_width;
+    all.y1 = all.y0 + mask_height;
+    CanvasBox box = canvas_box_intersect(all, canvas_clip_box(dst));
+
+    if (color.a > 0 && !canvas_box_empty(box)) {
+        uint8_t* mask = scratch_reserve(&fx->mask, (size_t)mask_width * mask_height);
+        if (!mask) return false;
+        memset(mask, 0, (size_t)mask_width * mask_height);
+        for (int row = 0; row < src->height; row++) {
+            const Color* s = canvas_row(src, row);
+            uint8_t* m = mask + (size_t)(row + margin) * mask_width + margin;
+            for (int col = 0; col < src->width; col++) m[col] = s[col].a;
+        }
+        // Zero margins as wide as the radii make clamped edges read as clear.
+        if (count && !blur_area(fx, mask, (size_t)mask_width, mask_width, mask_height, 1, passes, count)) {
+            return false;
+        }
+        for (int row = box.y0; row < box.y1; row++) {
+            const uint8_t* m = mask + (size_t)(row - all.y0) * mask_width + (box.x0 - all.x0);
+            span_blend_mask(canvas_row(dst, row) + box.x0, color, m, (size_t)(box.x1 - box.x0));
+        }
+        canvas_add_damage(dst, canvas_box_rect(box));
+    }
+    canvas_composite(dst, src, x, y);
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <stdbool.h>
+#include "canvas.h"
+
+// Blur and drop shadow passes over canvas pixels, for card previews with
+// the site's soft shadows. Blurs are separable and run on running sums, so
+// their cost per pixel doesn't grow with the radius. Rows are blurred one
+// at a time; columns in strips narrow enough to stay in cache. The
+// Effects context keeps its scratch buffers between calls, so reuse one
+// per thread rather than creating one per frame.
+//
+// Effects work on the pixels directly, so they fail while a recorder is
+// attached to the canvas. Only pixels inside the clip are read or
+// written, and the changed area is added to the damage region.
+typedef struct Effects Effects;
+
+typedef struct {
+    int offset_x;
+    int offset_y;
+    float blur;             // CSS blur radius: a gaussian of deviation blur / 2
+    Color color;            // straight alpha
+} DropShadow;
+
+// The site's hovered emoji card: box-shadow: 0 4px 12px rgba(0, 0, 0, 0.05)
+static const DropShadow CARD_HOVER_SHADOW = {0, 4, 12.0f, {0, 0, 0, 13}};
+
+Effects* effects_create(void);
+void effects_destroy(Effects* fx);
+
+// Each pixel of region becomes the mean of the square of side
+// 2 * radius + 1 around it. Pixels past the region's edges count as copies
+// of the edge.
+bool effects_box_blur(Effects* fx, Canvas* canvas, Rect region, int radius);
+// A gaussian of deviation sigma, as three box blurs in a row, the way
+// browsers draw CSS blurs. Edges as above.
+bool effects_gaussian_blur(Effects* fx, Canvas* canvas, Rect region, float sigma);
+
+// Composites src onto dst with its corner at (x, y), over a shadow cast by
+// src's alpha.
+bool effects_drop_shadow(Effects* fx, Canvas* dst, const Canvas* src, int x, int y,
+                         const DropShadow* shadow);
+
+#endif // EFFECTS_H
@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+
+#include "framepool.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define FRAME_POOL_HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+typedef struct {
+    Surface surface;        // first, so a Surface* leads back to its buffer
+    Canvas* canvas;         // header for buffers handed out as canvases
+    void* memory;
+    size_t mapped_bytes;
+    bool in_use;
+    uint64_t released_at;
+} PoolBuffer;
+
+struct FramePool {
+    pthread_mutex_t mutex;
+    unsigned flags;
+    size_t max_idle_bytes;
+    size_t idle_bytes;
+    PoolBuffer** buffers;
+    int count;
+    int capacity;
+    uint64_t clock;
+};
+
+static void* map_buffer(size_t bytes, bool huge, size_t* mapped_bytes) {
+#ifdef MAP_HUGETLB
+    // Explicit huge pages need pages reserved by the admin; fall back to
+    // transparent huge pages when there are none.
+    if (huge) {
+        size_t rounded = (bytes + FRAME_POOL_HUGE_PAGE_SIZE - 1) & ~(FRAME_POOL_HUGE_PAGE_SIZE - 1);
+        void* p = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            *mapped_bytes = rounded;
+            return p;
+        }
+    }
+#endif
+    void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+    if (huge) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    *mapped_bytes = bytes;
+    return p;
+}
+
+static void free_buffer(PoolBuffer* buffer) {
+    if (buffer->canvas) canvas_destroy(buffer->canvas);
+    munmap(buffer->memory, buffer->mapped_bytes);
+    free(buffer);
+}
+
+FramePool* frame_pool_create(unsigned flags, size_t max_idle_bytes) {
+    FramePool* pool = calloc(1, sizeof(FramePool));
+    if (!pool) return NULL;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pool->flags = flags;
+    pool->max_idle_bytes = max_idle_bytes;
+    return pool;
+}
+
+void frame_pool_destroy(FramePool* pool) {
+    if (!pool) return;
+    for (int i = 0; i < pool->count; i++) {
+        free_buffer(pool->buffers[i]);
+    }
+    free(pool->buffers);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+static void remove_buffer(FramePool* pool, int index) {
+    PoolBuffer* buffer = pool->buffers[index];
+    pool->idle_bytes -= buffer->mapped_bytes;
+    pool->buffers[index] = pool->buffers[--pool->count];
+    free_buffer(buffer);
+}
+
+void frame_pool_trim(FramePool* pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = pool->count; i-- > 0;) {
+        if (!pool->buffers[i]->in_use) remove_buffer(pool, i);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static PoolBuffer* acquire_buffer(FramePool* pool, int width, int height, PixelFormat format) {
+    if (width <= 0 || height <= 0 || format >= PIXEL_FORMAT_COUNT) return NULL;
+
+    pthread_mutex_lock(&pool->mutex);
+    // Reuse the most recently released match; its pages are likeliest warm.
+    PoolBuffer* best = NULL;
+    for (int i = 0; i < pool->count; i++) {
+        PoolBuffer* b = pool->buffers[i];
+        if (b->in_use || b->surface.width != width || b->surface.height != height ||
+            b->surface.format != format) continue;
+        if (!best || b->released_at > best->released_at) best = b;
+    }
+    if (best) {
+        best->in_use = true;
+        pool->idle_bytes -= best->mapped_bytes;
+        pthread_mutex_unlock(&pool->mutex);
+        return best;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    // Map outside the lock; a new buffer is private until it is returned.
+    PoolBuffer* buffer = calloc(1, sizeof(PoolBuffer));
+    if (!buffer) return NULL;
+    size_t stride = pixel_format_stride(format, width);
+    buffer->memory = map_buffer(stride * height, pool->flags & FRAME_POOL_HUGE_PAGES, &buffer->mapped_bytes);
+    if (!buffer->memory) {
+        free(buffer);
+        return NULL;
+    }
+    buffer->surface = (Surface){width, height, format, stride, buffer->memory};
+    buffer->in_use = true;
+
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->count == pool->capacity) {
+        int capacity = pool->capacity ? pool->capacity * 2 : 16;
+        PoolBuffer** buffers = realloc(pool->buffers, capacity * sizeof(PoolBuffer*));
+        if (!buffers) {
+            pthread_mutex_unlock(&pool->mutex);
+            free_buffer(buffer);
+            return NULL;
+        }
+        pool->buffers = buffers;
+        pool->capacity = capacity;
+    }
+    pool->buffers[pool->count++] = buffer;
+    pthread_mutex_unlock(&pool->mutex);
+    return buffer;
+}
+
+static void release_buffer(FramePool* pool, PoolBuffer* buffer) {
+    pthread_mutex_lock(&pool->mutex);
+    buffer->in_use = false;
+    buffer->released_at = ++pool->clock;
+    pool->idle_bytes += buffer->mapped_bytes;
+
+    while (pool->max_idle_bytes && pool->idle_bytes > pool->max_idle_bytes) {
+        int oldest = -1;
+        for (int i = 0; i < pool->count; i++) {
+            PoolBuffer* b = pool->buffers[i];
+            if (b->in_use) continue;
+            if (oldest < 0 || b->released_at < pool->buffers[oldest]->released_at) oldest = i;
+        }
+        if (oldest < 0) break;
+        remove_buffer(pool, oldest);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+Canvas* frame_pool_acquire_canvas(FramePool* pool, int width, int height) {
+    if (!pool) return NULL;
+    PoolBuffer* buffer = acquire_buffer(pool, width, height, PIXEL_FORMAT_RGBA8888);
+    if (!buffer) return NULL;
+    if (!buffer->canvas) {
+        Canvas* canvas = canvas_create_with_pixels(width, height, (Color*)buffer->memory,
+                                                   buffer->surface.stride);
+        if (!canvas) {
+            release_buffer(pool, buffer);
+            return NULL;
+        }
+        // Releases on other threads look buffers up by canvas under the lock.
+        pthread_mutex_lock(&pool->mutex);
+        buffer->canvas = canvas;
+        pthread_mutex_unlock(&pool->mutex);
+    } else {
+        canvas_reset(buffer->canvas);
+    }
+    return buffer->canvas;
+}
+
+void frame_pool_release_canvas(FramePool* pool, Canvas* canvas) {
+    if (!pool || !canvas) return;
+    PoolBuffer* buffer = NULL;
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->buffers[i]->canvas == canvas) {
+            buffer = pool->buffers[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (buffer) release_buffer(pool, buffer);
+}
+
+Surface* frame_pool_acquire_surface(FramePool* pool, int width, int height, PixelFormat format) {
+    if (!pool) return NULL;
+    PoolBuffer* buffer = acquire_buffer(pool, width, height, format);
+    return buffer ? &buffer->surface : NULL;
+}
+
+void frame_pool_release_surface(FramePool* pool, Surface* surface) {
+    if (!pool || !surface) return;
+    release_buffer(pool, (PoolBuffer*)surface);
+}
+
+struct SwapChain {
+    FramePool* pool;
+    Canvas** canvases;
+    int count;
+    int* free_list;
+    int free_count;
+    int* ready;             // ring of presented buffers, oldest first
+    int ready_head;
+    int ready_count;
+    int back;               // held by the writer, or -1
+    int front;              // held by the reader, or -1
+    bool closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+};
+
+SwapChain* swap_chain_create(FramePool* pool, int width, int height, int buffers) {
+    if (!pool || buffers < 2) return NULL;
+    SwapChain* chain = calloc(1, sizeof(SwapChain));
+    if (!chain) return NULL;
+    chain->pool = pool;
+    chain->back = chain->front = -1;
+    pthread_mutex_init(&chain->mutex, NULL);
+    pthread_cond_init(&chain->changed, NULL);
+    chain->canvases = calloc((size_t)buffers, sizeof(Canvas*));
+    chain->free_list = calloc((size_t)buffers, sizeof(int));
+    chain->ready = calloc((size_t)buffers, sizeof(int));
+    if (!chain->canvases || !chain->free_list || !chain->ready) {
+        swap_chain_destroy(chain);
+        return NULL;
+    }
+    for (int i = 0; i < buffers; i++) {
+        chain->canvases[i] = frame_pool_acquire_canvas(pool, width, height);
+        if (!chain->canvases[i]) {
+            swap_chain_destroy(chain);
+            return NULL;
+        }
+        chain->count++;
+        chain->free_list[chain->free_count++] = i;
+    }
+    return chain;
+}
+
+void swap_chain_destroy(SwapChain* chain) {
+    if (!chain) return;
+    for (int i = 0; i < chain->count; i++) {
+        frame_pool_release_canvas(chain->pool, chain->canvases[i]);
+    }
+    pthread_mutex_destroy(&chain->mutex);
+    pthread_cond_destroy(&chain->changed);
+    free(chain->canvases);
+    free(chain->free_list);
+    free(chain->ready);
+    free(chain);
+}
+
+Canvas* swap_chain_back(SwapChain* chain) {
+    pthread_mutex_lock(&chain->mutex);
+    while (chain->back < 0 && chain->free_count == 0) {
+        pthread_cond_wait(&chain->changed, &chain->mutex);
+    }
+    if (chain->back < 0) chain->back = chain->free_list[--chain->free_count];
+    Canvas* canvas = chain->canvases[chain->back];
+    pthread_mutex_unlock(&chain->mutex);
+    return canvas;
+}
+
+void swap_chain_present(SwapChain* chain) {
+    pthread_mutex_lock(&chain->mutex);
+    if (chain->back >= 0) {
+        chain->ready[(chain->ready_head + chain->ready_count) % chain->count] = chain->back;
+        chain->ready_count++;
+        chain->back = -1;
+        pthread_cond_broadcast(&chain->changed);
+    }
+    pthread_mutex_unlock(&chain->mutex);
+}
+
+void swap_chain_close(SwapChain* chain) {
+    pthread_mutex_lock(&chain->mutex);
+    chain->closed = true;
+    pthread_cond_broadcast(&chain->changed);
+    pthread_mutex_unlock(&chain->mutex);
+}
+
+const Canvas* swap_chain_front(SwapChain* chain) {
+    pthread_mutex_lock(&chain->mutex);
+    while (chain->front < 0 && chain->ready_count == 0 && !chain->closed) {
+        pthread_cond_wait(&chain->changed, &chain->mutex);
+    }
+    if (chain->front < 0 && chain->ready_count > 0) {
+        chain->front = chain->ready[chain->ready_head];
+        chain->ready_head = (chain->ready_head + 1) % chain->count;
+        chain->ready_count--;
+    }
+    const Canvas* canvas = chain->front >= 0 ? chain->canvases[chain->front] : NULL;
+    pthread_mutex_unlock(&chain->mutex);
+    return canvas;
+}
+
+void swap_chain_release(SwapChain* chain) {
+    pthread_mutex_lock(&chain->mutex);
+    if (chain->front >= 0) {
+        chain->free_list[chain->free_count++] = chain->front;
+        chain->front = -1;
+        pthread_cond_broadcast(&chain->changed);
+    }
+    pthread_mutex_unlock(&chain->mutex);
+}
@@ -0,0 +1,52 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <stddef.h>
+#include "canvas.h"
+#include "surface.h"
+
+// Recycles pixel buffers keyed by size and format, so rendering frame after
+// frame stops allocating. Released buffers are kept for the next acquire
+// of the same key. Buffers are mapped straight from the kernel, on huge
+// pages when asked. A pool may be used from several threads.
+typedef struct FramePool FramePool;
+
+#define FRAME_POOL_HUGE_PAGES 1u
+
+// Idle buffers beyond max_idle_bytes are unmapped on release, oldest
+// first; 0 keeps everything.
+FramePool* frame_pool_create(unsigned flags, size_t max_idle_bytes);
+// Every buffer must have been released.
+void frame_pool_destroy(FramePool* pool);
+// Unmaps all idle buffers.
+void frame_pool_trim(FramePool* pool);
+
+// The canvas comes back reset (see canvas_reset) but not cleared: its
+// pixels are whatever the last user left. Release it instead of calling
+// canvas_destroy.
+Canvas* frame_pool_acquire_canvas(FramePool* pool, int width, int height);
+void frame_pool_release_canvas(FramePool* pool, Canvas* canvas);
+// As above for surfaces; do not surface_destroy them.
+Surface* frame_pool_acquire_surface(FramePool* pool, int width, int height, PixelFormat format);
+void frame_pool_release_surface(FramePool* pool, Surface* surface);
+
+// A fixed set of pooled canvases passed from one writer thread to one
+// reader thread in order: the writer draws frame n + 1 while the reader
+// still encodes frame n. Two buffers make a double buffer.
+typedef struct SwapChain SwapChain;
+
+SwapChain* swap_chain_create(FramePool* pool, int width, int height, int buffers);
+void swap_chain_destroy(SwapChain* chain);
+
+// Writer: waits for a free buffer, draws into it, then presents it.
+Canvas* swap_chain_back(SwapChain* chain);
+void swap_chain_present(SwapChain* chain);
+// No more frames will be presented.
+void swap_chain_close(SwapChain* chain);
+
+// Reader: waits for the oldest presented frame and hands it back once
+// done. Returns NULL after the chain is closed and drained.
+const Canvas* swap_chain_front(SwapChain* chain);
+void swap_chain_release(SwapChain* chain);
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+
+#include "framering.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define FRAME_RING_MAGIC 0x474e5246u     // "FRNG"
+#define FRAME_RING_VERSION 1u
+// Frame counts wrap at 2^31: presented keeps the closed flag in bit 0.
+#define FRAME_RING_COUNT_MASK 0x7fffffffu
+#define FRAME_RING_CLOSED 1u
+
+// Start of the segment, written by the writer before anyone else maps it.
+// The counters are futex words; each side only writes its own cache line.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    uint64_t stride;
+    uint32_t buffers;
+    uint32_t reserved;
+    uint64_t frame_offset;          // page aligned, so readers can map frames alone
+    uint64_t frame_bytes;           // page aligned
+    alignas(64) _Atomic uint32_t presented;  // frames presented * 2, | FRAME_RING_CLOSED
+    _Atomic uint32_t reader_waiting;
+    uint64_t sequence[FRAME_RING_MAX_BUFFERS];   // of the frame in each buffer
+    alignas(64) _Atomic uint32_t released;   // frames handed back by the reader
+    _Atomic uint32_t writer_waiting;
+} RingHeader;
+
+struct FrameRing {
+    RingHeader* header;
+    uint8_t* frames;
+    size_t mapped_bytes;            // header mapping, and frames for the writer
+    Canvas* canvases[FRAME_RING_MAX_BUFFERS];
+    int buffers;
+    int fd;                         // writer only
+    char* name;                     // shm object the writer removes
+    bool writer;
+    uint64_t next;                  // writer: frames presented; reader: frames released
+    int held;                       // buffer out with the caller, or -1
+};
+
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2, "futex words must be lock-free");
+
+static size_t page_round(size_t bytes) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (bytes + page - 1) / page * page;
+}
+
+static void futex_wait(_Atomic uint32_t* word, uint32_t seen) {
+    // Shared futexes: the word lives in a mapping other processes see.
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, seen, NULL, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t* word) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// Sleeps until word may no longer hold seen. The waiting flag lets the other
+// side skip the wake syscall when nobody sleeps; both sides store then load
+// with sequential consistency, so one of them always sees the other.
+static void wait_for_change(_Atomic uint32_t* word, uint32_t seen, _Atomic uint32_t* waiting) {
+    atomic_store(waiting, 1);
+    if (atomic_load(word) == seen) futex_wait(word, seen);
+    atomic_store(waiting, 0);
+}
+
+static void wake_waiter(_Atomic uint32_t* word, _Atomic uint32_t* waiting) {
+    if (atomic_load(waiting)) futex_wake(word);
+}
+
+static bool make_canvases(FrameRing* ring) {
+    RingHeader* h = ring->header;
+    for (int i = 0; i < ring->buffers; i++) {
+        Color* pixels = (Color*)(ring->frames + (size_t)i * h->frame_bytes);
+        ring->canvases[i] = canvas_create_with_pixels(h->width, h->height, pixels, h->stride);
+        if (!ring->canvases[i]) return false;
+    }
+    return true;
+}
+
+FrameRing* frame_ring_create(const char* name, int width, int height, int buffers) {
+    if (width <= 0 || height <= 0 || buffers < 1 || buffers > FRAME_RING_MAX_BUFFERS ||
+        (buffers & (buffers - 1))) {
+        return NULL;
+    }
+    FrameRing* ring = calloc(1, sizeof(FrameRing));
+    if (!ring) return NULL;
+    ring->writer = true;
+    ring->held = -1;
+    ring->buffers = buffers;
+
+    size_t row_bytes = (size_t)width * sizeof(Color);
+    size_t stride = (row_bytes + CANVAS_ROW_ALIGN - 1) / CANVAS_ROW_ALIGN * CANVAS_ROW_ALIGN;
+    size_t frame_offset = page_round(sizeof(RingHeader));
+    size_t frame_bytes = page_round(stride * height);
+    ring->mapped_bytes = frame_offset + frame_bytes * buffers;
+
+    if (name) {
+        ring->name = strdup(name);
+        ring->fd = ring->name ? shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600) : -1;
+    } else {
+        ring->fd = memfd_create("frame-ring", MFD_CLOEXEC);
+    }
+    if (ring->fd < 0) {
+        free(ring->name);
+        free(ring);
+        return NULL;
+    }
+    // The segment starts zeroed, row padding included.
+    void* memory = MAP_FAILED;
+    if (ftruncate(ring->fd, (off_t)ring->mapped_bytes) == 0) {
+        memory = mmap(NULL, ring->mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+    }
+    if (memory == MAP_FAILED) {
+        frame_ring_destroy(ring);
+        return NULL;
+    }
+    ring->header = memory;
+    ring->frames = (uint8_t*)memory + frame_offset;
+
+    RingHeader* h = ring->header;
+    h->width = width;
+    h->height = height;
+    h->stride = stride;
+    h->buffers = (uint32_t)buffers;
+    h->frame_offset = frame_offset;
+    h->frame_bytes = frame_bytes;
+    h->version = FRAME_RING_VERSION;
+    // Last, so a reader never accepts a half-written header.
+    atomic_thread_fence(memory_order_release);
+    h->magic = FRAME_RING_MAGIC;
+
+    if (!make_canvases(ring)) {
+        frame_ring_destroy(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+FrameRing* frame_ring_open(const char* name) {
+    if (!name) return NULL;
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) return NULL;
+    FrameRing* ring = frame_ring_open_fd(fd);
+    close(fd);
+    return ring;
+}
+
+FrameRing* frame_ring_open_fd(int fd) {
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RingHeader)) return NULL;
+
+    FrameRing* ring = calloc(1, sizeof(FrameRing));
+    if (!ring) return NULL;
+    ring->fd = -1;
+    ring->held = -1;
+
+    // Map the header alone until it checks out.
+    size_t header_bytes = page_round(sizeof(RingHeader));
+    void* memory = mmap(NULL, header_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        free(ring);
+        return NULL;
+    }
+    ring->header = memory;
+    ring->mapped_bytes = header_bytes;
+
+    RingHeader* h = ring->header;
+    bool valid = h->magic == FRAME_RING_MAGIC && h->version == FRAME_RING_VERSION;
+    atomic_thread_fence(memory_order_acquire);
+    valid = valid && h->width > 0 && h->height > 0 &&
+            h->stride >= (uint64_t)h->width * sizeof(Color) &&
+            h->buffers >= 1 && h->buffers <= FRAME_RING_MAX_BUFFERS &&
+            !(h->buffers & (h->buffers - 1)) && h->frame_offset == header_bytes &&
+            h->frame_bytes >= h->stride * (uint64_t)h->height &&
+            (uint64_t)st.st_size >= h->frame_offset + h->frame_bytes * h->buffers;
+    if (!valid) {
+        frame_ring_destroy(ring);
+        return NULL;
+    }
+    ring->buffers = (int)h->buffers;
+
+    // Readers only ever read pixels.
+    size_t frames_bytes = h->frame_bytes * h->buffers;
+    memory = mmap(NULL, frames_bytes, PROT_READ, MAP_SHARED, fd, (off_t)h->frame_offset);
+    if (memory == MAP_FAILED) {
+        frame_ring_destroy(ring);
+        return NULL;
+    }
+    ring->frames = memory;
+    ring->next = atomic_load(&h->released);
+
+    if (!make_canvases(ring)) {
+        frame_ring_destroy(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+void frame_ring_destroy(FrameRing* ring) {
+    if (!ring) return;
+    if (ring->writer && ring->header) frame_ring_close(ring);
+    for (int i = 0; i < ring->buffers; i++) {
+        canvas_destroy(ring->canvases[i]);
+    }
+    if (!ring->writer && ring->frames) {
+        munmap(ring->frames, ring->header->frame_bytes * ring->buffers);
+    }
+    if (ring->header) munmap(ring->header, ring->mapped_bytes);
+    if (ring->fd >= 0) close(ring->fd);
+    if (ring->name) shm_unlink(ring->name);
+    free(ring->name);
+    free(ring);
+}
+
+int frame_ring_fd(const FrameRing* ring) {
+    return ring ? ring->fd : -1;
+}
+
+int frame_ring_width(const FrameRing* ring) {
+    return ring ? ring->header->width : 0;
+}
+
+int frame_ring_height(const FrameRing* ring) {
+    return ring ? ring->header->height : 0;
+}
+
+Canvas* frame_ring_back(FrameRing* ring) {
+    if (!ring || !ring->writer) return NULL;
+    RingHeader* h = ring->header;
+    if (ring->held < 0) {
+        for (;;) {
+            uint32_t released = atomic_load(&h->released);
+            uint32_t in_flight = ((uint32_t)ring->next - released) & FRAME_RING_COUNT_MASK;
+            if (in_flight < (uint32_t)ring->buffers) break;
+            wait_for_change(&h->released, released, &h->writer_waiting);
+        }
+        ring->held = (int)(ring->next & (uint64_t)(ring->buffers - 1));
+    }
+    return ring->canvases[ring->held];
+}
+
+uint64_t frame_ring_present(FrameRing* ring) {
+    if (!ring || !ring->writer || ring->held < 0) return 0;
+    RingHeader* h = ring->header;
+    uint64_t sequence = ring->next++;
+    h->sequence[ring->held] = sequence;
+    ring->held = -1;
+    atomic_fetch_add(&h->presented, 2);
+    wake_waiter(&h->presented, &h->reader_waiting);
+    return sequence;
+}
+
+void frame_ring_close(FrameRing* ring) {
+    if (!ring || !ring->writer) return;
+    RingHeader* h = ring->header;
+    atomic_fetch_or(&h->presented, FRAME_RING_CLOSED);
+    futex_wake(&h->presented);
+}
+
+const Canvas* frame_ring_front(FrameRing* ring, uint64_t* sequence) {
+    if (!ring || ring->writer) return NULL;
+    RingHeader* h = ring->header;
+    if (ring->held < 0) {
+        for (;;) {
+            uint32_t presented = atomic_load(&h->presented);
+            uint32_t ready = ((presented >> 1) - (uint32_t)ring->next) & FRAME_RING_COUNT_MASK;
+            if (ready > 0) break;
+            if (presented & FRAME_RING_CLOSED) return NULL;
+            wait_for_change(&h->presented, presented, &h->reader_waiting);
+        }
+        ring->held = (int)(ring->next & (uint64_t)(ring->buffers - 1));
+    }
+    if (sequence) *sequence = h->sequence[ring->held];
+    return ring->canvases[ring->held];
+}
+
+void frame_ring_release(FrameRing* ring) {
+    if (!ring || ring->writer || ring->held < 0) return;
+    RingHeader* h = ring->header;
+    ring->next++;
+    ring->held = -1;
+    atomic_store(&h->released, (uint32_t)ring->next & FRAME_RING_COUNT_MASK);
+    wake_waiter(&h->released, &h->writer_waiting);
+}
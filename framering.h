@@ -0,0 +1,52 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <stdint.h>
+#include "canvas.h"
+
+// A ring of canvases in one shared memory segment, passed from a writer
+// process to a reader process in order, like a SwapChain across processes.
+// The reader maps the writer's pixels directly: nothing is copied and
+// nothing touches the filesystem. Handoff goes through counters in the
+// segment, and a side only enters the kernel to sleep when the other has
+// nothing for it.
+//
+// One writer and one reader at a time. A reader that dies holding a frame
+// leaves the writer waiting for it. Linux only.
+typedef struct FrameRing FrameRing;
+
+// Most buffers a ring can hold; the count must be a power of two.
+#define FRAME_RING_MAX_BUFFERS 16
+
+// Writer: creates the segment. With a name it is a POSIX shm object
+// ("/name") that readers open by name, removed again by
+// frame_ring_destroy; without one it is an anonymous memfd, shared by
+// handing over frame_ring_fd.
+FrameRing* frame_ring_create(const char* name, int width, int height, int buffers);
+// Reader: maps a ring by shm name, or from a descriptor received by fork or
+// over a unix socket. The descriptor is not kept.
+FrameRing* frame_ring_open(const char* name);
+FrameRing* frame_ring_open_fd(int fd);
+// For the writer, also closes the ring.
+void frame_ring_destroy(FrameRing* ring);
+
+// The writer's descriptor for the segment, or -1 for a reader. It is
+// close-on-exec; pass it over a socket or dup it for an exec'd reader.
+int frame_ring_fd(const FrameRing* ring);
+int frame_ring_width(const FrameRing* ring);
+int frame_ring_height(const FrameRing* ring);
+
+// Writer: waits for a free buffer, draws into it, then presents it.
+// Present returns the frame's sequence number, counting from 0.
+Canvas* frame_ring_back(FrameRing* ring);
+uint64_t frame_ring_present(FrameRing* ring);
+// No more frames will be presented.
+void frame_ring_close(FrameRing* ring);
+
+// Reader: waits for the oldest presented frame and hands it back once
+// done. The pixels are mapped read-only, so never draw into the canvas.
+// Returns NULL after the ring is closed and drained.
+const Canvas* frame_ring_front(FrameRing* ring, uint64_t* sequence);
+void frame_ring_release(FrameRing* ring);
+
+#endif // FRAMERING_H
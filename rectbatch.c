@@ -0,0 +1,353 @@
+#include "rectbatch.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RECT_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+// Bounds of a run of rects as edges; the kernels fold their lanes into it.
+typedef struct {
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+} RectEdges;
+
+typedef struct {
+    void (*intersects)(const RectColumns* rects, Rect r, uint64_t* mask);
+    void (*contains_point)(const RectColumns* rects, float px, float py, uint64_t* mask);
+    void (*intersection)(const RectColumns* rects, Rect r, RectColumns* out);
+    void (*area)(const RectColumns* rects, float* out);
+    void (*bounds)(const RectColumns* rects, RectEdges* edges);
+} RectBatchKernels;
+
+static void clear_mask(uint64_t* mask, size_t count) {
+    memset(mask, 0, RECT_BATCH_WORDS(count) * sizeof(uint64_t));
+}
+
+// Vector kernels produce 4 or 8 bits at a time from an index that is a
+// multiple of that, so a group never straddles two words.
+static inline void set_bits(uint64_t* mask, size_t i, unsigned bits) {
+    mask[i / 64] |= (uint64_t)bits << (i % 64);
+}
+
+// The scalar kernels double as the tails of the vector ones, starting at
+// index from.
+
+static void intersects_from(const RectColumns* c, Rect r, uint64_t* mask, size_t from) {
+    for (size_t i = from; i < c->count; i++) {
+        if (rect_intersects_rect(rect_columns_get(c, i), r)) set_bits(mask, i, 1);
+    }
+}
+
+static void contains_point_from(const RectColumns* c, float px, float py, uint64_t* mask, size_t from) {
+    for (size_t i = from; i < c->count; i++) {
+        if (rect_contains_point(rect_columns_get(c, i), px, py)) set_bits(mask, i, 1);
+    }
+}
+
+static void intersection_from(const RectColumns* c, Rect r, RectColumns* out, size_t from) {
+    for (size_t i = from; i < c->count; i++) {
+        rect_columns_set(out, i, rect_intersection(rect_columns_get(c, i), r));
+    }
+}
+
+static void area_from(const RectColumns* c, float* out, size_t from) {
+    for (size_t i = from; i < c->count; i++) out[i] = c->width[i] * c->height[i];
+}
+
+static void bounds_from(const RectColumns* c, RectEdges* e, size_t from) {
+    for (size_t i = from; i < c->count; i++) {
+        float x1 = c->x[i] + c->width[i], y1 = c->y[i] + c->height[i];
+        if (c->x[i] < e->x0) e->x0 = c->x[i];
+        if (c->y[i] < e->y0) e->y0 = c->y[i];
+        if (x1 > e->x1) e->x1 = x1;
+        if (y1 > e->y1) e->y1 = y1;
+    }
+}
+
+static void intersects_scalar(const RectColumns* c, Rect r, uint64_t* mask) {
+    intersects_from(c, r, mask, 0);
+}
+
+static void contains_point_scalar(const RectColumns* c, float px, float py, uint64_t* mask) {
+    contains_point_from(c, px, py, mask, 0);
+}
+
+static void intersection_scalar(const RectColumns* c, Rect r, RectColumns* out) {
+    intersection_from(c, r, out, 0);
+}
+
+static void area_scalar(const RectColumns* c, float* out) {
+    area_from(c, out, 0);
+}
+
+static void bounds_scalar(const RectColumns* c, RectEdges* e) {
+    bounds_from(c, e, 0);
+}
+
+#ifdef RECT_BATCH_X86
+
+// Comparisons are the ordered kind, false on NaN like the C operators, and
+// max/min return their second operand unless the first compares greater
+// (less), exactly the ternaries in rect.h.
+
+__attribute__((target("sse2")))
+static void intersects_sse2(const RectColumns* c, Rect r, uint64_t* mask) {
+    __m128 left = _mm_set1_ps(r.x), top = _mm_set1_ps(r.y);
+    __m128 right = _mm_set1_ps(r.x + r.width), bottom = _mm_set1_ps(r.y + r.height);
+    size_t i = 0;
+    for (; i + 4 <= c->count; i += 4) {
+        __m128 x = _mm_loadu_ps(c->x + i), y = _mm_loadu_ps(c->y + i);
+        __m128 x1 = _mm_add_ps(x, _mm_loadu_ps(c->width + i));
+        __m128 y1 = _mm_add_ps(y, _mm_loadu_ps(c->height + i));
+        __m128 apart = _mm_or_ps(_mm_or_ps(_mm_cmple_ps(x1, left), _mm_cmple_ps(right, x)),
+                                 _mm_or_ps(_mm_cmple_ps(y1, top), _mm_cmple_ps(bottom, y)));
+        set_bits(mask, i, ~(unsigned)_mm_movemask_ps(apart) & 0xFu);
+    }
+    intersects_from(c, r, mask, i);
+}
+
+__attribute__((target("sse2")))
+static void contains_point_sse2(const RectColumns* c, float px, float py, uint64_t* mask) {
+    __m128 vx = _mm_set1_ps(px), vy = _mm_set1_ps(py);
+    size_t i = 0;
+    for (; i + 4 <= c->count; i += 4) {
+        __m128 x = _mm_loadu_ps(c->x + i), y = _mm_loadu_ps(c->y + i);
+        __m128 x1 = _mm_add_ps(x, _mm_loadu_ps(c->width + i));
+        __m128 y1 = _mm_add_ps(y, _mm_loadu_ps(c->height + i));
+        __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(vx, x), _mm_cmplt_ps(vx, x1)),
+                               _mm_and_ps(_mm_cmpge_ps(vy, y), _mm_cmplt_ps(vy, y1)));
+        set_bits(mask, i, (unsigned)_mm_movemask_ps(in));
+    }
+    contains_point_from(c, px, py, mask, i);
+}
+
+__attribute__((target("sse2")))
+static void intersection_sse2(const RectColumns* c, Rect r, RectColumns* out) {
+    __m128 left = _mm_set1_ps(r.x), top = _mm_set1_ps(r.y);
+    __m128 right = _mm_set1_ps(r.x + r.width), bottom = _mm_set1_ps(r.y + r.height);
+    size_t i = 0;
+    for (; i + 4 <= c->count; i += 4) {
+        __m128 x = _mm_loadu_ps(c->x + i), y = _mm_loadu_ps(c->y + i);
+        __m128 x1 = _mm_min_ps(_mm_add_ps(x, _mm_loadu_ps(c->width + i)), right);
+        __m128 y1 = _mm_min_ps(_mm_add_ps(y, _mm_loadu_ps(c->height + i)), bottom);
+        x = _mm_max_ps(x, left);
+        y = _mm_max_ps(y, top);
+        _mm_storeu_ps(out->x + i, x);
+        _mm_storeu_ps(out->y + i, y);
+        _mm_storeu_ps(out->width + i, _mm_sub_ps(x1, x));
+        _mm_storeu_ps(out->height + i, _mm_sub_ps(y1, y));
+    }
+    intersection_from(c, r, out, i);
+}
+
+__attribute__((target("sse2")))
+static void area_sse2(const RectColumns* c, float* out) {
+    size_t i = 0;
+    for (; i + 4 <= c->count; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(c->width + i), _mm_loadu_ps(c->height + i)));
+    }
+    area_from(c, out, i);
+}
+
+__attribute__((target("sse2")))
+static void bounds_sse2(const RectColumns* c, RectEdges* e) {
+    __m128 x0 = _mm_set1_ps(e->x0), y0 = _mm_set1_ps(e->y0);
+    __m128 x1 = _mm_set1_ps(e->x1), y1 = _mm_set1_ps(e->y1);
+    size_t i = 0;
+    for (; i + 4 <= c->count; i += 4) {
+        __m128 x = _mm_loadu_ps(c->x + i), y = _mm_loadu_ps(c->y + i);
+        x0 = _mm_min_ps(x0, x);
+        y0 = _mm_min_ps(y0, y);
+        x1 = _mm_max_ps(x1, _mm_add_ps(x, _mm_loadu_ps(c->width + i)));
+        y1 = _mm_max_ps(y1, _mm_add_ps(y, _mm_loadu_ps(c->height + i)));
+    }
+    float lanes[4][4];
+    _mm_storeu_ps(lanes[0], x0);
+    _mm_storeu_ps(lanes[1], y0);
+    _mm_storeu_ps(lanes[2], x1);
+    _mm_storeu_ps(lanes[3], y1);
+    for (int k = 0; k < 4; k++) {
+        if (lanes[0][k] < e->x0) e->x0 = lanes[0][k];
+        if (lanes[1][k] < e->y0) e->y0 = lanes[1][k];
+        if (lanes[2][k] > e->x1) e->x1 = lanes[2][k];
+        if (lanes[3][k] > e->y1) e->y1 = lanes[3][k];
+    }
+    bounds_from(c, e, i);
+}
+
+__attribute__((target("avx2")))
+static void intersects_avx2(const RectColumns* c, Rect r, uint64_t* mask) {
+    __m256 left = _mm256_set1_ps(r.x), top = _mm256_set1_ps(r.y);
+    __m256 right = _mm256_set1_ps(r.x + r.width), bottom = _mm256_set1_ps(r.y + r.height);
+    size_t i = 0;
+    for (; i + 8 <= c->count; i += 8) {
+        __m256 x = _mm256_loadu_ps(c->x + i), y = _mm256_loadu_ps(c->y + i);
+        __m256 x1 = _mm256_add_ps(x, _mm256_loadu_ps(c->width + i));
+        __m256 y1 = _mm256_add_ps(y, _mm256_loadu_ps(c->height + i));
+        __m256 apart = _mm256_or_ps(
+            _mm256_or_ps(_mm256_cmp_ps(x1, left, _CMP_LE_OQ), _mm256_cmp_ps(right, x, _CMP_LE_OQ)),
+            _mm256_or_ps(_mm256_cmp_ps(y1, top, _CMP_LE_OQ), _mm256_cmp_ps(bottom, y, _CMP_LE_OQ)));
+        set_bits(mask, i, ~(unsigned)_mm256_movemask_ps(apart) & 0xFFu);
+    }
+    _mm256_zeroupper();
+    intersects_from(c, r, mask, i);
+}
+
+__attribute__((target("avx2")))
+static void contains_point_avx2(const RectColumns* c, float px, float py, uint64_t* mask) {
+    __m256 vx = _mm256_set1_ps(px), vy = _mm256_set1_ps(py);
+    size_t i = 0;
+    for (; i + 8 <= c->count; i += 8) {
+        __m256 x = _mm256_loadu_ps(c->x + i), y = _mm256_loadu_ps(c->y + i);
+        __m256 x1 = _mm256_add_ps(x, _mm256_loadu_ps(c->width + i));
+        __m256 y1 = _mm256_add_ps(y, _mm256_loadu_ps(c->height + i));
+        __m256 in = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(vx, x, _CMP_GE_OQ), _mm256_cmp_ps(vx, x1, _CMP_LT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(vy, y, _CMP_GE_OQ), _mm256_cmp_ps(vy, y1, _CMP_LT_OQ)));
+        set_bits(mask, i, (unsigned)_mm256_movemask_ps(in));
+    }
+    _mm256_zeroupper();
+    contains_point_from(c, px, py, mask, i);
+}
+
+__attribute__((target("avx2")))
+static void intersection_avx2(const RectColumns* c, Rect r, RectColumns* out) {
+    __m256 left = _mm256_set1_ps(r.x), top = _mm256_set1_ps(r.y);
+    __m256 right = _mm256_set1_ps(r.x + r.width), bottom = _mm256_set1_ps(r.y + r.height);
+    size_t i = 0;
+    for (; i + 8 <= c->count; i += 8) {
+        __m256 x = _mm256_loadu_ps(c->x + i), y = _mm256_loadu_ps(c->y + i);
+        __m256 x1 = _mm256_min_ps(_mm256_add_ps(x, _mm256_loadu_ps(c->width + i)), right);
+        __m256 y1 = _mm256_min_ps(_mm256_add_ps(y, _mm256_loadu_ps(c->height + i)), bottom);
+        x = _mm256_max_ps(x, left);
+        y = _mm256_max_ps(y, top);
+        _mm256_storeu_ps(out->x + i, x);
+        _mm256_storeu_ps(out->y + i, y);
+        _mm256_storeu_ps(out->width + i, _mm256_sub_ps(x1, x));
+        _mm256_storeu_ps(out->height + i, _mm256_sub_ps(y1, y));
+    }
+    _mm256_zeroupper();
+    intersection_from(c, r, out, i);
+}
+
+__attribute__((target("avx2")))
+static void area_avx2(const RectColumns* c, float* out) {
+    size_t i = 0;
+    for (; i + 8 <= c->count; i += 8) {
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(c->width + i),
+                                                _mm256_loadu_ps(c->height + i)));
+    }
+    _mm256_zeroupper();
+    area_from(c, out, i);
+}
+
+__attribute__((target("avx2")))
+static void bounds_avx2(const RectColumns* c, RectEdges* e) {
+    __m256 x0 = _mm256_set1_ps(e->x0), y0 = _mm256_set1_ps(e->y0);
+    __m256 x1 = _mm256_set1_ps(e->x1), y1 = _mm256_set1_ps(e->y1);
+    size_t i = 0;
+    for (; i + 8 <= c->count; i += 8) {
+        __m256 x = _mm256_loadu_ps(c->x + i), y = _mm256_loadu_ps(c->y + i);
+        x0 = _mm256_min_ps(x0, x);
+        y0 = _mm256_min_ps(y0, y);
+        x1 = _mm256_max_ps(x1, _mm256_add_ps(x, _mm256_loadu_ps(c->width + i)));
+        y1 = _mm256_max_ps(y1, _mm256_add_ps(y, _mm256_loadu_ps(c->height + i)));
+    }
+    float lanes[4][8];
+    _mm256_storeu_ps(lanes[0], x0);
+    _mm256_storeu_ps(lanes[1], y0);
+    _mm256_storeu_ps(lanes[2], x1);
+    _mm256_storeu_ps(lanes[3], y1);
+    _mm256_zeroupper();
+    for (int k = 0; k < 8; k++) {
+        if (lanes[0][k] < e->x0) e->x0 = lanes[0][k];
+        if (lanes[1][k] < e->y0) e->y0 = lanes[1][k];
+        if (lanes[2][k] > e->x1) e->x1 = lanes[2][k];
+        if (lanes[3][k] > e->y1) e->y1 = lanes[3][k];
+    }
+    bounds_from(c, e, i);
+}
+
+#endif // RECT_BATCH_X86
+
+static const RectBatchKernels rect_batch_table[SPAN_KERNEL_COUNT] = {
+    {intersects_scalar, contains_point_scalar, intersection_scalar, area_scalar, bounds_scalar},
+#ifdef RECT_BATCH_X86
+    {intersects_sse2, contains_point_sse2, intersection_sse2, area_sse2, bounds_sse2},
+    {intersects_avx2, contains_point_avx2, intersection_avx2, area_avx2, bounds_avx2},
+#endif
+};
+
+static SpanKernel rect_batch_kernel = SPAN_KERNEL_SCALAR;
+static const RectBatchKernels* rect_batch_impl = &rect_batch_table[SPAN_KERNEL_SCALAR];
+
+// Runs before main so the kernel pointer never changes under worker threads.
+__attribute__((constructor))
+static void rect_batch_select_kernel(void) {
+#ifdef RECT_BATCH_X86
+    __builtin_cpu_init();
+#endif
+    for (int k = SPAN_KERNEL_COUNT - 1; k >= 0; k--) {
+        if (rect_batch_set_kernel((SpanKernel)k)) {
+            break;
+        }
+    }
+}
+
+void rect_batch_intersects(const RectColumns* rects, Rect r, uint64_t* mask) {
+    clear_mask(mask, rects->count);
+    rect_batch_impl->intersects(rects, r, mask);
+}
+
+void rect_batch_contains_point(const RectColumns* rects, float px, float py, uint64_t* mask) {
+    clear_mask(mask, rects->count);
+    rect_batch_impl->contains_point(rects, px, py, mask);
+}
+
+void rect_batch_intersection(const RectColumns* rects, Rect r, RectColumns* out) {
+    rect_batch_impl->intersection(rects, r, out);
+    out->count = rects->count;
+}
+
+void rect_batch_area(const RectColumns* rects, float* out) {
+    rect_batch_impl->area(rects, out);
+}
+
+Rect rect_batch_union(const RectColumns* rects) {
+    if (rects->count == 0) return rect_make(0, 0, 0, 0);
+    RectEdges e = {
+        rects->x[0], rects->y[0], rects->x[0] + rects->width[0], rects->y[0] + rects->height[0]
+    };
+    rect_batch_impl->bounds(rects, &e);
+    return rect_make(e.x0, e.y0, e.x1 - e.x0, e.y1 - e.y0);
+}
+
+size_t rect_batch_select(const uint64_t* mask, size_t count, uint32_t* indices) {
+    size_t found = 0;
+    for (size_t w = 0; w < RECT_BATCH_WORDS(count); w++) {
+        uint64_t bits = mask[w];
+        if (w == count / 64) bits &= (UINT64_C(1) << (count % 64)) - 1;
+        while (bits) {
+            indices[found++] = (uint32_t)(w * 64 + (size_t)__builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    return found;
+}
+
+SpanKernel rect_batch_get_kernel(void) {
+    return rect_batch_kernel;
+}
+
+bool rect_batch_set_kernel(SpanKernel kernel) {
+    if (kernel < 0 || kernel >= SPAN_KERNEL_COUNT || !span_kernel_supported(kernel)) {
+        return false;
+    }
+    rect_batch_kernel = kernel;
+    rect_batch_impl = &rect_batch_table[kernel];
+    return true;
+}
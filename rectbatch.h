@@ -0,0 +1,57 @@
+#ifndef RECTBATCH_H
+#define RECTBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "rect.h"
+#include "span.h"
+
+// rect.h operations over many rects at once, for culling and damage
+// tracking. Rects are stored as columns (all x, then all y, ...) so the
+// kernels load several at a time. Results agree exactly with the rect.h
+// functions, rect for rect. Like the span kernels, the best kernel set is
+// picked at startup and all of them give identical results.
+typedef struct {
+    float* x;
+    float* y;
+    float* width;
+    float* height;
+    size_t count;
+} RectColumns;
+
+// Per-rect yes/no results are bitmasks: rect i is bit i % 64 of word
+// i / 64. Bits past count in the last word are cleared.
+#define RECT_BATCH_WORDS(count) (((count) + 63) / 64)
+
+static inline Rect rect_columns_get(const RectColumns* c, size_t i) {
+    return rect_make(c->x[i], c->y[i], c->width[i], c->height[i]);
+}
+
+static inline void rect_columns_set(RectColumns* c, size_t i, Rect r) {
+    c->x[i] = r.x;
+    c->y[i] = r.y;
+    c->width[i] = r.width;
+    c->height[i] = r.height;
+}
+
+// rect_intersects_rect(rects[i], r) for every i.
+void rect_batch_intersects(const RectColumns* rects, Rect r, uint64_t* mask);
+// rect_contains_point(rects[i], px, py) for every i.
+void rect_batch_contains_point(const RectColumns* rects, float px, float py, uint64_t* mask);
+// out[i] = rect_intersection(rects[i], r); out needs rects->count slots
+// and may be rects itself.
+void rect_batch_intersection(const RectColumns* rects, Rect r, RectColumns* out);
+// out[i] = rect_area(rects[i]).
+void rect_batch_area(const RectColumns* rects, float* out);
+// Smallest rect holding every rect, computed from the edges in one pass
+// rather than by chaining rect_union; empty for no rects.
+Rect rect_batch_union(const RectColumns* rects);
+
+// Writes the index of every set bit below count to indices, in order, and
+// returns how many there were.
+size_t rect_batch_select(const uint64_t* mask, size_t count, uint32_t* indices);
+
+SpanKernel rect_batch_get_kernel(void);
+bool rect_batch_set_kernel(SpanKernel kernel);
+
+#endif // RECTBATCH_H
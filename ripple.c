@@ -1,33 +1,89 @@
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <math.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "canvas.h"
+#include "terminal.h"
+#include "threadpool.h"
+#include "wave.h"
 
-#define MAX_RIPPLES 50
 #define CANVAS_WIDTH 80
 #define CANVAS_HEIGHT 24
+// Instruction lines above the grid.
+#define HEADER_ROWS 2
+// Ripples fade through this many grays as they grow.
+#define RIPPLE_SHADES 8
+// The simulation advances in fixed steps, and frames follow the same clock.
+#define STEPS_PER_SECOND 60
+// Ripples grow a cell every this many steps: ten cells a second.
+#define STEPS_PER_CELL 6
+// After a stall, steps beyond this many are dropped rather than caught up.
+#define MAX_CATCH_UP_STEPS 5
+// Wave mode: glyphs from calm to steep, each level a palette color for
+// crests and another for troughs after the ripple grays.
+#define WAVE_LEVELS 8
+#define WAVE_CREST_COLOR RIPPLE_SHADES
+#define WAVE_TROUGH_COLOR (RIPPLE_SHADES + WAVE_LEVELS)
+// Heights drawn with the steepest glyph.
+#define WAVE_FULL_HEIGHT 0.5f
+#define WAVE_DAMPING 0.99f
+#define WAVE_SPLASH_RADIUS 3
+#define WAVE_SPLASH_HEIGHT 1.0f
 
+// Ripples live in a ring buffer of parallel arrays. New ones go in at the
+// tail, and when the ring is full the oldest is dropped, so both are O(1).
+// Expired ripples are squeezed out as each step walks the ring.
 typedef struct {
-    int x, y;
-    int radius;
-    int max_radius;
-    char symbol;
-    int active;
-    int delay;
-} Ripple;
+    int capacity;           // a power of two
+    int head;               // slot of the oldest ripple
+    int count;
+    int32_t* x;
+    int32_t* y;
+    int16_t* radius;
+    int16_t* max_radius;
+    int16_t* delay;         // steps until the next cell of growth
+    uint8_t* glyph;
+} RipplePool;
+
+#define DEFAULT_RIPPLE_CAPACITY (1 << 16)
+#define MAX_RIPPLE_CAPACITY (1 << 24)
+// Rain mode drops a ripple per step for every this many cells.
+#define RAIN_CELLS_PER_DROP 1500
+
+RipplePool ripples = {0};
+int rain_mode = 0;
+
+TermScreen* screen = NULL;
 
-Ripple ripples[MAX_RIPPLES];
-int ripple_count = 0;
+// Wave mode replaces the rings with a height field where splashes
+// interfere and reflect off the edges.
+int wave_mode = 0;
+WaveField* waves = NULL;
+ThreadPool* pool = NULL;
+
+// Ripple symbols take the glyph ids after ASCII, in this order. Repeats
+// make a symbol likelier.
+#define RIPPLE_GLYPH 128
+static const char* const symbols[] = {"◦", "◯", "○", "◌", "◍", "●", "◉", "◎", "◉", "◯"};
+static const int symbol_count = sizeof(symbols) / sizeof(symbols[0]);
+
+static const uint8_t wave_glyphs[WAVE_LEVELS] = {' ', '.', ':', '-', '=', '+', '*', '#'};
 
 void clear_screen() {
     printf("\033[2J\033[H");
 }
 
-void reset_cursor() {
-    printf("\033[H");
-}
-
 void hide_cursor() {
     printf("\033[?25l");
 }
@@ -44,158 +100,598 @@ void reset_color() {
     printf("\033[0m");
 }
 
-void draw_canvas() {
-    char canvas[CANVAS_HEIGHT][CANVAS_WIDTH];
-    memset(canvas, ' ', sizeof(canvas));
-
-    for (int i = 0; i < ripple_count; i++) {
-        if (!ripples[i].active) continue;
-        
-        int center_x = ripples[i].x;
-        int center_y = ripples[i].y;
-        int radius = ripples[i].radius;
-        
-        for (int y = 0; y < CANVAS_HEIGHT; y++) {
-            for (int x = 0; x < CANVAS_WIDTH; x++) {
-                int dx = x - center_x;
-                int dy = y - center_y;
-                int distance = dx * dx + dy * dy;
-                
-                if (distance >= (radius - 1) * (radius - 1) && 
-                    distance <= (radius + 1) * (radius + 1)) {
-                    if (y >= 0 && y < CANVAS_HEIGHT && x >= 0 && x < CANVAS_WIDTH) {
-                        canvas[y][x] = ripples[i].symbol;
-                    }
-                }
-            }
-        }
+int screen_init(int width, int height, int top) {
+    screen = term_screen_create(width, height, top, 1);
+    if (!screen) return 0;
+    for (int i = 0; i < RIPPLE_SHADES; i++) {
+        int gray = 235 - i * 20;
+        term_screen_set_color(screen, i, gray, gray, gray);
     }
+    // Crests go from sea blue to foam, troughs darken to navy.
+    for (int i = 0; i < WAVE_LEVELS; i++) {
+        int t = i * 255 / (WAVE_LEVELS - 1);
+        term_screen_set_color(screen, WAVE_CREST_COLOR + i, 40 + t * 215 / 255, 120 + t * 135 / 255, 200 + t * 55 / 255);
+        term_screen_set_color(screen, WAVE_TROUGH_COLOR + i, 30, 60 - t * 40 / 255, 160 - t * 90 / 255);
+    }
+    for (int i = 0; i < symbol_count; i++) {
+        term_screen_set_glyph(screen, RIPPLE_GLYPH + i, symbols[i]);
+    }
+    return 1;
+}
+
+// Largest r with r * r <= n.
+static int isqrt(long n) {
+    if (n <= 0) return 0;
+    long r = (long)sqrt((double)n);
+    while (r * r > n) r--;
+    while ((r + 1) * (r + 1) <= n) r++;
+    return (int)r;
+}
+
+static void fill_cells(TermFrame* f, int y, int x0, int x1, uint8_t glyph, int shade) {
+    if (x0 < 0) x0 = 0;
+    if (x1 > f->width - 1) x1 = f->width - 1;
+    if (x0 > x1) return;
+    size_t start = (size_t)y * f->width + x0;
+    memset(f->glyphs + start, glyph, (size_t)(x1 - x0 + 1));
+    memset(f->colors + start, shade, (size_t)(x1 - x0 + 1));
+}
 
-    reset_cursor();
-    
-    for (int y = 0; y < CANVAS_HEIGHT; y++) {
-        for (int x = 0; x < CANVAS_WIDTH; x++) {
-            set_color(200, 200, 200);
-            putchar(canvas[y][x]);
-            reset_color();
+// Marks the cells whose squared distance from (cx, cy) lies within
+// [(radius - 1)^2, (radius + 1)^2]. Only rows the ring crosses are
+// visited, and each of them is at most two spans.
+void draw_ring(TermFrame* f, int cx, int cy, int radius, int max_radius, uint8_t glyph) {
+    long outer2 = (long)(radius + 1) * (radius + 1);
+    long inner2 = (long)(radius - 1) * (radius - 1);
+    int reach = radius + 1;
+    int y0 = cy - reach < 0 ? 0 : cy - reach;
+    int y1 = cy + reach > f->height - 1 ? f->height - 1 : cy + reach;
+    int shade = radius * RIPPLE_SHADES / (max_radius + 1);
+
+    for (int y = y0; y <= y1; y++) {
+        long dy2 = (long)(y - cy) * (y - cy);
+        int half = isqrt(outer2 - dy2);
+        // Smallest |dx| still outside the inner circle.
+        int gap = 0;
+        if (inner2 > dy2) {
+            gap = isqrt(inner2 - dy2 - 1) + 1;
+        }
+        if (gap > half) continue;
+        if (gap == 0) {
+            fill_cells(f, y, cx - half, cx + half, glyph, shade);
+        } else {
+            fill_cells(f, y, cx - half, cx - gap, glyph, shade);
+            fill_cells(f, y, cx + gap, cx + half, glyph, shade);
         }
-        putchar('\n');
     }
 }
 
-void add_ripple(int x, int y, char symbol) {
-    if (ripple_count >= MAX_RIPPLES) {
-        for (int i = 0; i < MAX_RIPPLES - 1; i++) {
-            ripples[i] = ripples[i + 1];
-        }
-        ripple_count--;
+void render_ripples(TermFrame* f) {
+    const RipplePool* p = &ripples;
+    memset(f->glyphs, TERM_BLANK, (size_t)f->width * f->height);
+    for (int i = 0; i < p->count; i++) {
+        int slot = (p->head + i) & (p->capacity - 1);
+        draw_ring(f, p->x[slot], p->y[slot], p->radius[slot], p->max_radius[slot], p->glyph[slot]);
     }
-    
-    ripples[ripple_count].x = x;
-    ripples[ripple_count].y = y;
-    ripples[ripple_count].radius = 0;
-    ripples[ripple_count].max_radius = rand() % 10 + 5;
-    ripples[ripple_count].symbol = symbol;
-    ripples[ripple_count].active = 1;
-    ripples[ripple_count].delay = 0;
-    ripple_count++;
 }
 
-void update_ripples() {
-    for (int i = 0; i < ripple_count; i++) {
-        if (!ripples[i].active) continue;
-        
-        if (ripples[i].delay > 0) {
-            ripples[i].delay--;
-            continue;
-        }
-        
-        ripples[i].radius++;
-        
-        if (ripples[i].radius > ripples[i].max_radius) {
-            ripples[i].active = 0;
+void render_waves(TermFrame* f) {
+    float gain = (WAVE_LEVELS - 1) / WAVE_FULL_HEIGHT;
+    for (int y = 0; y < f->height; y++) {
+        const float* heights = wave_field_row(waves, y);
+        uint8_t* glyphs = f->glyphs + (size_t)y * f->width;
+        uint8_t* colors = f->colors + (size_t)y * f->width;
+        for (int x = 0; x < f->width; x++) {
+            float h = heights[x];
+            float steep = (h < 0.0f ? -h : h) * gain;
+            int level = steep < WAVE_LEVELS - 1 ? (int)steep : WAVE_LEVELS - 1;
+            glyphs[x] = wave_glyphs[level];
+            colors[x] = (uint8_t)((h < 0.0f ? WAVE_TROUGH_COLOR : WAVE_CREST_COLOR) + level);
         }
     }
-    
-    int active_count = 0;
-    for (int i = 0; i < ripple_count; i++) {
-        if (ripples[i].active) {
-            ripples[active_count++] = ripples[i];
-        }
+}
+
+// Sends only the cells that changed since the last frame.
+void draw_canvas() {
+    TermFrame* f = term_screen_frame(screen);
+    if (wave_mode) {
+        render_waves(f);
+    } else {
+        render_ripples(f);
     }
-    ripple_count = active_count;
+    term_screen_present(screen, STDOUT_FILENO);
+}
+
+void ripple_pool_free(RipplePool* p) {
+    free(p->x);
+    free(p->y);
+    free(p->radius);
+    free(p->max_radius);
+    free(p->delay);
+    free(p->glyph);
+    memset(p, 0, sizeof(*p));
+}
+
+uint8_t random_glyph() {
+    return (uint8_t)(RIPPLE_GLYPH + rand() % symbol_count);
+}
+
+// Rounds capacity up to a power of two, at most MAX_RIPPLE_CAPACITY.
+int ripple_pool_init(RipplePool* p, int capacity) {
+    int rounded = 1;
+    while (rounded < capacity && rounded < MAX_RIPPLE_CAPACITY) rounded *= 2;
+    RipplePool next = {rounded, 0, 0,
+                       malloc((size_t)rounded * sizeof(int32_t)), malloc((size_t)rounded * sizeof(int32_t)),
+                       malloc((size_t)rounded * sizeof(int16_t)), malloc((size_t)rounded * sizeof(int16_t)),
+                       malloc((size_t)rounded * sizeof(int16_t)), malloc((size_t)rounded)};
+    if (!next.x || !next.y || !next.radius || !next.max_radius || !next.delay || !next.glyph) {
+        ripple_pool_free(&next);
+        return 0;
+    }
+    ripple_pool_free(p);
+    *p = next;
+    return 1;
+}
+
+void ripple_pool_clear(RipplePool* p) {
+    p->head = 0;
+    p->count = 0;
+}
+
+void add_ripple(int x, int y, uint8_t glyph) {
+    RipplePool* p = &ripples;
+    if (p->count == p->capacity) {
+        p->head = (p->head + 1) & (p->capacity - 1);
+        p->count--;
+    }
+    int slot = (p->head + p->count) & (p->capacity - 1);
+    p->x[slot] = x;
+    p->y[slot] = y;
+    p->radius[slot] = 0;
+    p->max_radius[slot] = (int16_t)(rand() % 10 + 5);
+    p->delay[slot] = 0;
+    p->glyph[slot] = glyph;
+    p->count++;
+}
+
+// Grows every ripple and packs the survivors towards the head in the same
+// pass. Nothing branches on a ripple's state: each one is copied to the
+// next free slot, which only advances past it if it is still alive.
+void update_ripples() {
+    RipplePool* p = &ripples;
+    int mask = p->capacity - 1, kept = 0;
+    for (int i = 0; i < p->count; i++) {
+        int from = (p->head + i) & mask, to = (p->head + kept) & mask;
+        int grow = p->delay[from] == 0;
+        int radius = p->radius[from] + grow;
+        p->x[to] = p->x[from];
+        p->y[to] = p->y[from];
+        p->radius[to] = (int16_t)radius;
+        p->max_radius[to] = p->max_radius[from];
+        p->delay[to] = (int16_t)(p->delay[from] - 1 + grow * STEPS_PER_CELL);
+        p->glyph[to] = p->glyph[from];
+        kept += radius <= p->max_radius[from];
+    }
+    p->count = kept;
 }
 
 void print_instructions() {
     printf("\033[1;1H");
     set_color(180, 180, 180);
     printf("Terminal Ripple Animation - Click anywhere or press keys to create ripples\n");
-    printf("Press 'q' to quit, 'c' to clear, 'r' for random ripples\n");
+    printf("Press 'q' to quit, 'c' to clear, 'r' for random ripples, 'n' for rain, 'w' for waves\n");
     reset_color();
 }
 
-int kbhit() {
-    int ch = getchar();
-    if (ch != EOF) {
-        ungetc(ch, stdin);
-        return 1;
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Simulates and renders without a terminal, keeping about `target`
+// ripples alive, and reports the time and output bytes per frame. For
+// sizing grids and ripple counts beyond what fits on screen; the pool
+// capacity caps the count.
+int run_headless(int width, int height, int target, int frames) {
+    if (!screen_init(width, height, 1)) return 1;
+    TermFrame* frame = term_screen_frame(screen);
+    double start = now_seconds();
+    long alive = 0, bytes = 0;
+    for (int f = 0; f < frames; f++) {
+        while (ripples.count < target && ripples.count < ripples.capacity) {
+            add_ripple(rand() % width, rand() % height, random_glyph());
+        }
+        render_ripples(frame);
+        bytes += term_screen_present(screen, -1);
+        alive += ripples.count;
+        update_ripples();
     }
+    double seconds = now_seconds() - start;
+    // Every cell wrapped in a color and a reset, as frames used to be sent.
+    long redraw = (long)width * height * (int)(sizeof("\033[38;2;200;200;200m◦\033[0m") - 1) + height;
+    printf("%dx%d grid, %ld ripples on average: %.3f ms per frame\n", width, height,
+           frames ? alive / frames : 0, frames ? seconds / frames * 1e3 : 0.0);
+    printf("%ld bytes per frame, against %ld redrawing every cell\n", frames ? bytes / frames : 0, redraw);
+    term_screen_destroy(screen);
     return 0;
 }
 
-char getch_nonblock() {
-    char ch;
-    system("stty raw -echo");
-    ch = getchar();
-    system("stty cooked echo");
-    return ch;
+// Rain without drawing: `drops` new ripples every step into a full pool,
+// so each step evicts as many as it adds. Reports the cost of adding and
+// stepping per ripple.
+int run_headless_rain(int width, int height, int drops, int steps) {
+    double start = now_seconds();
+    long alive = 0, evicted = 0;
+    for (int s = 0; s < steps; s++) {
+        for (int i = 0; i < drops; i++) {
+            evicted += ripples.count == ripples.capacity;
+            add_ripple(rand() % width, rand() % height, random_glyph());
+        }
+        update_ripples();
+        alive += ripples.count;
+    }
+    double seconds = now_seconds() - start;
+    printf("%d drops a step into %d slots, %ld ripples on average, %ld evicted\n", drops, ripples.capacity,
+           steps ? alive / steps : 0, evicted);
+    printf("%.3f ms per step, %.2f ns per ripple\n", steps ? seconds / steps * 1e3 : 0.0,
+           alive + (long)drops * steps ? seconds / (alive + (double)drops * steps) * 1e9 : 0.0);
+    return 0;
 }
 
-int main() {
-    srand(time(NULL));
-    
+// Drops per step in rain mode, more on bigger grids.
+int rain_drops() {
+    TermFrame* f = term_screen_frame(screen);
+    int drops = f->width * f->height / RAIN_CELLS_PER_DROP;
+    return drops > 0 ? drops : 1;
+}
+
+// A ripple, or in wave mode a splash, centred on cell (x, y) of the grid.
+void splash_at(int x, int y) {
+    if (wave_mode) {
+        wave_field_impulse(waves, x, y, WAVE_SPLASH_RADIUS, WAVE_SPLASH_HEIGHT);
+    } else {
+        add_ripple(x, y, random_glyph());
+    }
+}
+
+void add_random_ripple() {
+    TermFrame* f = term_screen_frame(screen);
+    splash_at(rand() % f->width, rand() % f->height);
+}
+
+void step_simulation() {
+    if (rain_mode) {
+        for (int i = rain_drops(); i > 0; i--) {
+            add_random_ripple();
+        }
+    }
+    if (wave_mode) {
+        wave_field_step(waves, WAVE_DAMPING, pool);
+    } else {
+        update_ripples();
+    }
+}
+
+// The field and pool are made on first use and kept the grid's size.
+int toggle_waves() {
+    TermFrame* f = term_screen_frame(screen);
+    if (!waves && !(waves = wave_field_create(f->width, f->height))) return 0;
+    if (!pool) pool = threadpool_create(0);
+    wave_mode = !wave_mode;
+    wave_field_clear(waves);
+    return 1;
+}
+
+// Returns 0 when the key quits.
+int handle_key(char ch) {
+    if (ch == 'q' || ch == 'Q' || ch == 3) {
+        return 0;
+    } else if (ch == 'c' || ch == 'C') {
+        ripple_pool_clear(&ripples);
+        rain_mode = 0;
+        wave_field_clear(waves);
+    } else if (ch == 'w' || ch == 'W') {
+        toggle_waves();
+    } else if (ch == 'n' || ch == 'N') {
+        rain_mode = !rain_mode;
+    } else if (ch == 'r' || ch == 'R') {
+        for (int i = 0; i < 5; i++) {
+            add_random_ripple();
+        }
+    } else {
+        add_random_ripple();
+    }
+    return 1;
+}
+
+// A button press on the grid splashes where it landed.
+void handle_mouse(const TermMouse* mouse) {
+    TermFrame* f = term_screen_frame(screen);
+    int x = mouse->x - 1, y = mouse->y - 1 - HEADER_ROWS;
+    if (!mouse->press || mouse->button > 2) return;
+    if (x < 0 || y < 0 || x >= f->width || y >= f->height) return;
+    splash_at(x, y);
+}
+
+// Handles the keys and mouse reports in input. Returns how many bytes at
+// its end begin a report whose rest is still to be read.
+size_t handle_input(const char* input, size_t length, int* running) {
+    size_t i = 0;
+    while (i < length && *running) {
+        TermMouse mouse;
+        int n = term_parse_mouse(input + i, length - i, &mouse);
+        if (n < 0) return length - i;
+        if (n > 0) {
+            handle_mouse(&mouse);
+            i += (size_t)n;
+        } else {
+            *running = handle_key(input[i++]);
+        }
+    }
+    return 0;
+}
+
+// Fits the grid to the window below the instructions, and redraws those.
+void fit_window() {
+    int columns = CANVAS_WIDTH, rows = CANVAS_HEIGHT;
+    term_window_size(STDOUT_FILENO, &columns, &rows);
+    if (rows <= HEADER_ROWS) rows = HEADER_ROWS + 1;
+    term_screen_resize(screen, columns, rows - HEADER_ROWS);
+    if (waves && !wave_field_resize(waves, columns, rows - HEADER_ROWS)) {
+        wave_field_destroy(waves);
+        waves = NULL;
+        wave_mode = 0;
+    }
     clear_screen();
-    hide_cursor();
-    
-    char symbols[] = {'◦', '◯', '○', '◌', '◍', '●', '◉', '◎', '◉', '◯'};
-    int symbol_count = sizeof(symbols) / sizeof(symbols[0]);
-    
     print_instructions();
-    
-    while (1) {
-        if (kbhit()) {
-            char ch = getch_nonblock();
-            
-            if (ch == 'q' || ch == 'Q') {
-                break;
-            } else if (ch == 'c' || ch == 'C') {
-                for (int i = 0; i < ripple_count; i++) {
-                    ripples[i].active = 0;
-                }
-                ripple_count = 0;
-            } else if (ch == 'r' || ch == 'R') {
-                for (int i = 0; i < 5; i++) {
-                    int x = rand() % CANVAS_WIDTH;
-                    int y = rand() % CANVAS_HEIGHT;
-                    char symbol = symbols[rand() % symbol_count];
-                    add_ripple(x, y, symbol);
+    fflush(stdout);
+}
+
+typedef struct {
+    long frames;
+    double work_total;      // from wakeup to the frame written
+    double work_max;
+    long late;              // frames whose work overran a step
+    double interval_max;    // between frames on the clock
+    long inputs;
+    double input_total;     // from a key arriving to its frame written
+    double input_max;
+} FrameStats;
+
+void print_stats(const FrameStats* stats, double seconds) {
+    if (stats->frames == 0 || seconds <= 0) return;
+    printf("%ld frames in %.1f s: %.1f fps, longest gap %.2f ms\n", stats->frames, seconds,
+           stats->frames / seconds, stats->interval_max * 1e3);
+    printf("frame work %.3f ms mean, %.3f ms max, %ld over a step\n",
+           stats->work_total / stats->frames * 1e3, stats->work_max * 1e3, stats->late);
+    if (stats->inputs) {
+        printf("key to screen %.3f ms mean, %.3f ms max\n", stats->input_total / stats->inputs * 1e3,
+               stats->input_max * 1e3);
+    }
+}
+
+// One poll over the keyboard and mouse, a timerfd ticking once a step,
+// and a signalfd for resizes and termination. Steps run off the clock
+// however late the timer wakes us, and input is drawn at once rather than
+// on the next tick.
+int run_terminal() {
+    int input_fd = STDIN_FILENO;
+    term_raw_mode(input_fd);
+    term_mouse_reporting(STDOUT_FILENO);
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGWINCH);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    const long step_ns = 1000000000L / STEPS_PER_SECOND;
+    struct itimerspec period = {{0, step_ns}, {0, step_ns}};
+    if (signal_fd < 0 || timer_fd < 0 || timerfd_settime(timer_fd, 0, &period, NULL) != 0) {
+        term_restore();
+        return 1;
+    }
+
+    hide_cursor();
+    fit_window();
+
+    const double step = 1.0 / STEPS_PER_SECOND;
+    FrameStats stats = {0};
+    double start = now_seconds(), last_step = start, lag = 0, last_frame = start;
+    struct pollfd fds[3] = {{input_fd, POLLIN, 0}, {timer_fd, POLLIN, 0}, {signal_fd, POLLIN, 0}};
+    int running = 1;
+    // A mouse report may arrive split across reads; its start waits here.
+    char input[256];
+    size_t pending = 0;
+
+    while (running) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        double woke = now_seconds();
+        int redraw = 0, typed = 0;
+
+        if (fds[2].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+                if (info.ssi_signo == SIGWINCH) {
+                    fit_window();
+                    redraw = 1;
+                } else {
+                    running = 0;
                 }
+            }
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(input_fd, input + pending, sizeof(input) - pending);
+            if (n <= 0) {
+                // End of input: keep animating without a keyboard.
+                fds[0].fd = -1;
             } else {
-                int x = rand() % CANVAS_WIDTH;
-                int y = rand() % CANVAS_HEIGHT;
-                char symbol = symbols[rand() % symbol_count];
-                add_ripple(x, y, symbol);
+                size_t length = pending + (size_t)n;
+                pending = handle_input(input, length, &running);
+                memmove(input, input + length - pending, pending);
+            }
+            redraw = typed = n > 0;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(timer_fd, &expirations, sizeof(expirations)) < 0) expirations = 0;
+            lag += woke - last_step;
+            last_step = woke;
+            int steps = 0;
+            while (lag >= step && steps < MAX_CATCH_UP_STEPS) {
+                step_simulation();
+                lag -= step;
+                steps++;
+            }
+            if (steps == MAX_CATCH_UP_STEPS) lag = 0;
+            redraw = 1;
+        }
+
+        if (redraw && running) {
+            draw_canvas();
+            double done = now_seconds(), work = done - woke;
+            stats.frames++;
+            stats.work_total += work;
+            if (work > stats.work_max) stats.work_max = work;
+            if (work > step) stats.late++;
+            if (done - last_frame > stats.interval_max) stats.interval_max = done - last_frame;
+            last_frame = done;
+            if (typed) {
+                stats.inputs++;
+                stats.input_total += work;
+                if (work > stats.input_max) stats.input_max = work;
             }
         }
-        
-        draw_canvas();
-        update_ripples();
-        
-        usleep(100000);
     }
-    
+
+    close(timer_fd);
+    close(signal_fd);
+    term_restore();
     show_cursor();
     clear_screen();
-    
+    print_stats(&stats, now_seconds() - start);
     return 0;
-}
\ No newline at end of file
+}
+
+// Times wave steps on one thread and on a pool, and mapping the field to
+// glyphs, with a splash every few steps. With a path, also draws the last
+// field into a canvas and saves it, one pixel per cell.
+int run_headless_waves(int width, int height, int steps, const char* snapshot) {
+    if (!screen_init(width, height, 1)) return 1;
+    waves = wave_field_create(width, height);
+    pool = threadpool_create(0);
+    if (!waves || !pool) return 1;
+    TermFrame* frame = term_screen_frame(screen);
+
+    for (int threaded = 0; threaded < 2; threaded++) {
+        wave_field_clear(waves);
+        srand(1);
+        double step_time = 0, render_time = 0;
+        for (int i = 0; i < steps; i++) {
+            if (i % 10 == 0) {
+                wave_field_impulse(waves, rand() % width, rand() % height, WAVE_SPLASH_RADIUS, WAVE_SPLASH_HEIGHT);
+            }
+            double start = now_seconds();
+            wave_field_step(waves, WAVE_DAMPING, threaded ? pool : NULL);
+            double stepped = now_seconds();
+            render_waves(frame);
+            render_time += now_seconds() - stepped;
+            step_time += stepped - start;
+        }
+        printf("%dx%d waves, %d thread%s: %.3f ms per step, %.3f ms per glyph frame\n", width, height,
+               threaded ? threadpool_size(pool) : 1, threaded && threadpool_size(pool) > 1 ? "s" : "",
+               steps ? step_time / steps * 1e3 : 0.0, steps ? render_time / steps * 1e3 : 0.0);
+    }
+
+    int status = 0;
+    if (snapshot) {
+        Canvas* canvas = canvas_create(width, height);
+        status = !canvas || !wave_field_draw(waves, canvas, WAVE_FULL_HEIGHT) ||
+                 !canvas_save_to_ppm(canvas, snapshot);
+        canvas_destroy(canvas);
+    }
+    wave_field_destroy(waves);
+    threadpool_destroy(pool);
+    term_screen_destroy(screen);
+    return status;
+}
+
+int main(int argc, char** argv) {
+    // ripple [--capacity N] [mode...]: the most ripples alive at once,
+    // rounded up to a power of two. Past it the oldest make way.
+    int capacity = DEFAULT_RIPPLE_CAPACITY;
+    if (argc > 2 && strcmp(argv[1], "--capacity") == 0) {
+        capacity = atoi(argv[2]);
+        if (capacity <= 0 || capacity > MAX_RIPPLE_CAPACITY) {
+            fprintf(stderr, "%s: capacity must be from 1 to %d\n", argv[0], MAX_RIPPLE_CAPACITY);
+            return 2;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    if (!ripple_pool_init(&ripples, capacity)) return 1;
+    int status;
+
+    if (argc > 1 && strcmp(argv[1], "--headless-waves") == 0) {
+        // ripple --headless-waves [width height steps [snapshot.ppm]]
+        int width = argc > 2 ? atoi(argv[2]) : 400;
+        int height = argc > 3 ? atoi(argv[3]) : 200;
+        int steps = argc > 4 ? atoi(argv[4]) : 600;
+        if (width <= 0 || height <= 0 || steps < 0) {
+            fprintf(stderr, "usage: %s [--capacity N] --headless-waves [width height steps [snapshot.ppm]]\n", argv[0]);
+            return 2;
+        }
+        status = run_headless_waves(width, height, steps, argc > 5 ? argv[5] : NULL);
+        ripple_pool_free(&ripples);
+        return status;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--headless-rain") == 0) {
+        // ripple --headless-rain [width height drops steps]
+        int width = argc > 2 ? atoi(argv[2]) : 400;
+        int height = argc > 3 ? atoi(argv[3]) : 200;
+        int drops = argc > 4 ? atoi(argv[4]) : 500;
+        int steps = argc > 5 ? atoi(argv[5]) : 600;
+        if (width <= 0 || height <= 0 || drops < 0 || steps < 0) {
+            fprintf(stderr, "usage: %s [--capacity N] --headless-rain [width height drops steps]\n", argv[0]);
+            return 2;
+        }
+        srand(1);
+        status = run_headless_rain(width, height, drops, steps);
+        ripple_pool_free(&ripples);
+        return status;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+        // ripple --headless [width height ripples frames]
+        int width = argc > 2 ? atoi(argv[2]) : 400;
+        int height = argc > 3 ? atoi(argv[3]) : 200;
+        int target = argc > 4 ? atoi(argv[4]) : 5000;
+        int frames = argc > 5 ? atoi(argv[5]) : 200;
+        if (width <= 0 || height <= 0 || target < 0 || frames < 0) {
+            fprintf(stderr, "usage: %s [--capacity N] --headless [width height ripples frames]\n", argv[0]);
+            return 2;
+        }
+        srand(1);
+        status = run_headless(width, height, target, frames);
+        ripple_pool_free(&ripples);
+        return status;
+    }
+
+    srand(time(NULL));
+    if (!screen_init(CANVAS_WIDTH, CANVAS_HEIGHT - HEADER_ROWS, HEADER_ROWS + 1)) return 1;
+    status = run_terminal();
+    term_screen_destroy(screen);
+    wave_field_destroy(waves);
+    threadpool_destroy(pool);
+    ripple_pool_free(&ripples);
+    return status;
+}
@@ -0,0 +1,239 @@
+#define _GNU_SOURCE
+
+#include "scene.h"
+#include "atlas.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Frames each worker may run ahead of the sink; bounds the live canvases.
+#define SCENE_WINDOW_PER_THREAD 2
+
+void scene_draw_frame(const Scene* scene, Canvas* canvas, int frame, int fps) {
+    canvas_set_clear_color(canvas, scene->background);
+    canvas_clear(canvas);
+
+    float t = (float)frame / (float)(fps > 0 ? fps : 1);
+    for (int i = 0; i < scene->emoji_count; i++) {
+        const SceneEmoji* e = &scene->emojis[i];
+        AnimationState anim = e->anim;
+        if (anim.active && anim.duration > 0.0f) {
+            anim.progress += t;
+            if (e->loop) anim.progress = fmodf(anim.progress, anim.duration);
+        }
+        switch (e->kind) {
+        case SCENE_EMOJI_SMILE: canvas_draw_emoji_smile(canvas, e->x, e->y, e->size); break;
+        case SCENE_EMOJI_LEAF: canvas_draw_emoji_leaf(canvas, e->x, e->y, e->size); break;
+        case SCENE_EMOJI_COFFEE: canvas_draw_emoji_coffee(canvas, e->x, e->y, e->size); break;
+        case SCENE_EMOJI_MOON: canvas_draw_emoji_moon(canvas, e->x, e->y, e->size); break;
+        case SCENE_EMOJI_SPARKLE: canvas_draw_emoji_sparkle(canvas, e->x, e->y, e->size); break;
+        case SCENE_EMOJI_BOUNCE: canvas_animate_emoji_bounce(canvas, e->x, e->y, e->size, &anim); break;
+        case SCENE_EMOJI_PULSE: canvas_animate_emoji_pulse(canvas, e->x, e->y, e->size, &anim); break;
+        case SCENE_EMOJI_SPIN: canvas_animate_emoji_spin(canvas, e->x, e->y, e->size, &anim); break;
+        }
+    }
+}
+
+// Frames dealt to one worker, lowest first. Thieves also take the lowest:
+// it is the one the sink will want soonest.
+typedef struct {
+    pthread_mutex_t lock;
+    int* frames;
+    int head;
+    int tail;
+} FrameDeque;
+
+typedef struct {
+    const Scene* scene;
+    int fps;
+    int frame_count;
+    FramePool* pool;
+    FrameDeque* deques;
+    int workers;
+    int window;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    int next_out;           // next frame the sink expects
+    Canvas** done;          // finished frames, slot frame % window
+    bool dealt;             // frames are in the deques and workers may start
+    bool stop;
+    bool failed;
+} SceneJob;
+
+typedef struct {
+    SceneJob* job;
+    int index;
+    EmojiAtlas* atlas;      // private, so blits need no locking
+    pthread_t thread;
+} SceneWorker;
+
+static int take_frame(SceneJob* job, int self) {
+    for (int k = 0; k < job->workers; k++) {
+        FrameDeque* d = &job->deques[(self + k) % job->workers];
+        pthread_mutex_lock(&d->lock);
+        int frame = d->head < d->tail ? d->frames[d->head++] : -1;
+        pthread_mutex_unlock(&d->lock);
+        if (frame >= 0) return frame;
+    }
+    return -1;
+}
+
+static void* worker_main(void* arg) {
+    SceneWorker* worker = arg;
+    SceneJob* job = worker->job;
+
+    pthread_mutex_lock(&job->mutex);
+    while (!job->dealt && !job->stop) {
+        pthread_cond_wait(&job->changed, &job->mutex);
+    }
+    pthread_mutex_unlock(&job->mutex);
+
+    for (;;) {
+        int frame = take_frame(job, worker->index);
+        if (frame < 0) break;
+
+        pthread_mutex_lock(&job->mutex);
+        while (!job->stop && frame >= job->next_out + job->window) {
+            pthread_cond_wait(&job->changed, &job->mutex);
+        }
+        bool stop = job->stop;
+        pthread_mutex_unlock(&job->mutex);
+        if (stop) break;
+
+        Canvas* canvas = frame_pool_acquire_canvas(job->pool, job->scene->width, job->scene->height);
+        if (canvas) {
+            canvas_set_emoji_atlas(canvas, worker->atlas);
+            scene_draw_frame(job->scene, canvas, frame, job->fps);
+        }
+
+        pthread_mutex_lock(&job->mutex);
+        if (canvas) {
+            job->done[frame % job->window] = canvas;
+        } else {
+            job->failed = true;
+        }
+        pthread_cond_broadcast(&job->changed);
+        pthread_mutex_unlock(&job->mutex);
+        if (!canvas) break;
+    }
+    return NULL;
+}
+
+// Hands finished frames to the sink in order until all are out or the
+// render stops.
+static bool drain_in_order(SceneJob* job, SceneFrameSink sink, void* context) {
+    for (int frame = 0; frame < job->frame_count; frame++) {
+        int slot = frame % job->window;
+        pthread_mutex_lock(&job->mutex);
+        while (!job->done[slot] && !job->failed) {
+            pthread_cond_wait(&job->changed, &job->mutex);
+        }
+        Canvas* canvas = job->done[slot];
+        pthread_mutex_unlock(&job->mutex);
+        if (!canvas) return false;
+
+        bool ok = sink(context, frame, canvas);
+        frame_pool_release_canvas(job->pool, canvas);
+
+        pthread_mutex_lock(&job->mutex);
+        job->done[slot] = NULL;
+        job->next_out = frame + 1;
+        if (!ok) job->stop = true;
+        pthread_cond_broadcast(&job->changed);
+        pthread_mutex_unlock(&job->mutex);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+bool scene_render(const Scene* scene, const SceneRenderOptions* options,
+                  SceneFrameSink sink, void* context) {
+    if (!scene || !options || !sink || options->frame_count <= 0) return false;
+
+    int workers = options->threads;
+    if (workers <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (workers > options->frame_count) workers = options->frame_count;
+
+    SceneJob job = {
+        .scene = scene,
+        .fps = options->fps > 0 ? options->fps : 30,
+        .frame_count = options->frame_count,
+        .pool = options->pool ? options->pool : frame_pool_create(0, 0),
+        .workers = workers,
+        .window = workers * SCENE_WINDOW_PER_THREAD
+    };
+    job.deques = calloc((size_t)workers, sizeof(FrameDeque));
+    job.done = calloc((size_t)job.window, sizeof(Canvas*));
+    SceneWorker* pool = calloc((size_t)workers, sizeof(SceneWorker));
+    // Frames are dealt round-robin; each deque is a slice of one array,
+    // rounded up in size for however many workers start.
+    int* frames = malloc((size_t)(options->frame_count + workers) * sizeof(int));
+    bool ok = job.pool && job.deques && job.done && pool && frames;
+
+    int started = 0;
+    if (ok) {
+        pthread_mutex_init(&job.mutex, NULL);
+        pthread_cond_init(&job.changed, NULL);
+
+        for (int w = 0; w < workers; w++) {
+            pthread_mutex_init(&job.deques[w].lock, NULL);
+        }
+
+        // Workers wait for the deal, so frames only go to threads that
+        // started: a frame left with one that didn't would never be taken
+        // while the others wait on the window.
+        for (; started < workers; started++) {
+            SceneWorker* worker = &pool[started];
+            worker->job = &job;
+            worker->index = started;
+            worker->atlas = emoji_atlas_create(EMOJI_ATLAS_DEFAULT_SIZE, EMOJI_ATLAS_DEFAULT_SIZE);
+            if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+                emoji_atlas_destroy(worker->atlas);
+                break;
+            }
+        }
+        pthread_mutex_lock(&job.mutex);
+        job.workers = started;
+        int per = started > 0 ? (options->frame_count + started - 1) / started : 0;
+        for (int w = 0; w < started; w++) {
+            FrameDeque* d = &job.deques[w];
+            d->frames = frames + (size_t)w * per;
+            for (int f = w; f < options->frame_count; f += started) {
+                d->frames[d->tail++] = f;
+            }
+        }
+        job.dealt = true;
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.mutex);
+        ok = started > 0 && drain_in_order(&job, sink, context);
+
+        pthread_mutex_lock(&job.mutex);
+        job.stop = true;
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.mutex);
+        for (int w = 0; w < started; w++) {
+            pthread_join(pool[w].thread, NULL);
+            emoji_atlas_destroy(pool[w].atlas);
+        }
+        for (int s = 0; s < job.window; s++) {
+            if (job.done[s]) frame_pool_release_canvas(job.pool, job.done[s]);
+        }
+        for (int w = 0; w < workers; w++) {
+            pthread_mutex_destroy(&job.deques[w].lock);
+        }
+        pthread_cond_destroy(&job.changed);
+        pthread_mutex_destroy(&job.mutex);
+    }
+
+    if (job.pool && job.pool != options->pool) frame_pool_destroy(job.pool);
+    free(frames);
+    free(pool);
+    free(job.done);
+    free(job.deques);
+    return ok;
+}
@@ -0,0 +1,59 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "canvas.h"
+#include "framepool.h"
+
+// Headless timeline rendering: a scene of emoji, some animated, drawn
+// frame by frame at a fixed rate. Frames are independent, so they render
+// in parallel and come back in order.
+typedef enum {
+    SCENE_EMOJI_SMILE,
+    SCENE_EMOJI_LEAF,
+    SCENE_EMOJI_COFFEE,
+    SCENE_EMOJI_MOON,
+    SCENE_EMOJI_SPARKLE,
+    SCENE_EMOJI_BOUNCE,
+    SCENE_EMOJI_PULSE,
+    SCENE_EMOJI_SPIN
+} SceneEmojiKind;
+
+typedef struct {
+    SceneEmojiKind kind;
+    int x;
+    int y;
+    int size;
+    // progress is where the animation stands at frame 0, in seconds; it
+    // then advances with the frame clock. Inactive emoji stay at rest.
+    AnimationState anim;
+    bool loop;              // restart after duration instead of holding
+} SceneEmoji;
+
+typedef struct {
+    int width;
+    int height;
+    Color background;
+    const SceneEmoji* emojis;
+    int emoji_count;
+} Scene;
+
+// Draws frame number frame of the scene at fps onto canvas.
+void scene_draw_frame(const Scene* scene, Canvas* canvas, int frame, int fps);
+
+// Receives finished frames on the thread that called scene_render, in
+// frame order. Returning false stops the render.
+typedef bool (*SceneFrameSink)(void* context, int frame, const Canvas* canvas);
+
+typedef struct {
+    int fps;
+    int frame_count;
+    int threads;            // 0 for one per CPU
+    FramePool* pool;        // frame canvases; NULL uses a private pool
+} SceneRenderOptions;
+
+// Renders frames 0 .. frame_count - 1 across worker threads. Returns true
+// when every frame reached the sink.
+bool scene_render(const Scene* scene, const SceneRenderOptions* options,
+                  SceneFrameSink sink, void* context);
+
+#endif // SCENE_H
@@ -0,0 +1,713 @@
+#include "span.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Spans at least this large bypass the cache with streaming stores; they
+// would evict everything else anyway.
+#define SPAN_STREAM_BYTES (8u << 20)
+
+typedef struct {
+    void (*fill)(Color* dst, Color color, size_t count);
+    void (*blend)(Color* dst, Color color, size_t count);
+    void (*blend_row)(Color* dst, const Color* src, size_t count);
+    void (*blend_mask)(Color* dst, Color color, const uint8_t* mask, size_t count);
+    void (*pack_rgb)(uint8_t* dst, const Color* src, size_t count);
+    void (*luma)(uint8_t* dst, const Color* src, size_t count);
+    uint64_t (*hash)(const Color* src, size_t stride, size_t count, int rows);
+} SpanKernels;
+
+static inline uint32_t color_bits(Color color) {
+    uint32_t v;
+    memcpy(&v, &color, sizeof(v));
+    return v;
+}
+
+// x * y / 255 rounded to nearest, exact for 8-bit operands. Every kernel
+// uses this same formula so their results are bit-identical.
+static inline uint8_t mul_div255(unsigned x, unsigned y) {
+    unsigned t = x * y + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+static inline Color blend_pixel(Color s, Color d) {
+    unsigned inv = 255u - s.a;
+    Color r = {
+        (uint8_t)(s.r + mul_div255(d.r, inv)),
+        (uint8_t)(s.g + mul_div255(d.g, inv)),
+        (uint8_t)(s.b + mul_div255(d.b, inv)),
+        (uint8_t)(s.a + mul_div255(d.a, inv))
+    };
+    return r;
+}
+
+static void span_fill_scalar(Color* dst, Color color, size_t count) {
+    uint32_t v = color_bits(color);
+    uint32_t* p = (uint32_t*)dst;
+    for (size_t i = 0; i < count; i++) {
+        p[i] = v;
+    }
+}
+
+static void span_blend_scalar(Color* dst, Color color, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = blend_pixel(color, dst[i]);
+    }
+}
+
+static void span_blend_row_scalar(Color* dst, const Color* src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (src[i].a == 255) {
+            dst[i] = src[i];
+        } else if (src[i].a != 0) {
+            dst[i] = blend_pixel(src[i], dst[i]);
+        }
+    }
+}
+
+static void span_blend_mask_scalar(Color* dst, Color color, const uint8_t* mask, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        unsigned m = mask[i];
+        if (m == 0) continue;
+        Color s = {
+            mul_div255(color.r, m), mul_div255(color.g, m),
+            mul_div255(color.b, m), mul_div255(color.a, m)
+        };
+        dst[i] = blend_pixel(s, dst[i]);
+    }
+}
+
+static void span_pack_rgb_scalar(uint8_t* dst, const Color* src, size_t count) {
+    for (size_t i = 0; i < count; i++, dst += 3) {
+        dst[0] = src[i].r;
+        dst[1] = src[i].g;
+        dst[2] = src[i].b;
+    }
+}
+
+// BT.601 studio range.
+static inline uint8_t luma_pixel(Color c) {
+    return (uint8_t)(((66 * c.r + 129 * c.g + 25 * c.b + 128) >> 8) + 16);
+}
+
+static void span_luma_scalar(uint8_t* dst, const Color* src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = luma_pixel(src[i]);
+    }
+}
+
+// The block hash keeps eight 64-bit sums over 16-pixel stripes, word j of
+// every stripe going to sum j. Each word adds itself plus the product of
+// the halves of the word xored with a key; keys differ per sum and per
+// stripe position, so moving pixels around changes the products. The sums
+// don't depend on order, so vector kernels do whole stripes and leave row
+// tails to hash_tail.
+#define HASH_LANES 8
+#define HASH_STRIPE 16
+#define HASH_STRIPE_STEP 0x9E3779B97F4A7C15ull
+
+static const uint64_t hash_keys[HASH_LANES] = {
+    0xB8FE6C3923A44BBEull, 0x7C01812CF721AD1Cull, 0xDED46DE9839097DBull, 0x7240A4A4B7B3671Full,
+    0xCB79E64EB85FA6E8ull, 0x1F1D2C7E5C2E17F7ull, 0x58A35A9E3FDD1A4Bull, 0xE3C1B7A40E8F1C1Dull
+};
+
+static inline void hash_word(uint64_t* acc, uint64_t d, uint64_t key) {
+    uint64_t x = d ^ key;
+    *acc += d + (x & 0xFFFFFFFFu) * (x >> 32);
+}
+
+static inline uint64_t hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    return h ^ (h >> 33);
+}
+
+static inline uint64_t hash_salt(size_t stripe) {
+    return (uint64_t)stripe * HASH_STRIPE_STEP;
+}
+
+// Pixels past the last whole stripe of a row, as a short stripe: pixel
+// pairs make words, an odd last pixel is zero-extended.
+static void hash_tail(uint64_t* acc, const Color* src, size_t count, uint64_t salt) {
+    for (size_t w = 0; 2 * w < count; w++) {
+        uint64_t d = 0;
+        memcpy(&d, src + 2 * w, 2 * w + 1 < count ? 8 : 4);
+        hash_word(&acc[w], d, hash_keys[w] + salt);
+    }
+}
+
+static void hash_tails(uint64_t* acc, const Color* src, size_t stride, size_t count, int rows) {
+    size_t whole = count / HASH_STRIPE;
+    size_t stripes = (count + HASH_STRIPE - 1) / HASH_STRIPE;
+    if (whole == stripes) return;
+    for (int y = 0; y < rows; y++) {
+        const Color* row = (const Color*)((const uint8_t*)src + (size_t)y * stride);
+        hash_tail(acc, row + whole * HASH_STRIPE, count - whole * HASH_STRIPE,
+                  hash_salt((size_t)y * stripes + whole));
+    }
+}
+
+static uint64_t hash_finish(const uint64_t* acc, size_t count, int rows) {
+    uint64_t h = hash_mix((uint64_t)count << 32 ^ (uint32_t)rows);
+    for (int l = 0; l < HASH_LANES; l++) {
+        h = hash_mix(h ^ acc[l]);
+    }
+    return h;
+}
+
+static uint64_t span_hash_scalar(const Color* src, size_t stride, size_t count, int rows) {
+    uint64_t acc[HASH_LANES] = {0};
+    size_t whole = count / HASH_STRIPE;
+    size_t stripes = (count + HASH_STRIPE - 1) / HASH_STRIPE;
+    for (int y = 0; y < rows; y++) {
+        const Color* row = (const Color*)((const uint8_t*)src + (size_t)y * stride);
+        for (size_t s = 0; s < whole; s++) {
+            uint64_t salt = hash_salt((size_t)y * stripes + s);
+            for (int l = 0; l < HASH_LANES; l++) {
+                uint64_t d;
+                memcpy(&d, row + s * HASH_STRIPE + 2 * l, sizeof(d));
+                hash_word(&acc[l], d, hash_keys[l] + salt);
+            }
+        }
+    }
+    hash_tails(acc, src, stride, count, rows);
+    return hash_finish(acc, count, rows);
+}
+
+#ifdef SPAN_X86
+__attribute__((target("sse2")))
+static void span_fill_sse2(Color* dst, Color color, size_t count) {
+    uint32_t v = color_bits(color);
+    uint32_t* p = (uint32_t*)dst;
+
+    // Pixels are 4-byte aligned, so at most 3 scalar stores reach 16 bytes.
+    while (count > 0 && ((uintptr_t)p & 15)) {
+        *p++ = v;
+        count--;
+    }
+
+    __m128i c = _mm_set1_epi32((int)v);
+    size_t blocks = count / 16;
+    if (count * sizeof(uint32_t) >= SPAN_STREAM_BYTES) {
+        for (size_t i = 0; i < blocks; i++, p += 16) {
+            _mm_stream_si128((__m128i*)p, c);
+            _mm_stream_si128((__m128i*)(p + 4), c);
+            _mm_stream_si128((__m128i*)(p + 8), c);
+            _mm_stream_si128((__m128i*)(p + 12), c);
+        }
+        _mm_sfence();
+    } else {
+        for (size_t i = 0; i < blocks; i++, p += 16) {
+            _mm_store_si128((__m128i*)p, c);
+            _mm_store_si128((__m128i*)(p + 4), c);
+            _mm_store_si128((__m128i*)(p + 8), c);
+            _mm_store_si128((__m128i*)(p + 12), c);
+        }
+    }
+    count &= 15;
+
+    for (; count >= 4; count -= 4, p += 4) {
+        _mm_store_si128((__m128i*)p, c);
+    }
+    while (count--) {
+        *p++ = v;
+    }
+}
+
+// dst * inv / 255 on 16-bit lanes, then repacked to bytes.
+__attribute__((target("sse2")))
+static inline __m128i scale_sse2(__m128i d, __m128i inv_lo, __m128i inv_hi) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv_lo), bias);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv_hi), bias);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    return _mm_packus_epi16(lo, hi);
+}
+
+__attribute__((target("sse2")))
+static void span_blend_sse2(Color* dst, Color color, size_t count) {
+    __m128i src = _mm_set1_epi32((int)color_bits(color));
+    __m128i inv = _mm_set1_epi16((short)(255 - color.a));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        d = _mm_add_epi8(src, scale_sse2(d, inv, inv));
+        _mm_storeu_si128((__m128i*)(dst + i), d);
+    }
+    span_blend_scalar(dst + i, color, count - i);
+}
+
+__attribute__((target("sse2")))
+static void span_blend_row_sse2(Color* dst, const Color* src, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32(255);
+    const __m128i full = _mm_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i a = _mm_srli_epi32(s, 24);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, zero)) == 0xFFFF) continue;
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, opaque)) == 0xFFFF) {
+            _mm_storeu_si128((__m128i*)(dst + i), s);
+            continue;
+        }
+
+        // Broadcast each pixel's alpha across its four 16-bit channels.
+        __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+        __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+        __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+        __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        d = _mm_add_epi8(s, scale_sse2(d, _mm_sub_epi16(full, a_lo), _mm_sub_epi16(full, a_hi)));
+        _mm_storeu_si128((__m128i*)(dst + i), d);
+    }
+    span_blend_row_scalar(dst + i, src + i, count - i);
+}
+
+// Source-over of c scaled by four coverage bytes onto the pixels in d.
+__attribute__((target("sse2")))
+static inline __m128i blend_mask_sse2(__m128i d, __m128i c, uint32_t bits) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i full = _mm_set1_epi16(255);
+
+    // Each pixel's coverage copied to its four channels.
+    __m128i m = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)bits), zero), zero);
+    m = _mm_or_si128(m, _mm_slli_epi32(m, 8));
+    m = _mm_or_si128(m, _mm_slli_epi32(m, 16));
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(c, _mm_unpacklo_epi8(m, zero)), bias);
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(c, _mm_unpackhi_epi8(m, zero)), bias);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+    __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+    __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+    return _mm_add_epi8(_mm_packus_epi16(lo, hi),
+                        scale_sse2(d, _mm_sub_epi16(full, a_lo), _mm_sub_epi16(full, a_hi)));
+}
+
+// Coverage runs at shape edges are mostly shorter than a block, so the
+// last one to three pixels are blended as a partial block instead of one
+// at a time. Zero coverage leaves the padding lanes unchanged.
+__attribute__((target("sse2")))
+static void span_blend_mask_sse2(Color* dst, Color color, const uint8_t* mask, size_t count) {
+    __m128i c = _mm_unpacklo_epi8(_mm_set1_epi32((int)color_bits(color)), _mm_setzero_si128());
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32_t bits;
+        memcpy(&bits, mask + i, sizeof(bits));
+        if (bits == 0) continue;
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), blend_mask_sse2(d, c, bits));
+    }
+
+    size_t n = count - i;
+    if (n == 0) return;
+    uint32_t bits = mask[i];
+    if (n > 1) bits |= (uint32_t)mask[i + 1] << 8;
+    if (n > 2) bits |= (uint32_t)mask[i + 2] << 16;
+    if (bits == 0) return;
+
+    uint32_t first, third = 0;
+    memcpy(&first, dst + i, sizeof(first));
+    if (n > 2) memcpy(&third, dst + i + 2, sizeof(third));
+    __m128i d = n > 1 ? _mm_loadl_epi64((const __m128i*)(dst + i)) : _mm_cvtsi32_si128((int)first);
+    d = _mm_unpacklo_epi64(d, _mm_cvtsi32_si128((int)third));
+    d = blend_mask_sse2(d, c, bits);
+    if (n > 1) {
+        _mm_storel_epi64((__m128i*)(dst + i), d);
+    } else {
+        first = (uint32_t)_mm_cvtsi128_si32(d);
+        memcpy(dst + i, &first, sizeof(first));
+    }
+    if (n > 2) {
+        third = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(d, 8));
+        memcpy(dst + i + 2, &third, sizeof(third));
+    }
+}
+
+// SSE2 has no byte shuffle; four-byte stores that overlap the next pixel
+// still beat three single-byte ones.
+__attribute__((target("sse2")))
+static void span_pack_rgb_sse2(uint8_t* dst, const Color* src, size_t count) {
+    size_t i = 0;
+    for (; i + 1 < count; i++) {
+        memcpy(dst + 3 * i, &src[i], 4);
+    }
+    span_pack_rgb_scalar(dst + 3 * i, src + i, count - i);
+}
+
+// 66r + 129g + 25b for four pixels, as 32-bit lanes in pixel order.
+__attribute__((target("sse2")))
+static inline __m128i luma_sum_sse2(__m128i p) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coef = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), coef);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), coef);
+    lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+    hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+    return _mm_unpacklo_epi64(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0)),
+                              _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+__attribute__((target("sse2")))
+static void span_luma_sse2(uint8_t* dst, const Color* src, size_t count) {
+    const __m128i bias = _mm_set1_epi32(128);
+    const __m128i offset = _mm_set1_epi16(16);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = luma_sum_sse2(_mm_loadu_si128((const __m128i*)(src + i)));
+        __m128i b = luma_sum_sse2(_mm_loadu_si128((const __m128i*)(src + i + 4)));
+        a = _mm_srli_epi32(_mm_add_epi32(a, bias), 8);
+        b = _mm_srli_epi32(_mm_add_epi32(b, bias), 8);
+        __m128i y = _mm_add_epi16(_mm_packs_epi32(a, b), offset);
+        _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(y, y));
+    }
+    span_luma_scalar(dst + i, src + i, count - i);
+}
+
+// The four-pixel vector as two 64-bit words: lo * hi of each word xored
+// with its key, plus the word.
+__attribute__((target("sse2")))
+static inline __m128i hash_words_sse2(__m128i acc, __m128i d, __m128i key) {
+    __m128i x = _mm_xor_si128(d, key);
+    __m128i product = _mm_mul_epu32(x, _mm_srli_epi64(x, 32));
+    return _mm_add_epi64(acc, _mm_add_epi64(d, product));
+}
+
+__attribute__((target("sse2")))
+static uint64_t span_hash_sse2(const Color* src, size_t stride, size_t count, int rows) {
+    __m128i acc[4], keys[4];
+    for (int j = 0; j < 4; j++) {
+        acc[j] = _mm_setzero_si128();
+        keys[j] = _mm_loadu_si128((const __m128i*)hash_keys + j);
+    }
+    size_t whole = count / HASH_STRIPE;
+    size_t stripes = (count + HASH_STRIPE - 1) / HASH_STRIPE;
+    for (int y = 0; y < rows; y++) {
+        const Color* row = (const Color*)((const uint8_t*)src + (size_t)y * stride);
+        for (size_t s = 0; s < whole; s++) {
+            __m128i salt = _mm_set1_epi64x((long long)hash_salt((size_t)y * stripes + s));
+            const __m128i* p = (const __m128i*)(row + s * HASH_STRIPE);
+            for (int j = 0; j < 4; j++) {
+                acc[j] = hash_words_sse2(acc[j], _mm_loadu_si128(p + j), _mm_add_epi64(keys[j], salt));
+            }
+        }
+    }
+    uint64_t sums[HASH_LANES];
+    for (int j = 0; j < 4; j++) {
+        _mm_storeu_si128((__m128i*)sums + j, acc[j]);
+    }
+    hash_tails(sums, src, stride, count, rows);
+    return hash_finish(sums, count, rows);
+}
+
+__attribute__((target("avx2")))
+static void span_fill_avx2(Color* dst, Color color, size_t count) {
+    uint32_t v = color_bits(color);
+    uint32_t* p = (uint32_t*)dst;
+
+    while (count > 0 && ((uintptr_t)p & 31)) {
+        *p++ = v;
+        count--;
+    }
+
+    __m256i c = _mm256_set1_epi32((int)v);
+    size_t blocks = count / 32;
+    if (count * sizeof(uint32_t) >= SPAN_STREAM_BYTES) {
+        for (size_t i = 0; i < blocks; i++, p += 32) {
+            _mm256_stream_si256((__m256i*)p, c);
+            _mm256_stream_si256((__m256i*)(p + 8), c);
+            _mm256_stream_si256((__m256i*)(p + 16), c);
+            _mm256_stream_si256((__m256i*)(p + 24), c);
+        }
+        _mm_sfence();
+    } else {
+        for (size_t i = 0; i < blocks; i++, p += 32) {
+            _mm256_store_si256((__m256i*)p, c);
+            _mm256_store_si256((__m256i*)(p + 8), c);
+            _mm256_store_si256((__m256i*)(p + 16), c);
+            _mm256_store_si256((__m256i*)(p + 24), c);
+        }
+    }
+    count &= 31;
+
+    for (; count >= 8; count -= 8, p += 8) {
+        _mm256_store_si256((__m256i*)p, c);
+    }
+    if (count >= 4) {
+        _mm_store_si128((__m128i*)p, _mm256_castsi256_si128(c));
+        p += 4;
+        count -= 4;
+    }
+    while (count--) {
+        *p++ = v;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i scale_avx2(__m256i d, __m256i inv_lo, __m256i inv_hi) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi16(128);
+    __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv_lo), bias);
+    __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv_hi), bias);
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+    return _mm256_packus_epi16(lo, hi);
+}
+
+__attribute__((target("avx2")))
+static void span_blend_avx2(Color* dst, Color color, size_t count) {
+    __m256i src = _mm256_set1_epi32((int)color_bits(color));
+    __m256i inv = _mm256_set1_epi16((short)(255 - color.a));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        d = _mm256_add_epi8(src, scale_avx2(d, inv, inv));
+        _mm256_storeu_si256((__m256i*)(dst + i), d);
+    }
+    // Legacy-encoded SSE2 code stalls while upper AVX state is dirty.
+    _mm256_zeroupper();
+    span_blend_sse2(dst + i, color, count - i);
+}
+
+__attribute__((target("avx2")))
+static void span_blend_row_avx2(Color* dst, const Color* src, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32(255);
+    const __m256i full = _mm256_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i a = _mm256_srli_epi32(s, 24);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, zero)) == -1) continue;
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(a, opaque)) == -1) {
+            _mm256_storeu_si256((__m256i*)(dst + i), s);
+            continue;
+        }
+
+        __m256i s_lo = _mm256_unpacklo_epi8(s, zero);
+        __m256i s_hi = _mm256_unpackhi_epi8(s, zero);
+        __m256i a_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_lo, 0xFF), 0xFF);
+        __m256i a_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s_hi, 0xFF), 0xFF);
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        d = _mm256_add_epi8(s, scale_avx2(d, _mm256_sub_epi16(full, a_lo), _mm256_sub_epi16(full, a_hi)));
+        _mm256_storeu_si256((__m256i*)(dst + i), d);
+    }
+    // Legacy-encoded SSE2 code stalls while upper AVX state is dirty.
+    _mm256_zeroupper();
+    span_blend_row_sse2(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void span_blend_mask_avx2(Color* dst, Color color, const uint8_t* mask, size_t count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi16(128);
+    const __m256i full = _mm256_set1_epi16(255);
+    __m256i c = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)color_bits(color)), zero);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t bits;
+        memcpy(&bits, mask + i, sizeof(bits));
+        if (bits == 0) continue;
+
+        __m256i m = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(mask + i)));
+        m = _mm256_or_si256(m, _mm256_slli_epi32(m, 8));
+        m = _mm256_or_si256(m, _mm256_slli_epi32(m, 16));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(c, _mm256_unpacklo_epi8(m, zero)), bias);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(c, _mm256_unpackhi_epi8(m, zero)), bias);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+        __m256i a_lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xFF), 0xFF);
+        __m256i a_hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xFF), 0xFF);
+
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        d = _mm256_add_epi8(_mm256_packus_epi16(lo, hi),
+                            scale_avx2(d, _mm256_sub_epi16(full, a_lo), _mm256_sub_epi16(full, a_hi)));
+        _mm256_storeu_si256((__m256i*)(dst + i), d);
+    }
+    _mm256_zeroupper();
+    span_blend_mask_sse2(dst + i, color, mask + i, count - i);
+}
+
+// Each lane packs four pixels to twelve bytes; the stores overlap by four,
+// so stop while two spare pixels remain to absorb the last one.
+__attribute__((target("avx2")))
+static void span_pack_rgb_avx2(uint8_t* dst, const Color* src, size_t count) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+        __m256i p = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i)), shuffle);
+        _mm_storeu_si128((__m128i*)(dst + 3 * i), _mm256_castsi256_si128(p));
+        _mm_storeu_si128((__m128i*)(dst + 3 * i + 12), _mm256_extracti128_si256(p, 1));
+    }
+    span_pack_rgb_scalar(dst + 3 * i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i luma_sum_avx2(__m256i p) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i coef = _mm256_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0,
+                                           66, 129, 25, 0, 66, 129, 25, 0);
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(p, zero), coef);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(p, zero), coef);
+    lo = _mm256_add_epi32(lo, _mm256_srli_epi64(lo, 32));
+    hi = _mm256_add_epi32(hi, _mm256_srli_epi64(hi, 32));
+    return _mm256_unpacklo_epi64(_mm256_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0)),
+                                 _mm256_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+__attribute__((target("avx2")))
+static void span_luma_avx2(uint8_t* dst, const Color* src, size_t count) {
+    const __m256i bias = _mm256_set1_epi32(128);
+    const __m256i offset = _mm256_set1_epi16(16);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = luma_sum_avx2(_mm256_loadu_si256((const __m256i*)(src + i)));
+        __m256i b = luma_sum_avx2(_mm256_loadu_si256((const __m256i*)(src + i + 8)));
+        a = _mm256_srli_epi32(_mm256_add_epi32(a, bias), 8);
+        b = _mm256_srli_epi32(_mm256_add_epi32(b, bias), 8);
+        // packs works within lanes; restore pixel order before narrowing.
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        y = _mm256_add_epi16(y, offset);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1));
+        _mm_storeu_si128((__m128i*)(dst + i), bytes);
+    }
+    _mm256_zeroupper();
+    span_luma_sse2(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hash_words_avx2(__m256i acc, __m256i d, __m256i key) {
+    __m256i x = _mm256_xor_si256(d, key);
+    __m256i product = _mm256_mul_epu32(x, _mm256_srli_epi64(x, 32));
+    return _mm256_add_epi64(acc, _mm256_add_epi64(d, product));
+}
+
+__attribute__((target("avx2")))
+static uint64_t span_hash_avx2(const Color* src, size_t stride, size_t count, int rows) {
+    const __m256i keys_lo = _mm256_loadu_si256((const __m256i*)hash_keys);
+    const __m256i keys_hi = _mm256_loadu_si256((const __m256i*)hash_keys + 1);
+    __m256i acc_lo = _mm256_setzero_si256();
+    __m256i acc_hi = _mm256_setzero_si256();
+    size_t whole = count / HASH_STRIPE;
+    size_t stripes = (count + HASH_STRIPE - 1) / HASH_STRIPE;
+    for (int y = 0; y < rows; y++) {
+        const Color* row = (const Color*)((const uint8_t*)src + (size_t)y * stride);
+        for (size_t s = 0; s < whole; s++) {
+            __m256i salt = _mm256_set1_epi64x((long long)hash_salt((size_t)y * stripes + s));
+            const __m256i* p = (const __m256i*)(row + s * HASH_STRIPE);
+            acc_lo = hash_words_avx2(acc_lo, _mm256_loadu_si256(p), _mm256_add_epi64(keys_lo, salt));
+            acc_hi = hash_words_avx2(acc_hi, _mm256_loadu_si256(p + 1), _mm256_add_epi64(keys_hi, salt));
+        }
+    }
+    uint64_t sums[HASH_LANES];
+    _mm256_storeu_si256((__m256i*)sums, acc_lo);
+    _mm256_storeu_si256((__m256i*)sums + 1, acc_hi);
+    _mm256_zeroupper();
+    hash_tails(sums, src, stride, count, rows);
+    return hash_finish(sums, count, rows);
+}
+#endif
+
+static const SpanKernels span_kernel_table[SPAN_KERNEL_COUNT] = {
+    {span_fill_scalar, span_blend_scalar, span_blend_row_scalar, span_blend_mask_scalar,
+     span_pack_rgb_scalar, span_luma_scalar, span_hash_scalar},
+#ifdef SPAN_X86
+    {span_fill_sse2, span_blend_sse2, span_blend_row_sse2, span_blend_mask_sse2,
+     span_pack_rgb_sse2, span_luma_sse2, span_hash_sse2},
+    {span_fill_avx2, span_blend_avx2, span_blend_row_avx2, span_blend_mask_avx2,
+     span_pack_rgb_avx2, span_luma_avx2, span_hash_avx2},
+#endif
+};
+
+static const char* const span_kernel_names[SPAN_KERNEL_COUNT] = {
+    "scalar", "sse2", "avx2"
+};
+
+static SpanKernel span_kernel = SPAN_KERNEL_SCALAR;
+static const SpanKernels* span_impl = &span_kernel_table[SPAN_KERNEL_SCALAR];
+
+bool span_kernel_supported(SpanKernel kernel) {
+    switch (kernel) {
+    case SPAN_KERNEL_SCALAR:
+        return true;
+#ifdef SPAN_X86
+    case SPAN_KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case SPAN_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+// Runs before main so the kernel pointer never changes under worker threads.
+__attribute__((constructor))
+static void span_select_kernel(void) {
+#ifdef SPAN_X86
+    __builtin_cpu_init();
+#endif
+    for (int k = SPAN_KERNEL_COUNT - 1; k >= 0; k--) {
+        if (span_set_kernel((SpanKernel)k)) {
+            break;
+        }
+    }
+}
+
+void span_fill(Color* dst, Color color, size_t count) {
+    span_impl->fill(dst, color, count);
+}
+
+void span_blend(Color* dst, Color color, size_t count) {
+    span_impl->blend(dst, color, count);
+}
+
+void span_blend_row(Color* dst, const Color* src, size_t count) {
+    span_impl->blend_row(dst, src, count);
+}
+
+void span_blend_mask(Color* dst, Color color, const uint8_t* mask, size_t count) {
+    span_impl->blend_mask(dst, color, mask, count);
+}
+
+void span_pack_rgb(uint8_t* dst, const Color* src, size_t count) {
+    span_impl->pack_rgb(dst, src, count);
+}
+
+void span_luma(uint8_t* dst, const Color* src, size_t count) {
+    span_impl->luma(dst, src, count);
+}
+
+uint64_t span_hash(const Color* src, size_t stride, size_t count, int rows) {
+    return span_impl->hash(src, stride, count, rows);
+}
+
+SpanKernel span_get_kernel(void) {
+    return span_kernel;
+}
+
+bool span_set_kernel(SpanKernel kernel) {
+    if (kernel < 0 || kernel >= SPAN_KERNEL_COUNT || !span_kernel_supported(kernel)) {
+        return false;
+    }
+    span_kernel = kernel;
+    span_impl = &span_kernel_table[kernel];
+    return true;
+}
+
+const char* span_kernel_name(SpanKernel kernel) {
+    if (kernel < 0 || kernel >= SPAN_KERNEL_COUNT) return "unknown";
+    return span_kernel_names[kernel];
+}
@@ -0,0 +1,40 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <stddef.h>
+#include "canvas.h"
+
+// Span kernels fill or blend a horizontal run of pixels. The best kernel
+// set for the running CPU is picked once at startup; it can be overridden
+// for testing. All kernel sets produce bit-identical results.
+//
+// Pixels and colors given to span kernels are premultiplied.
+typedef enum {
+    SPAN_KERNEL_SCALAR,
+    SPAN_KERNEL_SSE2,
+    SPAN_KERNEL_AVX2,
+    SPAN_KERNEL_COUNT
+} SpanKernel;
+
+void span_fill(Color* dst, Color color, size_t count);
+// Source-over of one color onto count pixels.
+void span_blend(Color* dst, Color color, size_t count);
+// Source-over of src[i] onto dst[i].
+void span_blend_row(Color* dst, const Color* src, size_t count);
+// Source-over of color scaled by mask[i] / 255 onto dst[i]: A8 coverage
+// from anti-aliased shapes.
+void span_blend_mask(Color* dst, Color color, const uint8_t* mask, size_t count);
+// Pixel conversions for encoders: 3-byte RGB with alpha dropped, and
+// BT.601 studio-range luma.
+void span_pack_rgb(uint8_t* dst, const Color* src, size_t count);
+void span_luma(uint8_t* dst, const Color* src, size_t count);
+// 64-bit hash of a block of rows count pixels wide, stride bytes apart, for
+// spotting changed pixels cheaply. Fast rather than cryptographic.
+uint64_t span_hash(const Color* src, size_t stride, size_t count, int rows);
+
+SpanKernel span_get_kernel(void);
+bool span_set_kernel(SpanKernel kernel);
+bool span_kernel_supported(SpanKernel kernel);
+const char* span_kernel_name(SpanKernel kernel);
+
+#endif // SPAN_H
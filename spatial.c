@@ -0,0 +1,465 @@
+#include "spatial.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Grids larger than this are refused; pick a bigger cell size.
+#define SPATIAL_MAX_CELLS (1 << 22)
+#define SPATIAL_MAX_DEPTH 12
+// Nodes waiting on a query's stack: three siblings per level plus one.
+#define SPATIAL_STACK (4 * SPATIAL_MAX_DEPTH + 4)
+
+typedef struct {
+    int* ids;
+    int count;
+    int capacity;
+} IdList;
+
+typedef struct {
+    Rect rect;
+    int node;               // quadtree node holding the item
+    int slot;               // its place in that node's list
+    bool live;
+} Item;
+
+// Quadtree nodes cover [x, x + size) squared, and hold items whose centre
+// falls inside and whose larger side is at most size. Such an item stays
+// within the loose bounds, the square grown by size / 2 on every side, so
+// an item never straddles children and never moves up for a few pixels.
+typedef struct {
+    float x;
+    float y;
+    float size;
+    int parent;
+    int children;           // first of four, -1 for a leaf
+    int depth;
+    int total;              // items here and in every descendant
+    IdList items;
+} Node;
+
+struct SpatialIndex {
+    SpatialKind kind;
+    Rect world;
+    float cell_size;
+    float inv_cell;
+    Item* items;
+    int item_capacity;
+    int count;
+
+    // SPATIAL_GRID: items sit in every cell they overlap.
+    int cols;
+    int rows;
+    IdList* cells;
+
+    // SPATIAL_QUADTREE: node 0 is the root. Items whose centre is outside
+    // it stay in the root.
+    Node* nodes;
+    int node_count;
+    int node_capacity;
+    int max_depth;
+};
+
+static bool id_list_reserve(IdList* list, int capacity) {
+    if (capacity <= list->capacity) return true;
+    int* ids = realloc(list->ids, (size_t)capacity * sizeof(int));
+    if (!ids) return false;
+    list->ids = ids;
+    list->capacity = capacity;
+    return true;
+}
+
+static bool id_list_push(IdList* list, int id) {
+    if (list->count == list->capacity &&
+        !id_list_reserve(list, list->capacity ? list->capacity * 2 : 4)) {
+        return false;
+    }
+    list->ids[list->count++] = id;
+    return true;
+}
+
+// Swaps the last id into the hole; order within a list doesn't matter.
+static void id_list_remove(IdList* list, int id) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->ids[i] == id) {
+            list->ids[i] = list->ids[--list->count];
+            return;
+        }
+    }
+}
+
+static bool ensure_item(SpatialIndex* index, int id) {
+    if (id < index->item_capacity) return true;
+    int capacity = index->item_capacity ? index->item_capacity : 64;
+    while (capacity <= id) capacity *= 2;
+    Item* items = realloc(index->items, (size_t)capacity * sizeof(Item));
+    if (!items) return false;
+    memset(items + index->item_capacity, 0, (size_t)(capacity - index->item_capacity) * sizeof(Item));
+    index->items = items;
+    index->item_capacity = capacity;
+    return true;
+}
+
+// Grid
+
+static int cell_of(float v, float origin, float inv_cell, int limit) {
+    float c = floorf((v - origin) * inv_cell);
+    if (!(c >= 0.0f)) return 0;     // also catches NaN
+    if (c >= (float)limit) return limit - 1;
+    return (int)c;
+}
+
+// Inclusive cell range of r, clamped to the grid so stray items land in
+// the border cells.
+static void cell_range(const SpatialIndex* index, Rect r, int* x0, int* y0, int* x1, int* y1) {
+    *x0 = cell_of(r.x, index->world.x, index->inv_cell, index->cols);
+    *y0 = cell_of(r.y, index->world.y, index->inv_cell, index->rows);
+    *x1 = cell_of(r.x + (r.width > 0 ? r.width : 0), index->world.x, index->inv_cell, index->cols);
+    *y1 = cell_of(r.y + (r.height > 0 ? r.height : 0), index->world.y, index->inv_cell, index->rows);
+}
+
+static void grid_remove(SpatialIndex* index, int id) {
+    int x0, y0, x1, y1;
+    cell_range(index, index->items[id].rect, &x0, &y0, &x1, &y1);
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            id_list_remove(&index->cells[cy * index->cols + cx], id);
+        }
+    }
+}
+
+static bool grid_add(SpatialIndex* index, int id) {
+    int x0, y0, x1, y1;
+    cell_range(index, index->items[id].rect, &x0, &y0, &x1, &y1);
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            if (id_list_push(&index->cells[cy * index->cols + cx], id)) continue;
+            // Undo the cells already added to.
+            for (int uy = y0; uy <= cy; uy++) {
+                for (int ux = x0; ux <= (uy == cy ? cx - 1 : x1); ux++) {
+                    id_list_remove(&index->cells[uy * index->cols + ux], id);
+                }
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+static int grid_query_point(const SpatialIndex* index, float x, float y, int* out, int max) {
+    int cx = cell_of(x, index->world.x, index->inv_cell, index->cols);
+    int cy = cell_of(y, index->world.y, index->inv_cell, index->rows);
+    const IdList* cell = &index->cells[cy * index->cols + cx];
+    int found = 0;
+    for (int i = 0; i < cell->count; i++) {
+        int id = cell->ids[i];
+        if (!rect_contains_point(index->items[id].rect, x, y)) continue;
+        if (found < max) out[found] = id;
+        found++;
+    }
+    return found;
+}
+
+static int grid_query_rect(const SpatialIndex* index, Rect area, int* out, int max) {
+    int qx0, qy0, qx1, qy1;
+    cell_range(index, area, &qx0, &qy0, &qx1, &qy1);
+    int found = 0;
+    for (int cy = qy0; cy <= qy1; cy++) {
+        for (int cx = qx0; cx <= qx1; cx++) {
+            const IdList* cell = &index->cells[cy * index->cols + cx];
+            for (int i = 0; i < cell->count; i++) {
+                int id = cell->ids[i];
+                Rect r = index->items[id].rect;
+                // An item spanning several visited cells is reported by
+                // the first of them only.
+                int x0, y0, x1, y1;
+                cell_range(index, r, &x0, &y0, &x1, &y1);
+                if (cx != (x0 > qx0 ? x0 : qx0) || cy != (y0 > qy0 ? y0 : qy0)) continue;
+                if (!rect_intersects_rect(r, area)) continue;
+                if (found < max) out[found] = id;
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+// Quadtree
+
+static void init_node(Node* n, float x, float y, float size, int parent, int depth) {
+    *n = (Node){x, y, size, parent, -1, depth, 0, {NULL, 0, 0}};
+}
+
+static bool split_node(SpatialIndex* index, int n) {
+    if (index->node_count + 4 > index->node_capacity) {
+        int capacity = index->node_capacity * 2;
+        Node* nodes = realloc(index->nodes, (size_t)capacity * sizeof(Node));
+        if (!nodes) return false;
+        index->nodes = nodes;
+        index->node_capacity = capacity;
+    }
+    Node* parent = &index->nodes[n];
+    float half = parent->size * 0.5f;
+    int first = index->node_count;
+    for (int q = 0; q < 4; q++) {
+        init_node(&index->nodes[first + q], parent->x + (q & 1 ? half : 0.0f),
+                  parent->y + (q & 2 ? half : 0.0f), half, n, parent->depth + 1);
+    }
+    parent->children = first;
+    index->node_count += 4;
+    return true;
+}
+
+// The node r belongs in. Without create, -1 when that node doesn't exist
+// yet; with it, -1 when out of memory.
+static int quad_place(SpatialIndex* index, Rect r, bool create) {
+    float extent = r.width > r.height ? r.width : r.height;
+    float cx = r.x + r.width * 0.5f, cy = r.y + r.height * 0.5f;
+    const Node* root = &index->nodes[0];
+    if (!(cx >= root->x && cy >= root->y && cx < root->x + root->size && cy < root->y + root->size)) {
+        return 0;
+    }
+    int n = 0;
+    while (index->nodes[n].depth < index->max_depth) {
+        const Node* node = &index->nodes[n];
+        float half = node->size * 0.5f;
+        if (extent > half) break;
+        if (node->children < 0) {
+            if (!create || !split_node(index, n)) return -1;
+            node = &index->nodes[n];
+        }
+        n = node->children + (cx >= node->x + half) + 2 * (cy >= node->y + half);
+    }
+    return n;
+}
+
+static void adjust_totals(SpatialIndex* index, int n, int delta) {
+    for (; n >= 0; n = index->nodes[n].parent) index->nodes[n].total += delta;
+}
+
+static bool quad_add(SpatialIndex* index, int id, int n) {
+    Item* item = &index->items[id];
+    IdList* list = &index->nodes[n].items;
+    if (!id_list_push(list, id)) return false;
+    item->node = n;
+    item->slot = list->count - 1;
+    adjust_totals(index, n, 1);
+    return true;
+}
+
+static void quad_remove(SpatialIndex* index, int id) {
+    Item* item = &index->items[id];
+    IdList* list = &index->nodes[item->node].items;
+    int moved = list->ids[--list->count];
+    list->ids[item->slot] = moved;
+    index->items[moved].slot = item->slot;
+    adjust_totals(index, item->node, -1);
+}
+
+static bool loose_contains(const Node* n, float x, float y) {
+    float pad = n->size * 0.5f;
+    return x >= n->x - pad && y >= n->y - pad &&
+           x <= n->x + n->size + pad && y <= n->y + n->size + pad;
+}
+
+static bool loose_intersects(const Node* n, Rect area) {
+    float pad = n->size * 0.5f;
+    return area.x <= n->x + n->size + pad && area.y <= n->y + n->size + pad &&
+           area.x + area.width >= n->x - pad && area.y + area.height >= n->y - pad;
+}
+
+// Walks the nodes whose loose bounds may hold a match. point selects a
+// point query at (area.x, area.y).
+static int quad_query(const SpatialIndex* index, Rect area, bool point, int* out, int max) {
+    int stack[SPATIAL_STACK];
+    int depth = 0;
+    int found = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const Node* n = &index->nodes[stack[--depth]];
+        for (int i = 0; i < n->items.count; i++) {
+            int id = n->items.ids[i];
+            Rect r = index->items[id].rect;
+            bool hit = point ? rect_contains_point(r, area.x, area.y) : rect_intersects_rect(r, area);
+            if (!hit) continue;
+            if (found < max) out[found] = id;
+            found++;
+        }
+        if (n->children < 0) continue;
+        for (int q = 0; q < 4; q++) {
+            const Node* child = &index->nodes[n->children + q];
+            if (child->total == 0) continue;
+            if (point ? !loose_contains(child, area.x, area.y) : !loose_intersects(child, area)) continue;
+            stack[depth++] = n->children + q;
+        }
+    }
+    return found;
+}
+
+// Shared
+
+SpatialIndex* spatial_index_create(SpatialKind kind, Rect world, float cell_size) {
+    if (!(cell_size > 0.0f) || !(world.width > 0.0f) || !(world.height > 0.0f)) return NULL;
+    SpatialIndex* index = calloc(1, sizeof(SpatialIndex));
+    if (!index) return NULL;
+    index->kind = kind;
+    index->world = world;
+    index->cell_size = cell_size;
+    index->inv_cell = 1.0f / cell_size;
+
+    if (kind == SPATIAL_GRID) {
+        double cols = ceil(world.width / cell_size), rows = ceil(world.height / cell_size);
+        if (cols * rows > SPATIAL_MAX_CELLS) {
+            free(index);
+            return NULL;
+        }
+        index->cols = (int)cols;
+        index->rows = (int)rows;
+        index->cells = calloc((size_t)index->cols * index->rows, sizeof(IdList));
+        if (!index->cells) {
+            free(index);
+            return NULL;
+        }
+        return index;
+    }
+
+    float size = world.width > world.height ? world.width : world.height;
+    while (index->max_depth < SPATIAL_MAX_DEPTH && size * 0.5f >= cell_size) {
+        size *= 0.5f;
+        index->max_depth++;
+    }
+    index->node_capacity = 64;
+    index->nodes = malloc((size_t)index->node_capacity * sizeof(Node));
+    if (!index->nodes) {
+        free(index);
+        return NULL;
+    }
+    init_node(&index->nodes[0], world.x, world.y,
+              world.width > world.height ? world.width : world.height, -1, 0);
+    index->node_count = 1;
+    return index;
+}
+
+void spatial_index_destroy(SpatialIndex* index) {
+    if (!index) return;
+    if (index->cells) {
+        for (int c = 0; c < index->cols * index->rows; c++) free(index->cells[c].ids);
+        free(index->cells);
+    }
+    for (int n = 0; n < index->node_count; n++) free(index->nodes[n].items.ids);
+    free(index->nodes);
+    free(index->items);
+    free(index);
+}
+
+void spatial_index_clear(SpatialIndex* index) {
+    if (!index) return;
+    if (index->kind == SPATIAL_GRID) {
+        for (int c = 0; c < index->cols * index->rows; c++) index->cells[c].count = 0;
+    } else {
+        // Keep the root's list; the rest are rebuilt as items come back.
+        for (int n = 1; n < index->node_count; n++) free(index->nodes[n].items.ids);
+        index->node_count = 1;
+        index->nodes[0].children = -1;
+        index->nodes[0].total = 0;
+        index->nodes[0].items.count = 0;
+    }
+    for (int i = 0; i < index->item_capacity; i++) index->items[i].live = false;
+    index->count = 0;
+}
+
+bool spatial_index_build(SpatialIndex* index, const Rect* rects, int count) {
+    if (!index || count < 0 || (count > 0 && !rects)) return false;
+    spatial_index_clear(index);
+    if (count > 0 && !ensure_item(index, count - 1)) return false;
+
+    // Size every cell once rather than growing them item by item.
+    if (index->kind == SPATIAL_GRID) {
+        IdList* cells = index->cells;
+        for (int i = 0; i < count; i++) {
+            int x0, y0, x1, y1;
+            cell_range(index, rects[i], &x0, &y0, &x1, &y1);
+            for (int cy = y0; cy <= y1; cy++) {
+                for (int cx = x0; cx <= x1; cx++) cells[cy * index->cols + cx].count++;
+            }
+        }
+        bool ok = true;
+        for (int c = 0; c < index->cols * index->rows; c++) {
+            ok = ok && id_list_reserve(&cells[c], cells[c].count);
+            cells[c].count = 0;
+        }
+        if (!ok) return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!spatial_index_insert(index, i, rects[i])) {
+            spatial_index_clear(index);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool spatial_index_insert(SpatialIndex* index, int id, Rect rect) {
+    if (!index || id < 0 || !ensure_item(index, id) || index->items[id].live) return false;
+    Item* item = &index->items[id];
+    item->rect = rect;
+    if (index->kind == SPATIAL_GRID) {
+        if (!grid_add(index, id)) return false;
+    } else {
+        int n = quad_place(index, rect, true);
+        if (n < 0 || !quad_add(index, id, n)) return false;
+    }
+    item->live = true;
+    index->count++;
+    return true;
+}
+
+bool spatial_index_move(SpatialIndex* index, int id, Rect rect) {
+    if (!index || id < 0 || id >= index->item_capacity || !index->items[id].live) return false;
+    Item* item = &index->items[id];
+
+    // Most moves are small and leave the item where it was filed.
+    if (index->kind == SPATIAL_GRID) {
+        int a[4], b[4];
+        cell_range(index, item->rect, &a[0], &a[1], &a[2], &a[3]);
+        cell_range(index, rect, &b[0], &b[1], &b[2], &b[3]);
+        if (memcmp(a, b, sizeof(a)) == 0) {
+            item->rect = rect;
+            return true;
+        }
+    } else if (quad_place(index, rect, false) == item->node) {
+        item->rect = rect;
+        return true;
+    }
+    spatial_index_remove(index, id);
+    return spatial_index_insert(index, id, rect);
+}
+
+void spatial_index_remove(SpatialIndex* index, int id) {
+    if (!index || id < 0 || id >= index->item_capacity || !index->items[id].live) return;
+    if (index->kind == SPATIAL_GRID) {
+        grid_remove(index, id);
+    } else {
+        quad_remove(index, id);
+    }
+    index->items[id].live = false;
+    index->count--;
+}
+
+int spatial_index_count(const SpatialIndex* index) {
+    return index ? index->count : 0;
+}
+
+int spatial_index_query_point(const SpatialIndex* index, float x, float y, int* out, int max) {
+    if (!index || index->count == 0) return 0;
+    if (!out) max = 0;
+    if (index->kind == SPATIAL_GRID) return grid_query_point(index, x, y, out, max);
+    return quad_query(index, rect_make(x, y, 0, 0), true, out, max);
+}
+
+int spatial_index_query_rect(const SpatialIndex* index, Rect area, int* out, int max) {
+    if (!index || index->count == 0) return 0;
+    if (!out) max = 0;
+    if (index->kind == SPATIAL_GRID) return grid_query_rect(index, area, out, max);
+    return quad_query(index, area, false, out, max);
+}
@@ -0,0 +1,49 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <stdbool.h>
+#include "rect.h"
+
+// Finds the items under a point or touching an area without scanning them
+// all. Items are Rects named by caller ids: small non-negative ints, such
+// as an index into the caller's own array, since storage grows to the
+// largest id.
+//
+// Two layouts share the API. A uniform grid suits items of similar size
+// spread over a known area, like cards in a layout grid. A loose quadtree
+// suits items of mixed sizes or clustered ones. Queries don't allocate
+// and, as they never modify the index, may run from several threads
+// between updates.
+typedef struct SpatialIndex SpatialIndex;
+
+typedef enum {
+    SPATIAL_GRID,           // cells of cell_size over world
+    SPATIAL_QUADTREE        // nodes halving down to cell_size
+} SpatialKind;
+
+// world is the area items are expected in; items outside it still work,
+// they are just found more slowly. For a grid, cell_size is best around the
+// typical item size.
+SpatialIndex* spatial_index_create(SpatialKind kind, Rect world, float cell_size);
+void spatial_index_destroy(SpatialIndex* index);
+// Drops every item, keeping the storage.
+void spatial_index_clear(SpatialIndex* index);
+
+// Replaces the contents with items 0 .. count - 1, item i at rects[i].
+bool spatial_index_build(SpatialIndex* index, const Rect* rects, int count);
+// Fails if id is negative, already present or out of memory.
+bool spatial_index_insert(SpatialIndex* index, int id, Rect rect);
+// Fails if id is not present or out of memory, in which case it's gone.
+bool spatial_index_move(SpatialIndex* index, int id, Rect rect);
+void spatial_index_remove(SpatialIndex* index, int id);
+int spatial_index_count(const SpatialIndex* index);
+
+// Query results: up to max ids are written to out, in no particular order.
+// The return value is the number of matches, which may be more than max.
+
+// Items whose rect contains (x, y), as rect_contains_point.
+int spatial_index_query_point(const SpatialIndex* index, float x, float y, int* out, int max);
+// Items whose rect intersects area, as rect_intersects_rect.
+int spatial_index_query_rect(const SpatialIndex* index, Rect area, int* out, int max);
+
+#endif // SPATIAL_H
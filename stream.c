@@ -0,0 +1,518 @@
+#define _GNU_SOURCE
+
+#include "stream.h"
+#include "span.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define STREAM_BUFFER_BYTES (1u << 20)
+
+struct FrameStream {
+    int fd;
+    FrameStreamFormat format;
+    int width;
+    int height;
+    bool failed;
+    uint8_t* buffer;        // pending output
+    size_t used;
+    size_t capacity;
+    uint8_t* scratch;       // Y4M chroma planes or an RLE frame
+    size_t scratch_capacity;
+    struct iovec* rows;     // RAW frames, one vector per row plus the header
+    uint64_t* tile_hashes;  // DELTA: each tile's hash in the last frame
+    bool have_tiles;        // DELTA: past the first frame
+};
+
+struct FrameStreamReader {
+    int fd;
+    FrameStreamFormat format;
+    int width;
+    int height;
+    int fps;
+    bool failed;
+    uint8_t* payload;
+    size_t capacity;
+};
+
+static int tiles_across(int size) {
+    return (size + FRAME_STREAM_TILE - 1) / FRAME_STREAM_TILE;
+}
+
+// Largest payload a valid frame can have.
+static size_t max_payload(FrameStreamFormat format, int width, int height) {
+    size_t pixels = (size_t)width * height;
+    switch (format) {
+    case FRAME_STREAM_RAW:
+        return pixels * sizeof(Color);
+    case FRAME_STREAM_RLE:
+        return ((size_t)width * 4 + (size_t)width / 128 + 1) * height;
+    default: {
+        // Tile rows are at most 32 pixels, so one literal packet each.
+        size_t tiles = (size_t)tiles_across(width) * tiles_across(height);
+        return (tiles + 7) / 8 + ((size_t)width * 4 + tiles_across(width)) * height;
+    }
+    }
+}
+
+// writev until everything is out, resuming after short writes.
+static bool write_vectors(int fd, struct iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return true;
+}
+
+static void flush(FrameStream* stream) {
+    if (stream->used == 0) return;
+    struct iovec iov = {stream->buffer, stream->used};
+    if (!stream->failed && !write_vectors(stream->fd, &iov, 1)) stream->failed = true;
+    stream->used = 0;
+}
+
+// Room for n bytes at the end of the buffer; n never exceeds its capacity.
+static uint8_t* reserve(FrameStream* stream, size_t n) {
+    if (stream->used + n > stream->capacity) flush(stream);
+    uint8_t* p = stream->buffer + stream->used;
+    stream->used += n;
+    return p;
+}
+
+static void put_u16(uint8_t* p, unsigned v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+static void put_text(FrameStream* stream, const char* text) {
+    size_t n = strlen(text);
+    memcpy(reserve(stream, n), text, n);
+}
+
+static bool grow_scratch(FrameStream* stream, size_t bytes) {
+    if (bytes <= stream->scratch_capacity) return true;
+    uint8_t* scratch = realloc(stream->scratch, bytes);
+    if (!scratch) return false;
+    stream->scratch = scratch;
+    stream->scratch_capacity = bytes;
+    return true;
+}
+
+FrameStream* frame_stream_open(int fd, FrameStreamFormat format, int width, int height, int fps) {
+    if (fd < 0 || width <= 0 || height <= 0 || format > FRAME_STREAM_DELTA) return NULL;
+    if (fps <= 0) fps = 30;
+
+    FrameStream* stream = calloc(1, sizeof(FrameStream));
+    if (!stream) return NULL;
+    stream->fd = fd;
+    stream->format = format;
+    stream->width = width;
+    stream->height = height;
+    // Big enough for any single row in any format.
+    stream->capacity = (size_t)width * 5 + 64;
+    if (stream->capacity < STREAM_BUFFER_BYTES) stream->capacity = STREAM_BUFFER_BYTES;
+    stream->buffer = malloc(stream->capacity);
+    if (format == FRAME_STREAM_RAW) stream->rows = malloc(((size_t)height + 1) * sizeof(struct iovec));
+    if (format == FRAME_STREAM_DELTA) {
+        stream->tile_hashes = malloc((size_t)tiles_across(width) * tiles_across(height) * sizeof(uint64_t));
+    }
+    if (!stream->buffer || (format == FRAME_STREAM_RAW && !stream->rows) ||
+        (format == FRAME_STREAM_DELTA && !stream->tile_hashes)) {
+        frame_stream_close(stream);
+        return NULL;
+    }
+
+    char text[96];
+    switch (format) {
+    case FRAME_STREAM_Y4M:
+        snprintf(text, sizeof(text), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+        put_text(stream, text);
+        break;
+    case FRAME_STREAM_RAW:
+    case FRAME_STREAM_RLE:
+    case FRAME_STREAM_DELTA: {
+        uint8_t* p = reserve(stream, 16);
+        memcpy(p, "CNVS", 4);
+        p[4] = 1;
+        p[5] = (uint8_t)(format - FRAME_STREAM_RAW);
+        put_u16(p + 6, (unsigned)fps);
+        put_u32(p + 8, (uint32_t)width);
+        put_u32(p + 12, (uint32_t)height);
+        break;
+    }
+    default:
+        break;
+    }
+    return stream;
+}
+
+static void write_ppm(FrameStream* stream, const Canvas* canvas) {
+    char text[64];
+    snprintf(text, sizeof(text), "P6\n%d %d\n255\n", canvas->width, canvas->height);
+    put_text(stream, text);
+    for (int y = 0; y < canvas->height; y++) {
+        span_pack_rgb(reserve(stream, (size_t)canvas->width * 3), canvas_row(canvas, y), (size_t)canvas->width);
+    }
+}
+
+// Chroma of a 2x2 block, edges clamped, offset so the shift stays positive.
+static void block_chroma(const Canvas* canvas, int x, int y, uint8_t* u, uint8_t* v) {
+    int x1 = x + 1 < canvas->width ? x + 1 : x;
+    int y1 = y + 1 < canvas->height ? y + 1 : y;
+    const Color* top = canvas_row(canvas, y);
+    const Color* bottom = canvas_row(canvas, y1);
+    int r = (top[x].r + top[x1].r + bottom[x].r + bottom[x1].r + 2) >> 2;
+    int g = (top[x].g + top[x1].g + bottom[x].g + bottom[x1].g + 2) >> 2;
+    int b = (top[x].b + top[x1].b + bottom[x].b + bottom[x1].b + 2) >> 2;
+    *u = (uint8_t)((-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8);
+    *v = (uint8_t)((112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8);
+}
+
+static bool write_y4m(FrameStream* stream, const Canvas* canvas) {
+    int cw = (canvas->width + 1) / 2, ch = (canvas->height + 1) / 2;
+    if (!grow_scratch(stream, (size_t)cw * ch * 2)) return false;
+    uint8_t* u = stream->scratch;
+    uint8_t* v = u + (size_t)cw * ch;
+    for (int cy = 0; cy < ch; cy++) {
+        for (int cx = 0; cx < cw; cx++) {
+            block_chroma(canvas, 2 * cx, 2 * cy, &u[(size_t)cy * cw + cx], &v[(size_t)cy * cw + cx]);
+        }
+    }
+
+    put_text(stream, "FRAME\n");
+    for (int y = 0; y < canvas->height; y++) {
+        span_luma(reserve(stream, (size_t)canvas->width), canvas_row(canvas, y), (size_t)canvas->width);
+    }
+    for (int row = 0; row < 2 * ch; row++) {
+        memcpy(reserve(stream, (size_t)cw), u + (size_t)row * cw, (size_t)cw);
+    }
+    return true;
+}
+
+// Frame rows go out straight from the canvas, behind whatever is buffered.
+static void write_raw(FrameStream* stream, const Canvas* canvas) {
+    size_t row_bytes = (size_t)canvas->width * sizeof(Color);
+    put_u32(reserve(stream, 4), (uint32_t)(row_bytes * canvas->height));
+
+    struct iovec* iov = stream->rows;
+    int count = 0;
+    iov[count++] = (struct iovec){stream->buffer, stream->used};
+    if (canvas_is_packed(canvas)) {
+        iov[count++] = (struct iovec){canvas->pixels, row_bytes * canvas->height};
+    } else {
+        for (int y = 0; y < canvas->height; y++) {
+            iov[count++] = (struct iovec){canvas_row(canvas, y), row_bytes};
+        }
+    }
+    if (!stream->failed && !write_vectors(stream->fd, iov, count)) stream->failed = true;
+    stream->used = 0;
+}
+
+static size_t rle_encode_row(uint8_t* out, const Color* row, int width) {
+    const uint32_t* p = (const uint32_t*)row;
+    size_t n = 0;
+    int x = 0;
+    while (x < width) {
+        int run = 1;
+        while (x + run < width && run < 129 && p[x + run] == p[x]) run++;
+        if (run >= 2) {
+            out[n++] = (uint8_t)(run + 126);
+            memcpy(out + n, &p[x], 4);
+            n += 4;
+            x += run;
+            continue;
+        }
+
+        // Literals, up to the next pair of equal pixels.
+        int start = x;
+        while (x < width && x - start < 128 && !(x + 1 < width && p[x + 1] == p[x])) x++;
+        out[n++] = (uint8_t)(x - start - 1);
+        memcpy(out + n, &p[start], (size_t)(x - start) * 4);
+        n += (size_t)(x - start) * 4;
+    }
+    return n;
+}
+
+// Sends the payload built in scratch, behind whatever is buffered.
+static void write_scratch(FrameStream* stream, size_t size) {
+    put_u32(reserve(stream, 4), (uint32_t)size);
+    struct iovec iov[2] = {{stream->buffer, stream->used}, {stream->scratch, size}};
+    if (!stream->failed && !write_vectors(stream->fd, iov, 2)) stream->failed = true;
+    stream->used = 0;
+}
+
+static bool write_rle(FrameStream* stream, const Canvas* canvas) {
+    if (!grow_scratch(stream, max_payload(FRAME_STREAM_RLE, canvas->width, canvas->height))) return false;
+
+    size_t size = 0;
+    for (int y = 0; y < canvas->height; y++) {
+        size += rle_encode_row(stream->scratch + size, canvas_row(canvas, y), canvas->width);
+    }
+    write_scratch(stream, size);
+    return true;
+}
+
+static bool write_delta(FrameStream* stream, const Canvas* canvas) {
+    if (!grow_scratch(stream, max_payload(FRAME_STREAM_DELTA, canvas->width, canvas->height))) return false;
+
+    int columns = tiles_across(canvas->width), rows = tiles_across(canvas->height);
+    size_t map_bytes = ((size_t)columns * rows + 7) / 8;
+    uint8_t* map = stream->scratch;
+    memset(map, 0, map_bytes);
+    size_t size = map_bytes;
+    for (int ty = 0; ty < rows; ty++) {
+        int y0 = ty * FRAME_STREAM_TILE;
+        int h = canvas->height - y0 < FRAME_STREAM_TILE ? canvas->height - y0 : FRAME_STREAM_TILE;
+        for (int tx = 0; tx < columns; tx++) {
+            int x0 = tx * FRAME_STREAM_TILE;
+            int w = canvas->width - x0 < FRAME_STREAM_TILE ? canvas->width - x0 : FRAME_STREAM_TILE;
+            size_t t = (size_t)ty * columns + tx;
+            uint64_t hash = span_hash(canvas_row(canvas, y0) + x0, canvas->stride, (size_t)w, h);
+            if (stream->have_tiles && stream->tile_hashes[t] == hash) continue;
+
+            stream->tile_hashes[t] = hash;
+            map[t / 8] |= (uint8_t)(1u << (t % 8));
+            for (int y = y0; y < y0 + h; y++) {
+                size += rle_encode_row(stream->scratch + size, canvas_row(canvas, y) + x0, w);
+            }
+        }
+    }
+    stream->have_tiles = true;
+    write_scratch(stream, size);
+    return true;
+}
+
+bool frame_stream_write(FrameStream* stream, const Canvas* canvas) {
+    if (!stream || !canvas || stream->failed) return false;
+    if (canvas->width != stream->width || canvas->height != stream->height) return false;
+
+    switch (stream->format) {
+    case FRAME_STREAM_PPM:
+        write_ppm(stream, canvas);
+        break;
+    case FRAME_STREAM_Y4M:
+        if (!write_y4m(stream, canvas)) return false;
+        break;
+    case FRAME_STREAM_RAW:
+        write_raw(stream, canvas);
+        break;
+    case FRAME_STREAM_RLE:
+        if (!write_rle(stream, canvas)) return false;
+        break;
+    case FRAME_STREAM_DELTA:
+        if (!write_delta(stream, canvas)) return false;
+        break;
+    }
+    return !stream->failed;
+}
+
+bool frame_stream_close(FrameStream* stream) {
+    if (!stream) return false;
+    if (stream->buffer) flush(stream);
+    bool ok = !stream->failed;
+    free(stream->rows);
+    free(stream->tile_hashes);
+    free(stream->scratch);
+    free(stream->buffer);
+    free(stream);
+    return ok;
+}
+
+// Reads exactly n bytes. A clean end of stream before the first byte
+// returns false without marking the reader failed.
+static bool read_fully(FrameStreamReader* reader, void* dst, size_t n) {
+    uint8_t* p = dst;
+    size_t done = 0;
+    while (done < n) {
+        ssize_t got = read(reader->fd, p + done, n - done);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            if (got < 0 || done > 0) reader->failed = true;
+            return false;
+        }
+        done += (size_t)got;
+    }
+    return true;
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+FrameStreamReader* frame_stream_reader_open(int fd) {
+    if (fd < 0) return NULL;
+    FrameStreamReader* reader = calloc(1, sizeof(FrameStreamReader));
+    if (!reader) return NULL;
+    reader->fd = fd;
+
+    uint8_t header[16];
+    uint32_t width = 0, height = 0;
+    if (read_fully(reader, header, sizeof(header)) && memcmp(header, "CNVS", 4) == 0 &&
+        header[4] == 1 && header[5] <= FRAME_STREAM_DELTA - FRAME_STREAM_RAW) {
+        width = get_u32(header + 8);
+        height = get_u32(header + 12);
+    }
+    if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX) {
+        free(reader);
+        return NULL;
+    }
+    reader->format = (FrameStreamFormat)(FRAME_STREAM_RAW + header[5]);
+    reader->width = (int)width;
+    reader->height = (int)height;
+    reader->fps = header[6] | header[7] << 8;
+    return reader;
+}
+
+int frame_stream_reader_width(const FrameStreamReader* reader) {
+    return reader ? reader->width : 0;
+}
+
+int frame_stream_reader_height(const FrameStreamReader* reader) {
+    return reader ? reader->height : 0;
+}
+
+int frame_stream_reader_fps(const FrameStreamReader* reader) {
+    return reader ? reader->fps : 0;
+}
+
+// Unpacks one row of packets, returning the bytes used, or 0 when they
+// overrun the input or don't fill the row exactly.
+static size_t rle_decode_row(Color* row, int width, const uint8_t* in, size_t available) {
+    uint32_t* p = (uint32_t*)row;
+    size_t n = 0;
+    int x = 0;
+    while (x < width) {
+        if (n >= available) return 0;
+        unsigned packet = in[n++];
+        if (packet < 128) {
+            int count = (int)packet + 1;
+            size_t bytes = (size_t)count * 4;
+            if (count > width - x || bytes > available - n) return 0;
+            memcpy(p + x, in + n, bytes);
+            n += bytes;
+            x += count;
+        } else {
+            int count = (int)packet - 126;
+            if (count > width - x || 4 > available - n) return 0;
+            uint32_t v;
+            memcpy(&v, in + n, 4);
+            n += 4;
+            for (int i = 0; i < count; i++) p[x + i] = v;
+            x += count;
+        }
+    }
+    return n;
+}
+
+static bool decode_raw(const FrameStreamReader* reader, Canvas* canvas, size_t size) {
+    size_t row_bytes = (size_t)reader->width * sizeof(Color);
+    if (size != row_bytes * reader->height) return false;
+    for (int y = 0; y < reader->height; y++) {
+        memcpy(canvas_row(canvas, y), reader->payload + (size_t)y * row_bytes, row_bytes);
+    }
+    return true;
+}
+
+static bool decode_rle(const FrameStreamReader* reader, Canvas* canvas, size_t size) {
+    size_t n = 0;
+    for (int y = 0; y < reader->height; y++) {
+        size_t used = rle_decode_row(canvas_row(canvas, y), reader->width, reader->payload + n, size - n);
+        if (used == 0) return false;
+        n += used;
+    }
+    return n == size;
+}
+
+static bool decode_delta(const FrameStreamReader* reader, Canvas* canvas, size_t size) {
+    int columns = tiles_across(reader->width), rows = tiles_across(reader->height);
+    size_t n = ((size_t)columns * rows + 7) / 8;
+    if (size < n) return false;
+    const uint8_t* map = reader->payload;
+    for (int ty = 0; ty < rows; ty++) {
+        int y0 = ty * FRAME_STREAM_TILE;
+        int h = reader->height - y0 < FRAME_STREAM_TILE ? reader->height - y0 : FRAME_STREAM_TILE;
+        for (int tx = 0; tx < columns; tx++) {
+            size_t t = (size_t)ty * columns + tx;
+            if (!(map[t / 8] >> (t % 8) & 1)) continue;
+            int x0 = tx * FRAME_STREAM_TILE;
+            int w = reader->width - x0 < FRAME_STREAM_TILE ? reader->width - x0 : FRAME_STREAM_TILE;
+            for (int y = y0; y < y0 + h; y++) {
+                size_t used = rle_decode_row(canvas_row(canvas, y) + x0, w, reader->payload + n, size - n);
+                if (used == 0) return false;
+                n += used;
+            }
+        }
+    }
+    return n == size;
+}
+
+bool frame_stream_read(FrameStreamReader* reader, Canvas* canvas) {
+    if (!reader || !canvas || reader->failed) return false;
+    if (canvas->width != reader->width || canvas->height != reader->height) return false;
+
+    uint8_t prefix[4];
+    if (!read_fully(reader, prefix, sizeof(prefix))) return false;
+    size_t size = get_u32(prefix);
+    if (size > max_payload(reader->format, reader->width, reader->height)) {
+        reader->failed = true;
+        return false;
+    }
+    if (size > reader->capacity) {
+        uint8_t* payload = realloc(reader->payload, size);
+        if (!payload) {
+            reader->failed = true;
+            return false;
+        }
+        reader->payload = payload;
+        reader->capacity = size;
+    }
+    if (!read_fully(reader, reader->payload, size)) {
+        reader->failed = true;
+        return false;
+    }
+
+    bool ok;
+    switch (reader->format) {
+    case FRAME_STREAM_RAW:
+        ok = decode_raw(reader, canvas, size);
+        break;
+    case FRAME_STREAM_RLE:
+        ok = decode_rle(reader, canvas, size);
+        break;
+    default:
+        ok = decode_delta(reader, canvas, size);
+        break;
+    }
+    if (!ok) reader->failed = true;
+    return ok;
+}
+
+bool frame_stream_reader_close(FrameStreamReader* reader) {
+    if (!reader) return false;
+    bool ok = !reader->failed;
+    free(reader->payload);
+    free(reader);
+    return ok;
+}
@@ -0,0 +1,65 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "canvas.h"
+
+// Writes canvas frames to a file descriptor as one continuous stream, so
+// an animation can be piped straight into an encoder (ffmpeg -f
+// image2pipe or -f yuv4mpegpipe) or kept in a single file. Output goes out
+// in large buffered or vectored writes.
+//
+// PPM and Y4M see premultiplied color, i.e. the frame over black.
+//
+// RAW, RLE and DELTA streams start with a 16-byte little-endian header:
+//   "CNVS", u8 version (1), u8 encoding (0 raw, 1 rle, 2 delta), u16 fps,
+//   u32 width, u32 height
+// and each frame is a u32 payload size followed by the payload. RAW
+// payloads are rows of premultiplied RGBA. RLE rows are packets opened by
+// a byte n: below 128, n + 1 literal pixels follow; otherwise the single
+// pixel that follows repeats n - 126 times. Packets never span rows.
+//
+// DELTA frames are cut into FRAME_STREAM_TILE square tiles, clipped at the
+// right and bottom edges. A payload starts with a tile map, one bit per
+// tile in row-major order, lowest bit first, padded to a whole byte. The
+// rows of each tile whose bit is set follow in map order, RLE-packed as
+// above. The first frame sets every tile, later ones only the tiles that
+// changed. Changes are found by comparing 64-bit tile hashes, so a change
+// that keeps a tile's hash, at odds of about 2^-64, goes unsent.
+typedef enum {
+    FRAME_STREAM_PPM,       // binary P6 images back to back
+    FRAME_STREAM_Y4M,       // YUV4MPEG2, 4:2:0, BT.601 studio range
+    FRAME_STREAM_RAW,
+    FRAME_STREAM_RLE,
+    FRAME_STREAM_DELTA
+} FrameStreamFormat;
+
+#define FRAME_STREAM_TILE 32
+
+typedef struct FrameStream FrameStream;
+
+// Writes the stream header, if the format has one. Every frame must be
+// width x height.
+FrameStream* frame_stream_open(int fd, FrameStreamFormat format, int width, int height, int fps);
+bool frame_stream_write(FrameStream* stream, const Canvas* canvas);
+// Flushes and frees the stream; the descriptor stays open. Returns false
+// if any write failed.
+bool frame_stream_close(FrameStream* stream);
+
+// Reads RAW, RLE and DELTA streams back into canvases.
+typedef struct FrameStreamReader FrameStreamReader;
+
+// Reads and checks the stream header.
+FrameStreamReader* frame_stream_reader_open(int fd);
+int frame_stream_reader_width(const FrameStreamReader* reader);
+int frame_stream_reader_height(const FrameStreamReader* reader);
+int frame_stream_reader_fps(const FrameStreamReader* reader);
+// Decodes the next frame into canvas, which must be width x height. DELTA
+// frames only write the tiles that changed, so pass the same canvas every
+// time. Returns false at the end of the stream or on a read or format
+// error.
+bool frame_stream_read(FrameStreamReader* reader, Canvas* canvas);
+// Frees the reader; the descriptor stays open. Returns false if the
+// stream was cut short or malformed.
+bool frame_stream_reader_close(FrameStreamReader* reader);
+
+#endif // STREAM_H
@@ -0,0 +1,266 @@
+#include "surface.h"
+#include "span.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Pixels per pass when a row goes through a temporary RGBA buffer.
+#define SURFACE_CHUNK 256
+
+typedef void (*RowFn)(void* dst, const void* src, size_t count);
+
+static const int format_sizes[PIXEL_FORMAT_COUNT] = {4, 4, 2, 1};
+static const char* const format_names[PIXEL_FORMAT_COUNT] = {
+    "rgba8888", "bgra8888", "rgb565", "a8"
+};
+
+int pixel_format_size(PixelFormat format) {
+    return format < PIXEL_FORMAT_COUNT ? format_sizes[format] : 0;
+}
+
+const char* pixel_format_name(PixelFormat format) {
+    return format < PIXEL_FORMAT_COUNT ? format_names[format] : "unknown";
+}
+
+size_t pixel_format_stride(PixelFormat format, int width) {
+    size_t bytes = (size_t)width * pixel_format_size(format);
+    return (bytes + CANVAS_ROW_ALIGN - 1) / CANVAS_ROW_ALIGN * CANVAS_ROW_ALIGN;
+}
+
+Surface* surface_create(int width, int height, PixelFormat format) {
+    if (width <= 0 || height <= 0 || format >= PIXEL_FORMAT_COUNT) return NULL;
+
+    Surface* surface = malloc(sizeof(Surface));
+    if (!surface) return NULL;
+    surface->stride = pixel_format_stride(format, width);
+    surface->pixels = aligned_alloc(CANVAS_ROW_ALIGN, surface->stride * height);
+    if (!surface->pixels) {
+        free(surface);
+        return NULL;
+    }
+    memset(surface->pixels, 0, surface->stride * height);
+    surface->width = width;
+    surface->height = height;
+    surface->format = format;
+    return surface;
+}
+
+void surface_destroy(Surface* surface) {
+    if (!surface) return;
+    free(surface->pixels);
+    free(surface);
+}
+
+Surface surface_from_canvas(const Canvas* canvas) {
+    Surface s = {
+        canvas->width, canvas->height, PIXEL_FORMAT_RGBA8888,
+        canvas->stride, (uint8_t*)canvas->pixels
+    };
+    return s;
+}
+
+// Same rounding as the span kernels.
+static inline uint8_t mul_div255(unsigned x, unsigned y) {
+    unsigned t = x * y + 128;
+    return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+static inline uint16_t pack_565(unsigned r, unsigned g, unsigned b) {
+    return (uint16_t)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | (b * 31 + 127) / 255);
+}
+
+// Converters, named source_to_destination.
+
+static void copy_32(void* dst, const void* src, size_t count) {
+    memcpy(dst, src, count * 4);
+}
+
+static void copy_16(void* dst, const void* src, size_t count) {
+    memcpy(dst, src, count * 2);
+}
+
+static void copy_8(void* dst, const void* src, size_t count) {
+    memcpy(dst, src, count);
+}
+
+// RGBA to BGRA and back.
+static void swap_red_blue(void* dst, const void* src, size_t count) {
+    uint8_t* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i++, d += 4, s += 4) {
+        uint8_t r = s[0], b = s[2];
+        d[0] = b;
+        d[1] = s[1];
+        d[2] = r;
+        d[3] = s[3];
+    }
+}
+
+static void rgba_to_565(void* dst, const void* src, size_t count) {
+    uint16_t* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i++, s += 4) {
+        d[i] = pack_565(s[0], s[1], s[2]);
+    }
+}
+
+static void bgra_to_565(void* dst, const void* src, size_t count) {
+    uint16_t* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i++, s += 4) {
+        d[i] = pack_565(s[2], s[1], s[0]);
+    }
+}
+
+static void color32_to_a8(void* dst, const void* src, size_t count) {
+    uint8_t* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i++) {
+        d[i] = s[4 * i + 3];
+    }
+}
+
+static void rgb565_to_rgba(void* dst, const void* src, size_t count) {
+    uint8_t* d = dst;
+    const uint16_t* s = src;
+    for (size_t i = 0; i < count; i++, d += 4) {
+        unsigned p = s[i];
+        d[0] = (uint8_t)(((p >> 11) * 527 + 23) >> 6);
+        d[1] = (uint8_t)((((p >> 5) & 63) * 259 + 33) >> 6);
+        d[2] = (uint8_t)(((p & 31) * 527 + 23) >> 6);
+        d[3] = 255;
+    }
+}
+
+static void rgb565_to_bgra(void* dst, const void* src, size_t count) {
+    rgb565_to_rgba(dst, src, count);
+    swap_red_blue(dst, dst, count);
+}
+
+static void rgb565_to_a8(void* dst, const void* src, size_t count) {
+    (void)src;
+    memset(dst, 255, count);
+}
+
+// White at the given coverage, premultiplied, reads the same either order.
+static void a8_to_color32(void* dst, const void* src, size_t count) {
+    uint8_t* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i++, d += 4) {
+        d[0] = d[1] = d[2] = d[3] = s[i];
+    }
+}
+
+static void a8_to_565(void* dst, const void* src, size_t count) {
+    uint16_t* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i++) {
+        d[i] = pack_565(s[i], s[i], s[i]);
+    }
+}
+
+static const RowFn convert_rows[PIXEL_FORMAT_COUNT][PIXEL_FORMAT_COUNT] = {
+    [PIXEL_FORMAT_RGBA8888] = {copy_32, swap_red_blue, rgba_to_565, color32_to_a8},
+    [PIXEL_FORMAT_BGRA8888] = {swap_red_blue, copy_32, bgra_to_565, color32_to_a8},
+    [PIXEL_FORMAT_RGB565] = {rgb565_to_rgba, rgb565_to_bgra, copy_16, rgb565_to_a8},
+    [PIXEL_FORMAT_A8] = {a8_to_color32, a8_to_color32, a8_to_565, copy_8},
+};
+
+// Blenders. 32-bit destinations blend in place; the source is first
+// brought to the destination's channel order when it differs.
+
+static void blend_same_order(void* dst, const void* src, size_t count) {
+    span_blend_row(dst, src, count);
+}
+
+static void blend_converted(void* dst, const void* src, size_t count, RowFn convert, int src_size) {
+    Color tmp[SURFACE_CHUNK];
+    Color* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i += SURFACE_CHUNK) {
+        size_t n = count - i < SURFACE_CHUNK ? count - i : SURFACE_CHUNK;
+        convert(tmp, s + i * src_size, n);
+        span_blend_row(d + i, tmp, n);
+    }
+}
+
+static void blend_swapped(void* dst, const void* src, size_t count) {
+    blend_converted(dst, src, count, swap_red_blue, 4);
+}
+
+static void blend_a8_to_color32(void* dst, const void* src, size_t count) {
+    blend_converted(dst, src, count, a8_to_color32, 1);
+}
+
+// RGB565 destinations are widened to RGBA, blended and packed again.
+static void blend_onto_565(void* dst, const void* src, size_t count, RowFn to_rgba, int src_size) {
+    Color under[SURFACE_CHUNK], over[SURFACE_CHUNK];
+    uint16_t* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i += SURFACE_CHUNK) {
+        size_t n = count - i < SURFACE_CHUNK ? count - i : SURFACE_CHUNK;
+        rgb565_to_rgba(under, d + i, n);
+        to_rgba(over, s + i * src_size, n);
+        span_blend_row(under, over, n);
+        rgba_to_565(d + i, under, n);
+    }
+}
+
+static void blend_rgba_to_565(void* dst, const void* src, size_t count) {
+    blend_onto_565(dst, src, count, copy_32, 4);
+}
+
+static void blend_bgra_to_565(void* dst, const void* src, size_t count) {
+    blend_onto_565(dst, src, count, swap_red_blue, 4);
+}
+
+static void blend_a8_to_565(void* dst, const void* src, size_t count) {
+    blend_onto_565(dst, src, count, a8_to_color32, 1);
+}
+
+static void blend_alpha(uint8_t* d, const uint8_t* s, size_t count, int src_size) {
+    for (size_t i = 0; i < count; i++, s += src_size) {
+        unsigned a = *s;
+        d[i] = (uint8_t)(a + mul_div255(d[i], 255 - a));
+    }
+}
+
+static void blend_color32_to_a8(void* dst, const void* src, size_t count) {
+    blend_alpha(dst, (const uint8_t*)src + 3, count, 4);
+}
+
+static void blend_a8_to_a8(void* dst, const void* src, size_t count) {
+    blend_alpha(dst, src, count, 1);
+}
+
+// RGB565 sources are opaque, so blending them is converting.
+static const RowFn blend_rows[PIXEL_FORMAT_COUNT][PIXEL_FORMAT_COUNT] = {
+    [PIXEL_FORMAT_RGBA8888] = {blend_same_order, blend_swapped, blend_rgba_to_565, blend_color32_to_a8},
+    [PIXEL_FORMAT_BGRA8888] = {blend_swapped, blend_same_order, blend_bgra_to_565, blend_color32_to_a8},
+    [PIXEL_FORMAT_RGB565] = {rgb565_to_rgba, rgb565_to_bgra, copy_16, rgb565_to_a8},
+    [PIXEL_FORMAT_A8] = {blend_a8_to_color32, blend_a8_to_color32, blend_a8_to_565, blend_a8_to_a8},
+};
+
+static void apply_rows(Surface* dst, const Surface* src, int x, int y, RowFn fn) {
+    int x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int x1 = src->width > dst->width - x ? dst->width : x + src->width;
+    int y1 = src->height > dst->height - y ? dst->height : y + src->height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    int dst_size = pixel_format_size(dst->format), src_size = pixel_format_size(src->format);
+    for (int row = y0; row < y1; row++) {
+        uint8_t* d = (uint8_t*)surface_row(dst, row) + (size_t)x0 * dst_size;
+        const uint8_t* s = (const uint8_t*)surface_row(src, row - y) + (size_t)(x0 - x) * src_size;
+        fn(d, s, (size_t)(x1 - x0));
+    }
+}
+
+void surface_convert(Surface* dst, const Surface* src, int x, int y) {
+    if (!dst || !src || dst->format >= PIXEL_FORMAT_COUNT || src->format >= PIXEL_FORMAT_COUNT) return;
+    apply_rows(dst, src, x, y, convert_rows[src->format][dst->format]);
+}
+
+void surface_blend(Surface* dst, const Surface* src, int x, int y) {
+    if (!dst || !src || dst->format >= PIXEL_FORMAT_COUNT || src->format >= PIXEL_FORMAT_COUNT) return;
+    apply_rows(dst, src, x, y, blend_rows[src->format][dst->format]);
+}
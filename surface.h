@@ -0,0 +1,52 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "canvas.h"
+
+// Pixel buffers in formats other than the canvas' own, for passes that
+// need less than four bytes a pixel: coverage masks, thumbnails, or
+// output for a display. Rows start CANVAS_ROW_ALIGN bytes apart.
+//
+// RGBA8888 and BGRA8888 hold premultiplied color, like Canvas. RGB565 is
+// opaque. A8 holds alpha or coverage alone.
+typedef enum {
+    PIXEL_FORMAT_RGBA8888,
+    PIXEL_FORMAT_BGRA8888,
+    PIXEL_FORMAT_RGB565,
+    PIXEL_FORMAT_A8,
+    PIXEL_FORMAT_COUNT
+} PixelFormat;
+
+typedef struct {
+    int width;
+    int height;
+    PixelFormat format;
+    size_t stride;          // bytes from one row to the next
+    uint8_t* pixels;
+} Surface;
+
+int pixel_format_size(PixelFormat format);
+const char* pixel_format_name(PixelFormat format);
+// Row size rounded up to CANVAS_ROW_ALIGN.
+size_t pixel_format_stride(PixelFormat format, int width);
+
+Surface* surface_create(int width, int height, PixelFormat format);
+void surface_destroy(Surface* surface);
+// An RGBA8888 view of the canvas' pixels; nothing is copied.
+Surface surface_from_canvas(const Canvas* canvas);
+
+static inline void* surface_row(const Surface* surface, int y) {
+    return surface->pixels + (size_t)y * surface->stride;
+}
+
+// Both take src's pixels to dst with src's corner at (x, y), clipped to
+// dst. Convert replaces dst pixels; blend draws src over them. Formats
+// without alpha read as opaque. A8 reads as white at that coverage, and
+// keeps only alpha when written. RGB565 drops alpha when written, which
+// for premultiplied color is drawing over black.
+void surface_convert(Surface* dst, const Surface* src, int x, int y);
+void surface_blend(Surface* dst, const Surface* src, int x, int y);
+
+#endif // SURFACE_H
@@ -0,0 +1,331 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "terminal.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+// "\033[38;2;255;255;255m" and its terminator.
+#define TERM_MAX_SGR 20
+// Most bytes one cell can cost: a cursor jump of up to 24 bytes, then a
+// color and a glyph, each copied whole from its table.
+#define TERM_CELL_BYTES (24 + TERM_MAX_SGR + TERM_MAX_GLYPH)
+// Unchanged stretches up to this long may be written over again instead
+// of jumped, when their glyphs cost no more bytes than the jump.
+#define TERM_MAX_REWRITE 4
+#define TERM_DEFAULT_GRAY 200
+#define TERM_UNKNOWN_GLYPH "?"
+
+typedef struct {
+    char bytes[TERM_MAX_SGR];
+    uint8_t length;
+} TermSgr;
+
+typedef struct {
+    char bytes[TERM_MAX_GLYPH];
+    uint8_t length;
+} TermGlyph;
+
+struct TermScreen {
+    TermFrame frame;
+    // What the terminal shows, valid unless a repaint is due.
+    uint8_t* shown_glyphs;
+    uint8_t* shown_colors;
+    bool valid;
+    int top;
+    int left;
+    TermSgr palette[TERM_PALETTE_SIZE];
+    TermGlyph glyphs[TERM_GLYPH_COUNT];
+    char* out;              // room for a frame of every cell changed
+};
+
+static void free_cells(TermScreen* screen) {
+    free(screen->frame.glyphs);
+    free(screen->frame.colors);
+    free(screen->shown_glyphs);
+    free(screen->shown_colors);
+    free(screen->out);
+}
+
+TermScreen* term_screen_create(int width, int height, int top, int left) {
+    if (top < 1 || left < 1) return NULL;
+    TermScreen* screen = calloc(1, sizeof(TermScreen));
+    if (!screen) return NULL;
+    screen->top = top;
+    screen->left = left;
+    for (int i = 0; i < TERM_PALETTE_SIZE; i++) {
+        term_screen_set_color(screen, i, TERM_DEFAULT_GRAY, TERM_DEFAULT_GRAY, TERM_DEFAULT_GRAY);
+    }
+    for (int i = 0; i < TERM_GLYPH_COUNT; i++) {
+        char ascii[2] = {(char)i, '\0'};
+        term_screen_set_glyph(screen, i, i >= 0x20 && i < 0x7f ? ascii : TERM_UNKNOWN_GLYPH);
+    }
+    if (!term_screen_resize(screen, width, height)) {
+        free(screen);
+        return NULL;
+    }
+    return screen;
+}
+
+void term_screen_destroy(TermScreen* screen) {
+    if (!screen) return;
+    free_cells(screen);
+    free(screen);
+}
+
+bool term_screen_resize(TermScreen* screen, int width, int height) {
+    if (!screen || width <= 0 || height <= 0) return false;
+    size_t cells = (size_t)width * height;
+    TermScreen next = *screen;
+    next.frame.glyphs = malloc(cells);
+    next.frame.colors = malloc(cells);
+    next.shown_glyphs = malloc(cells);
+    next.shown_colors = malloc(cells);
+    next.out = malloc(cells * TERM_CELL_BYTES);
+    if (!next.frame.glyphs || !next.frame.colors || !next.shown_glyphs || !next.shown_colors || !next.out) {
+        free_cells(&next);
+        return false;
+    }
+    free_cells(screen);
+    *screen = next;
+    screen->frame.width = width;
+    screen->frame.height = height;
+    screen->valid = false;
+    term_screen_clear(screen);
+    return true;
+}
+
+void term_screen_invalidate(TermScreen* screen) {
+    if (screen) screen->valid = false;
+}
+
+void term_screen_set_color(TermScreen* screen, int index, uint8_t r, uint8_t g, uint8_t b) {
+    if (!screen || index < 0 || index >= TERM_PALETTE_SIZE) return;
+    TermSgr* sgr = &screen->palette[index];
+    sgr->length = (uint8_t)snprintf(sgr->bytes, sizeof(sgr->bytes), "\033[38;2;%d;%d;%dm", r, g, b);
+}
+
+bool term_screen_set_glyph(TermScreen* screen, int index, const char* utf8) {
+    if (!screen || !utf8 || index < 0 || index >= TERM_GLYPH_COUNT) return false;
+    size_t length = strlen(utf8);
+    if (length == 0 || length > TERM_MAX_GLYPH) return false;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)utf8[i];
+        if (c < 0x20 || c == 0x7f) return false;
+    }
+    TermGlyph* glyph = &screen->glyphs[index];
+    memcpy(glyph->bytes, utf8, length);
+    glyph->length = (uint8_t)length;
+    // Cells showing the id are not tracked, so repaint them all.
+    screen->valid = false;
+    return true;
+}
+
+TermFrame* term_screen_frame(TermScreen* screen) {
+    return screen ? &screen->frame : NULL;
+}
+
+void term_screen_clear(TermScreen* screen) {
+    if (!screen) return;
+    size_t cells = (size_t)screen->frame.width * screen->frame.height;
+    memset(screen->frame.glyphs, TERM_BLANK, cells);
+    memset(screen->frame.colors, 0, cells);
+}
+
+static char* put_uint(char* p, unsigned value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n) *p++ = digits[--n];
+    return p;
+}
+
+static int uint_digits(unsigned value) {
+    int n = 1;
+    while (value >= 10) {
+        value /= 10;
+        n++;
+    }
+    return n;
+}
+
+static bool write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+long term_screen_present(TermScreen* screen, int fd) {
+    if (!screen) return -1;
+    const TermFrame* f = &screen->frame;
+    char* p = screen->out;
+    // Where the cursor is and which color is set, or -1 when unknown: other
+    // output may have run since the last frame.
+    int cursor_x = -1, cursor_y = -1, color = -1;
+
+    // Glyphs and colors are copied at their full table width and the output
+    // advanced by their length: a fixed-size copy is a store or two, and the
+    // bytes past the end are overwritten by what follows. Each cell's share
+    // of the buffer leaves room for the overshoot.
+    for (int y = 0; y < f->height; y++) {
+        const uint8_t* glyphs = f->glyphs + (size_t)y * f->width;
+        const uint8_t* colors = f->colors + (size_t)y * f->width;
+        uint8_t* shown_glyphs = screen->shown_glyphs + (size_t)y * f->width;
+        uint8_t* shown_colors = screen->shown_colors + (size_t)y * f->width;
+
+        for (int x = 0; x < f->width; x++) {
+            uint8_t g = glyphs[x];
+            uint8_t c = colors[x];
+            if (screen->valid && g == shown_glyphs[x] && (g == TERM_BLANK || c == shown_colors[x])) continue;
+            shown_glyphs[x] = g;
+            shown_colors[x] = c;
+
+            if (cursor_y == y && cursor_x >= 0 && x > cursor_x) {
+                // A short stretch that needs no color change and is no
+                // longer than the jump is written again instead.
+                int gap = x - cursor_x;
+                int jump = 3 + uint_digits((unsigned)gap), bytes = 0;
+                bool rewrite = gap <= TERM_MAX_REWRITE;
+                for (int k = cursor_x; rewrite && k < x; k++) {
+                    bytes += screen->glyphs[glyphs[k]].length;
+                    rewrite = bytes <= jump && (glyphs[k] == TERM_BLANK || colors[k] == color);
+                }
+                if (rewrite) {
+                    for (int k = cursor_x; k < x; k++) {
+                        const TermGlyph* glyph = &screen->glyphs[glyphs[k]];
+                        memcpy(p, glyph->bytes, TERM_MAX_GLYPH);
+                        p += glyph->length;
+                    }
+                } else {
+                    *p++ = '\033';
+                    *p++ = '[';
+                    p = put_uint(p, (unsigned)gap);
+                    *p++ = 'C';
+                }
+            } else if (cursor_y != y || cursor_x != x) {
+                *p++ = '\033';
+                *p++ = '[';
+                p = put_uint(p, (unsigned)(screen->top + y));
+                *p++ = ';';
+                p = put_uint(p, (unsigned)(screen->left + x));
+                *p++ = 'H';
+            }
+
+            if (g != TERM_BLANK && c != color) {
+                const TermSgr* sgr = &screen->palette[c];
+                memcpy(p, sgr->bytes, TERM_MAX_SGR);
+                p += sgr->length;
+                color = c;
+            }
+            const TermGlyph* glyph = &screen->glyphs[g];
+            memcpy(p, glyph->bytes, TERM_MAX_GLYPH);
+            p += glyph->length;
+            // Past the last column the terminal may wrap or hold the
+            // cursor, so forget where it is.
+            cursor_x = x + 1 < f->width ? x + 1 : -1;
+            cursor_y = y;
+        }
+    }
+    screen->valid = true;
+
+    size_t length = (size_t)(p - screen->out);
+    if (fd >= 0 && length > 0 && !write_all(fd, screen->out, length)) {
+        screen->valid = false;
+        return -1;
+    }
+    return (long)length;
+}
+
+// Raw mode is per terminal rather than per screen, so it is kept here.
+static struct termios saved_mode;
+static int raw_fd = -1;
+static int mouse_fd = -1;
+static bool restore_registered;
+
+#define TERM_MOUSE_ON "\033[?1000h\033[?1006h"
+#define TERM_MOUSE_OFF "\033[?1006l\033[?1000l"
+#define TERM_MOUSE_PREFIX "\033[<"
+
+bool term_raw_mode(int fd) {
+    if (raw_fd >= 0) return raw_fd == fd;
+    struct termios mode;
+    if (tcgetattr(fd, &mode) != 0) return false;
+    saved_mode = mode;
+    mode.c_iflag &= ~(tcflag_t)(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    mode.c_lflag &= ~(tcflag_t)(ECHO | ICANON | IEXTEN | ISIG);
+    mode.c_cflag |= CS8;
+    // Reads return as soon as one byte is in; callers poll before reading.
+    mode.c_cc[VMIN] = 1;
+    mode.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSAFLUSH, &mode) != 0) return false;
+    raw_fd = fd;
+    if (!restore_registered) restore_registered = atexit(term_restore) == 0;
+    return true;
+}
+
+bool term_mouse_reporting(int fd) {
+    if (mouse_fd >= 0) return mouse_fd == fd;
+    if (!isatty(fd) || !write_all(fd, TERM_MOUSE_ON, sizeof(TERM_MOUSE_ON) - 1)) return false;
+    mouse_fd = fd;
+    if (!restore_registered) restore_registered = atexit(term_restore) == 0;
+    return true;
+}
+
+void term_restore(void) {
+    if (mouse_fd >= 0) {
+        write_all(mouse_fd, TERM_MOUSE_OFF, sizeof(TERM_MOUSE_OFF) - 1);
+        mouse_fd = -1;
+    }
+    if (raw_fd < 0) return;
+    tcsetattr(raw_fd, TCSAFLUSH, &saved_mode);
+    raw_fd = -1;
+}
+
+int term_parse_mouse(const char* bytes, size_t length, TermMouse* event) {
+    const size_t prefix = sizeof(TERM_MOUSE_PREFIX) - 1;
+    size_t i = 0;
+    for (; i < prefix; i++) {
+        if (i == length) return -1;
+        if (bytes[i] != TERM_MOUSE_PREFIX[i]) return 0;
+    }
+    // Three decimal fields; anything else means it wasn't a report.
+    int fields[3] = {0, 0, 0};
+    for (int k = 0; k < 3; k++) {
+        size_t start = i;
+        while (i < length && bytes[i] >= '0' && bytes[i] <= '9') {
+            if (fields[k] > 99999) return 0;
+            fields[k] = fields[k] * 10 + (bytes[i++] - '0');
+        }
+        if (i == length) return -1;
+        if (i == start) return 0;
+        char end = bytes[i++];
+        if (k < 2 ? end != ';' : end != 'M' && end != 'm') return 0;
+        if (k == 2 && event) {
+            *event = (TermMouse){fields[0], fields[1], fields[2], end == 'M'};
+        }
+    }
+    return (int)i;
+}
+
+bool term_window_size(int fd, int* columns, int* rows) {
+    struct winsize size;
+    if (ioctl(fd, TIOCGWINSZ, &size) != 0 || size.ws_col == 0 || size.ws_row == 0) return false;
+    if (columns) *columns = size.ws_col;
+    if (rows) *rows = size.ws_row;
+    return true;
+}
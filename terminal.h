@@ -0,0 +1,86 @@
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A grid of character cells mirrored to a terminal. The screen remembers
+// what the terminal shows, and presenting a frame sends only the cells that
+// changed: a cursor jump over each unchanged stretch, one color sequence
+// per run of equal color, and the whole frame in one write(). Over SSH or
+// tmux the bytes sent bound the frame rate, and an unchanged frame sends
+// none.
+typedef struct TermScreen TermScreen;
+
+// Most colors in a screen's palette, and glyphs in its glyph table.
+#define TERM_PALETTE_SIZE 256
+#define TERM_GLYPH_COUNT 256
+// Longest UTF-8 sequence one glyph may be: a code point and a combining
+// mark or variation selector.
+#define TERM_MAX_GLYPH 8
+// The blank glyph, a space.
+#define TERM_BLANK ' '
+
+// The frame being drawn. Cells hold glyph ids, indexes into the screen's
+// table of UTF-8 sequences; ids of printable ASCII start out as that
+// character, so ' ' and '*' can be drawn as they are. Blank cells show no
+// color, so their color is ignored.
+typedef struct {
+    int width;
+    int height;
+    uint8_t* glyphs;        // glyph id of each cell, row by row
+    uint8_t* colors;        // palette index of each cell
+} TermFrame;
+
+// The grid sits with its top-left cell at terminal row top, column left,
+// both counting from 1. Every palette color starts out light gray.
+TermScreen* term_screen_create(int width, int height, int top, int left);
+void term_screen_destroy(TermScreen* screen);
+// Clears the frame and repaints everything at the next present.
+bool term_screen_resize(TermScreen* screen, int width, int height);
+// After anything else drew over the terminal.
+void term_screen_invalidate(TermScreen* screen);
+void term_screen_set_color(TermScreen* screen, int index, uint8_t r, uint8_t g, uint8_t b);
+// Makes glyph id index show utf8, one cell wide. Fails when the sequence
+// is empty, longer than TERM_MAX_GLYPH or holds control characters, which
+// would move the cursor. Cells already showing the id are redrawn.
+bool term_screen_set_glyph(TermScreen* screen, int index, const char* utf8);
+
+// The next frame, to draw into. It keeps its contents between presents.
+TermFrame* term_screen_frame(TermScreen* screen);
+// Blanks the whole frame.
+void term_screen_clear(TermScreen* screen);
+
+// Sends the changes since the last present to fd, or only counts them
+// when fd is negative. Returns the bytes of the update, or -1 when the
+// write failed, in which case the next present repaints everything.
+long term_screen_present(TermScreen* screen, int fd);
+
+// Puts the terminal on fd in raw mode: keys arrive byte by byte as they
+// are typed, unechoed, and Ctrl-C is a byte rather than a signal. The
+// previous mode comes back with term_restore, or at exit. Fails when fd is
+// not a terminal.
+bool term_raw_mode(int fd);
+void term_restore(void);
+// Asks the terminal on fd to report mouse buttons as SGR sequences on its
+// input. term_restore, or exit, turns reporting off again.
+bool term_mouse_reporting(int fd);
+
+// A mouse button going down or up, at a cell counting from 1.
+typedef struct {
+    int button;             // 0 left, 1 middle, 2 right, 64 and up the wheel
+    int x;
+    int y;
+    bool press;
+} TermMouse;
+
+// Parses the SGR mouse report "\033[<b;x;yM" (press) or "...m" (release)
+// at the start of bytes. Returns the bytes it spans; 0 when bytes don't
+// start a report; -1 when they are the start of one cut short, and more
+// input should be read before deciding.
+int term_parse_mouse(const char* bytes, size_t length, TermMouse* event);
+// The size of the terminal on fd, in cells.
+bool term_window_size(int fd, int* columns, int* rows);
+
+#endif // TERMINAL_H
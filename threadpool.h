@@ -0,0 +1,19 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Fixed set of worker threads running parallel-for style jobs. The calling
+// thread takes part in every job, so a pool of size 1 runs inline.
+typedef struct ThreadPool ThreadPool;
+
+typedef void (*ThreadPoolTask)(void* context, int index);
+
+// thread_count <= 0 uses one thread per online CPU.
+ThreadPool* threadpool_create(int thread_count);
+void threadpool_destroy(ThreadPool* pool);
+int threadpool_size(const ThreadPool* pool);
+
+// Calls task(context, i) for every i in [0, count) and returns when all
+// calls have finished. Indices are handed out dynamically.
+void threadpool_run(ThreadPool* pool, int count, ThreadPoolTask task, void* context);
+
+#endif // THREADPOOL_H
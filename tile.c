@@ -0,0 +1,238 @@
+#include "tile.h"
+#include "atlas.h"
+#include "canvas_cmd.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t* items;        // indices into the command list, in order
+    size_t count;
+    size_t capacity;
+} TileBin;
+
+// Atlases aren't thread safe, so each tile being rasterized claims one of
+// its own: at most a pool's worth run at once.
+typedef struct {
+    EmojiAtlas* atlas;
+    atomic_bool busy;
+} TileAtlas;
+
+struct TileRenderer {
+    CanvasRecorder recorder;
+    ThreadPool* pool;
+    Canvas* canvas;
+    int tile_size;
+    int tiles_x;
+    int tiles_y;
+
+    CanvasCmd* cmds;
+    size_t cmd_count;
+    size_t cmd_capacity;
+
+    TileBin* bins;
+    int bin_capacity;
+    int* active;            // tiles with at least one command
+    int active_count;
+    bool failed;            // binning ran out of memory: draw this frame directly
+
+    TileAtlas* atlases;     // while the canvas has an atlas, one per thread
+    int atlas_count;
+};
+
+static bool grow(void** data, size_t* capacity, size_t needed, size_t elem) {
+    if (needed <= *capacity) return true;
+    size_t cap = *capacity ? *capacity : 64;
+    while (cap < needed) cap *= 2;
+    void* p = realloc(*data, cap * elem);
+    if (!p) return false;
+    *data = p;
+    *capacity = cap;
+    return true;
+}
+
+// Draws cmd straight onto the canvas, on the calling thread.
+static void draw_direct(TileRenderer* tr, const CanvasCmd* cmd) {
+    Canvas local = *tr->canvas;
+    local.recorder = NULL;
+    canvas_set_clip_box(&local, cmd->bounds);
+    canvas_cmd_execute(&local, cmd);
+}
+
+static void tile_record(CanvasRecorder* recorder, const Canvas* canvas, const CanvasCmd* cmd) {
+    TileRenderer* tr = (TileRenderer*)recorder;
+    (void)canvas;
+
+    if (tr->cmd_count >= UINT32_MAX ||
+        !grow((void**)&tr->cmds, &tr->cmd_capacity, tr->cmd_count + 1, sizeof(CanvasCmd))) {
+        // Nowhere to keep it: draw what came before, then the command itself.
+        tr->failed = true;
+        tile_renderer_flush(tr);
+        draw_direct(tr, cmd);
+        return;
+    }
+    uint32_t index = (uint32_t)tr->cmd_count++;
+    tr->cmds[index] = *cmd;
+    // Once a bin has missed a command, the flush ignores the bins.
+    if (tr->failed) return;
+
+    int ts = tr->tile_size;
+    int tx0 = cmd->bounds.x0 / ts, tx1 = (cmd->bounds.x1 - 1) / ts;
+    int ty0 = cmd->bounds.y0 / ts, ty1 = (cmd->bounds.y1 - 1) / ts;
+    for (int ty = ty0; ty <= ty1; ty++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            int tile = ty * tr->tiles_x + tx;
+            TileBin* bin = &tr->bins[tile];
+            if (!grow((void**)&bin->items, &bin->capacity, bin->count + 1, sizeof(uint32_t))) {
+                tr->failed = true;
+                return;
+            }
+            if (bin->count == 0) {
+                tr->active[tr->active_count++] = tile;
+            }
+            bin->items[bin->count++] = index;
+        }
+    }
+}
+
+static void rasterize_tile(void* context, int index) {
+    TileRenderer* tr = context;
+    int tile = tr->active[index];
+    TileBin* bin = &tr->bins[tile];
+
+    // A private copy of the canvas header lets every tile carry its own clip
+    // and atlas.
+    Canvas local = *tr->canvas;
+    local.recorder = NULL;
+    TileAtlas* claimed = NULL;
+    for (int i = 0; local.atlas && !claimed; i = (i + 1) % tr->atlas_count) {
+        bool idle = false;
+        if (atomic_compare_exchange_strong(&tr->atlases[i].busy, &idle, true)) claimed = &tr->atlases[i];
+    }
+    if (claimed) local.atlas = claimed->atlas;
+
+    int tx = tile % tr->tiles_x, ty = tile / tr->tiles_x;
+    CanvasBox box = {
+        tx * tr->tile_size, ty * tr->tile_size,
+        (tx + 1) * tr->tile_size, (ty + 1) * tr->tile_size
+    };
+    for (size_t i = 0; i < bin->count; i++) {
+        const CanvasCmd* cmd = &tr->cmds[bin->items[i]];
+        canvas_set_clip_box(&local, canvas_box_intersect(box, cmd->bounds));
+        canvas_cmd_execute(&local, cmd);
+    }
+    if (claimed) atomic_store(&claimed->busy, false);
+}
+
+static void free_atlases(TileRenderer* tr) {
+    for (int i = 0; i < tr->atlas_count; i++) {
+        emoji_atlas_destroy(tr->atlases[i].atlas);
+    }
+    free(tr->atlases);
+    tr->atlases = NULL;
+    tr->atlas_count = 0;
+}
+
+// Gives every thread an atlas the size of the canvas', so sprites that fit
+// in one fit in the other and the tiles blit what drawing directly would.
+static bool prepare_atlases(TileRenderer* tr, const Canvas* canvas) {
+    if (!canvas->atlas) return true;
+    const Canvas* shared = emoji_atlas_canvas(canvas->atlas);
+    if (tr->atlas_count > 0) {
+        const Canvas* own = emoji_atlas_canvas(tr->atlases[0].atlas);
+        if (own->width == shared->width && own->height == shared->height) return true;
+        free_atlases(tr);
+    }
+    int count = threadpool_size(tr->pool);
+    tr->atlases = calloc((size_t)count, sizeof(TileAtlas));
+    if (!tr->atlases) return false;
+    for (; tr->atlas_count < count; tr->atlas_count++) {
+        TileAtlas* slot = &tr->atlases[tr->atlas_count];
+        atomic_init(&slot->busy, false);
+        slot->atlas = emoji_atlas_create(shared->width, shared->height);
+        if (!slot->atlas) {
+            free_atlases(tr);
+            return false;
+        }
+    }
+    return true;
+}
+
+TileRenderer* tile_renderer_create(ThreadPool* pool, int tile_size) {
+    TileRenderer* tr = calloc(1, sizeof(TileRenderer));
+    if (!tr) return NULL;
+    tr->recorder.record = tile_record;
+    tr->pool = pool;
+    tr->tile_size = tile_size > 0 ? tile_size : TILE_DEFAULT_SIZE;
+    return tr;
+}
+
+void tile_renderer_destroy(TileRenderer* renderer) {
+    if (!renderer) return;
+    if (renderer->canvas) tile_renderer_end(renderer);
+    for (int i = 0; i < renderer->bin_capacity; i++) {
+        free(renderer->bins[i].items);
+    }
+    free(renderer->bins);
+    free(renderer->active);
+    free(renderer->cmds);
+    free_atlases(renderer);
+    free(renderer);
+}
+
+bool tile_renderer_begin(TileRenderer* renderer, Canvas* canvas) {
+    if (!renderer || !canvas || renderer->canvas || canvas->recorder) return false;
+
+    int ts = renderer->tile_size;
+    int tiles_x = (canvas->width + ts - 1) / ts;
+    int tiles_y = (canvas->height + ts - 1) / ts;
+    int tiles = tiles_x * tiles_y;
+    if (!prepare_atlases(renderer, canvas)) return false;
+
+    // Bins keep their storage between frames; only grow the set.
+    if (tiles > renderer->bin_capacity) {
+        TileBin* bins = realloc(renderer->bins, (size_t)tiles * sizeof(TileBin));
+        if (!bins) return false;
+        memset(bins + renderer->bin_capacity, 0,
+               (size_t)(tiles - renderer->bin_capacity) * sizeof(TileBin));
+        renderer->bins = bins;
+
+        int* active = realloc(renderer->active, (size_t)tiles * sizeof(int));
+        if (!active) return false;
+        renderer->active = active;
+        renderer->bin_capacity = tiles;
+    }
+
+    renderer->tiles_x = tiles_x;
+    renderer->tiles_y = tiles_y;
+    renderer->canvas = canvas;
+    canvas->recorder = &renderer->recorder;
+    return true;
+}
+
+void tile_renderer_flush(TileRenderer* renderer) {
+    if (!renderer || !renderer->canvas) return;
+
+    if (renderer->failed) {
+        for (size_t i = 0; i < renderer->cmd_count; i++) {
+            draw_direct(renderer, &renderer->cmds[i]);
+        }
+    } else {
+        threadpool_run(renderer->pool, renderer->active_count, rasterize_tile, renderer);
+    }
+
+    for (int i = 0; i < renderer->active_count; i++) {
+        renderer->bins[renderer->active[i]].count = 0;
+    }
+    renderer->active_count = 0;
+    renderer->cmd_count = 0;
+    renderer->failed = false;
+}
+
+void tile_renderer_end(TileRenderer* renderer) {
+    if (!renderer || !renderer->canvas) return;
+    tile_renderer_flush(renderer);
+    renderer->canvas->recorder = NULL;
+    renderer->canvas = NULL;
+}
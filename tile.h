@@ -0,0 +1,36 @@
+#ifndef TILE_H
+#define TILE_H
+
+#include "canvas.h"
+#include "threadpool.h"
+
+// Tile-parallel rasterization. While a canvas is attached, its draw calls
+// are binned into square tiles instead of being drawn. A flush rasterizes
+// the tiles concurrently; each tile replays its commands in submission
+// order, so the result is identical to drawing on one thread.
+//
+// Emoji atlases aren't thread safe, so while the canvas has one the
+// renderer keeps a private atlas of the same size per thread and tiles blit
+// and resample from those. Like the canvas' own, a private atlas gives up
+// on sprites while it is thrashing; an emoji set that thrashes may then be
+// drawn differently from immediate mode.
+typedef struct TileRenderer TileRenderer;
+
+#define TILE_DEFAULT_SIZE 128
+
+// pool may be NULL to rasterize on the calling thread. tile_size <= 0 picks
+// TILE_DEFAULT_SIZE, which keeps a tile's pixels within L2.
+TileRenderer* tile_renderer_create(ThreadPool* pool, int tile_size);
+void tile_renderer_destroy(TileRenderer* renderer);
+
+// Starts binning draw calls made on canvas. Fails if the canvas already has
+// a recorder attached, or its per-thread atlases can't be made.
+bool tile_renderer_begin(TileRenderer* renderer, Canvas* canvas);
+// Rasterizes everything binned so far; binning continues afterwards. If
+// binning ran out of memory, the commands are drawn in order on the calling
+// thread instead, with the same result.
+void tile_renderer_flush(TileRenderer* renderer);
+// Flushes and detaches from the canvas.
+void tile_renderer_end(TileRenderer* renderer);
+
+#endif // TILE_H
@@ -0,0 +1,235 @@
+#include "wave.h"
+#include "span.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WAVE_X86 1
+#include <immintrin.h>
+#endif
+
+// Rows start this many bytes apart at least, so they line up for vectors.
+#define WAVE_ROW_ALIGN 64
+// Rows per task when a step is split across threads.
+#define WAVE_BAND_ROWS 32
+
+// Heights sit inside a border of flat cells one wide, so the stencil never
+// checks for edges: cell (x, y) is at (y + 1) * stride + x + 1.
+struct WaveField {
+    int width;
+    int height;
+    size_t stride;          // floats
+    float* current;
+    float* previous;        // becomes the next heights during a step
+};
+
+typedef void (*WaveRow)(float* restrict next, const float* restrict current, const float* restrict up,
+                        const float* restrict down, int width, float damping);
+
+typedef struct {
+    WaveField* field;
+    WaveRow row;
+    float damping;
+} WaveStep;
+
+static float* alloc_plane(size_t floats) {
+    size_t bytes = (floats * sizeof(float) + WAVE_ROW_ALIGN - 1) / WAVE_ROW_ALIGN * WAVE_ROW_ALIGN;
+    float* plane = aligned_alloc(WAVE_ROW_ALIGN, bytes);
+    if (plane) memset(plane, 0, bytes);
+    return plane;
+}
+
+WaveField* wave_field_create(int width, int height) {
+    WaveField* field = calloc(1, sizeof(WaveField));
+    if (!field) return NULL;
+    if (!wave_field_resize(field, width, height)) {
+        free(field);
+        return NULL;
+    }
+    return field;
+}
+
+void wave_field_destroy(WaveField* field) {
+    if (!field) return;
+    free(field->current);
+    free(field->previous);
+    free(field);
+}
+
+bool wave_field_resize(WaveField* field, int width, int height) {
+    if (!field || width <= 0 || height <= 0) return false;
+    size_t per_row = WAVE_ROW_ALIGN / sizeof(float);
+    size_t stride = ((size_t)width + 2 + per_row - 1) / per_row * per_row;
+    size_t floats = stride * ((size_t)height + 2);
+    float* current = alloc_plane(floats);
+    float* previous = alloc_plane(floats);
+    if (!current || !previous) {
+        free(current);
+        free(previous);
+        return false;
+    }
+    free(field->current);
+    free(field->previous);
+    field->width = width;
+    field->height = height;
+    field->stride = stride;
+    field->current = current;
+    field->previous = previous;
+    return true;
+}
+
+void wave_field_clear(WaveField* field) {
+    if (!field) return;
+    size_t floats = field->stride * ((size_t)field->height + 2);
+    memset(field->current, 0, floats * sizeof(float));
+    memset(field->previous, 0, floats * sizeof(float));
+}
+
+int wave_field_width(const WaveField* field) {
+    return field ? field->width : 0;
+}
+
+int wave_field_height(const WaveField* field) {
+    return field ? field->height : 0;
+}
+
+static float* cell(float* plane, const WaveField* field, int x, int y) {
+    return plane + (size_t)(y + 1) * field->stride + (size_t)x + 1;
+}
+
+const float* wave_field_row(const WaveField* field, int y) {
+    if (!field || y < 0 || y >= field->height) return NULL;
+    return cell(field->current, field, 0, y);
+}
+
+void wave_field_impulse(WaveField* field, int x, int y, int radius, float strength) {
+    if (!field || radius <= 0) return;
+    int y0 = y - radius < 0 ? 0 : y - radius;
+    int y1 = y + radius > field->height - 1 ? field->height - 1 : y + radius;
+    int x0 = x - radius < 0 ? 0 : x - radius;
+    int x1 = x + radius > field->width - 1 ? field->width - 1 : x + radius;
+    for (int cy = y0; cy <= y1; cy++) {
+        float* row = cell(field->current, field, 0, cy);
+        for (int cx = x0; cx <= x1; cx++) {
+            float d = sqrtf((float)((cx - x) * (cx - x) + (cy - y) * (cy - y))) / (float)radius;
+            // A raised cosine: smooth at the rim, so the splash doesn't
+            // start with a ring of noise.
+            if (d < 1.0f) row[cx] += strength * 0.5f * (1.0f + cosf(3.14159265f * d));
+        }
+    }
+}
+
+// next = (mean of the four neighbours * 2 - next) * damping: the wave
+// equation with c^2 dt^2 / h^2 = 1/2, exactly the 2D stability limit
+// (c dt / h = 1 / sqrt(2)). At the limit the undamped scheme is only
+// marginally stable; a damping factor below 1 is what keeps it bounded.
+// All kernels add in the same order, so their results match bit for bit.
+static void wave_row_scalar(float* restrict next, const float* restrict current, const float* restrict up,
+                            const float* restrict down, int width, float damping) {
+    for (int x = 0; x < width; x++) {
+        float sum = up[x] + down[x] + current[x - 1] + current[x + 1];
+        next[x] = (sum * 0.5f - next[x]) * damping;
+    }
+}
+
+#ifdef WAVE_X86
+__attribute__((target("sse2")))
+static void wave_row_sse2(float* restrict next, const float* restrict current, const float* restrict up,
+                          const float* restrict down, int width, float damping) {
+    const __m128 half = _mm_set1_ps(0.5f), damp = _mm_set1_ps(damping);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(up + x), _mm_loadu_ps(down + x));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(current + x - 1));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(current + x + 1));
+        __m128 v = _mm_sub_ps(_mm_mul_ps(sum, half), _mm_loadu_ps(next + x));
+        _mm_storeu_ps(next + x, _mm_mul_ps(v, damp));
+    }
+    wave_row_scalar(next + x, current + x, up + x, down + x, width - x, damping);
+}
+
+__attribute__((target("avx2")))
+static void wave_row_avx2(float* restrict next, const float* restrict current, const float* restrict up,
+                          const float* restrict down, int width, float damping) {
+    const __m256 half = _mm256_set1_ps(0.5f), damp = _mm256_set1_ps(damping);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256 sum = _mm256_add_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(down + x));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(current + x - 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(current + x + 1));
+        __m256 v = _mm256_sub_ps(_mm256_mul_ps(sum, half), _mm256_loadu_ps(next + x));
+        _mm256_storeu_ps(next + x, _mm256_mul_ps(v, damp));
+    }
+    _mm256_zeroupper();
+    wave_row_sse2(next + x, current + x, up + x, down + x, width - x, damping);
+}
+#endif
+
+static WaveRow wave_row(void) {
+    switch (span_get_kernel()) {
+#ifdef WAVE_X86
+    case SPAN_KERNEL_AVX2:
+        return wave_row_avx2;
+    case SPAN_KERNEL_SSE2:
+        return wave_row_sse2;
+#endif
+    default:
+        return wave_row_scalar;
+    }
+}
+
+static void step_rows(const WaveStep* step, int y0, int y1) {
+    WaveField* f = step->field;
+    for (int y = y0; y < y1; y++) {
+        const float* current = cell(f->current, f, 0, y);
+        step->row(cell(f->previous, f, 0, y), current, current - f->stride, current + f->stride, f->width,
+                  step->damping);
+    }
+}
+
+static void step_band(void* context, int index) {
+    const WaveStep* step = context;
+    int y0 = index * WAVE_BAND_ROWS;
+    int y1 = y0 + WAVE_BAND_ROWS < step->field->height ? y0 + WAVE_BAND_ROWS : step->field->height;
+    step_rows(step, y0, y1);
+}
+
+void wave_field_step(WaveField* field, float damping, ThreadPool* pool) {
+    if (!field) return;
+    WaveStep step = {field, wave_row(), damping};
+    // Bands only read the current heights and write their own rows of the
+    // next ones, so they need no ordering.
+    int bands = (field->height + WAVE_BAND_ROWS - 1) / WAVE_BAND_ROWS;
+    if (pool && bands > 1) {
+        threadpool_run(pool, bands, step_band, &step);
+    } else {
+        step_rows(&step, 0, field->height);
+    }
+    float* next = field->previous;
+    field->previous = field->current;
+    field->current = next;
+}
+
+bool wave_field_draw(const WaveField* field, Canvas* canvas, float scale) {
+    if (!field || !canvas || canvas->recorder || scale <= 0.0f) return false;
+    int x1 = field->width < canvas->clip_x1 ? field->width : canvas->clip_x1;
+    int y1 = field->height < canvas->clip_y1 ? field->height : canvas->clip_y1;
+    if (canvas->clip_x0 >= x1 || canvas->clip_y0 >= y1) return true;
+
+    float gain = 127.0f / scale;
+    for (int y = canvas->clip_y0; y < y1; y++) {
+        const float* heights = wave_field_row(field, y);
+        Color* dst = canvas_row(canvas, y);
+        for (int x = canvas->clip_x0; x < x1; x++) {
+            float v = 128.0f + heights[x] * gain;
+            uint8_t gray = (uint8_t)(v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v);
+            dst[x] = (Color){gray, gray, gray, 255};
+        }
+    }
+    canvas_add_damage(canvas, rect_make((float)canvas->clip_x0, (float)canvas->clip_y0,
+                                        (float)(x1 - canvas->clip_x0), (float)(y1 - canvas->clip_y0)));
+    return true;
+}
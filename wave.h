@@ -0,0 +1,40 @@
+#ifndef WAVE_H
+#define WAVE_H
+
+#include <stdbool.h>
+#include "canvas.h"
+#include "threadpool.h"
+
+// A height field under the damped wave equation, for water-like ripples
+// that pass through and interfere with each other. Each step sets every
+// cell from its four neighbours and its own previous height; cells past
+// the edges stay flat, so waves reflect off them.
+//
+// Steps run rows with the span kernel set's vector width (see span.h),
+// and split the field into bands across a thread pool when given one.
+// Every kernel and thread count gives the same heights.
+typedef struct WaveField WaveField;
+
+WaveField* wave_field_create(int width, int height);
+void wave_field_destroy(WaveField* field);
+// Flattens the field at its new size.
+bool wave_field_resize(WaveField* field, int width, int height);
+void wave_field_clear(WaveField* field);
+int wave_field_width(const WaveField* field);
+int wave_field_height(const WaveField* field);
+
+// Raises a round bump of the given height at (x, y), falling off to
+// nothing at radius. Negative strengths make a dip.
+void wave_field_impulse(WaveField* field, int x, int y, int radius, float strength);
+// Advances one step. damping below 1 takes energy out each step; 0.99
+// lets a splash ring for a few seconds at 60 steps a second.
+void wave_field_step(WaveField* field, float damping, ThreadPool* pool);
+// Current heights of row y, width floats.
+const float* wave_field_row(const WaveField* field, int y);
+
+// Draws the field one pixel per cell from the canvas's top-left corner,
+// within the clip: crests light, troughs dark, full contrast at heights of
+// plus or minus scale. Fails while a recorder is attached.
+bool wave_field_draw(const WaveField* field, Canvas* canvas, float scale);
+
+#endif // WAVE_H